@@ -21,11 +21,11 @@
 
 #include <atomic>
 #include <functional>
-#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -153,7 +153,10 @@ class ManagedConnections {
 
  private:
   typedef std::shared_ptr<detail::Transport> TransportPtr;
-  typedef std::map<NodeId, TransportPtr> ConnectionMap;
+  struct NodeIdHash {
+    size_t operator()(const NodeId& node_id) const;
+  };
+  typedef std::unordered_map<NodeId, TransportPtr, NodeIdHash> ConnectionMap;
   struct PendingConnection {
     PendingConnection(NodeId node_id_in, TransportPtr transport,
                       boost::asio::io_service& io_service);
@@ -196,7 +199,7 @@ class ManagedConnections {
   std::vector<std::unique_ptr<PendingConnection>>::iterator FindPendingTransportWithNodeId(
       const NodeId& peer_id);
 
-  void OnMessageSlot(const std::string& message);
+  void OnMessageSlot(std::shared_ptr<const std::string> message);
   void OnConnectionAddedSlot(const NodeId& peer_id, TransportPtr transport,
                              bool temporary_connection,
                              std::atomic<bool> & is_duplicate_normal_connection);
@@ -214,6 +217,9 @@ class ManagedConnections {
 
  private:
   std::string DebugString() const;
+  // Publish a copy of connections_ for Send to read without taking mutex_.  Must be called with
+  // mutex_ held after every change to connections_.
+  void PublishConnections();
 
   BoostAsioService asio_service_;
   std::mutex callback_mutex_;
@@ -224,6 +230,8 @@ class ManagedConnections {
   std::shared_ptr<asymm::PrivateKey> private_key_;
   std::shared_ptr<asymm::PublicKey> public_key_;
   ConnectionMap connections_;
+  // Only ever accessed via std::atomic_load and std::atomic_store.
+  std::shared_ptr<const ConnectionMap> connections_snapshot_;
   std::vector<std::unique_ptr<PendingConnection>> pendings_;
   std::set<TransportPtr> idle_transports_;
   mutable std::mutex mutex_;
@@ -34,6 +34,12 @@ struct Parameters {
   // Thread count for use of asio::io_service.
   static uint32_t thread_count;
 
+  // Number of multiplexers sharing each transport's UDP port (via SO_REUSEPORT), each with its own
+  // thread and a disjoint subset of the transport's connections.  Only supported on Linux; a value
+  // of 0 or 1 gives a single multiplexer per transport.  When sharded, transports bind to a random
+  // port rather than trying the resilience port first.
+  static uint32_t multiplexer_shards;
+
   // Maximum number of Transports per ManagedConnections object
   static int max_transports;
 
@@ -44,6 +50,13 @@ struct Parameters {
   static uint32_t default_window_size;
   static uint32_t maximum_window_size;
 
+  // The most memory, in bytes, which each connection may use to hold data received but not yet read
+  // by the application.  Receive windows are sized to the rate at which the application reads,
+  // within this limit and maximum_window_size.  Each packet held is counted as max_size bytes,
+  // the size of the buffer it's kept in until read: datagrams coalesced by receive offload are
+  // copied out of the larger buffers they arrive in, so that those aren't held.
+  static uint32_t maximum_receive_buffer_size;
+
   // The default number of packets to write at a time
   static uint32_t default_burst_send_size;
 
@@ -55,6 +68,41 @@ struct Parameters {
     kUDPPayload = 65507
   };
 
+  // Maximum number of datagrams drained from the UDP socket by a single receive system call.  A
+  // value of 0 or 1 disables batching, in which case datagrams are received one at a time.
+  static uint32_t receive_batch_size;
+
+  // Maximum number of datagrams queued by a socket during a single send pass before they are
+  // transmitted together.  A value of 0 or 1 disables batching, in which case each packet is sent
+  // immediately.
+  static uint32_t transmit_batch_size;
+
+  // Whether batched runs of equal-sized datagrams to the same endpoint may be handed to the kernel
+  // as a single UDP generic segmentation offload (GSO) send.  Only used where the socket supports
+  // it, and only for datagram sizes which the kernel accepts for segmentation.
+  static bool udp_segmentation_offload;
+
+  // Whether the kernel may coalesce consecutive datagrams from the same sender into a single
+  // receive using UDP generic receive offload (GRO).  Requires receive batching to be enabled; the
+  // coalesced datagrams are split apart again before being dispatched.
+  static bool udp_receive_offload;
+
+  // Whether batched data packets with payloads of at least zero_copy_threshold bytes are sent using
+  // MSG_ZEROCOPY, so that the kernel transmits them straight from the message being sent rather
+  // than copying them.  Only used where the socket supports it.  Each such message stays allocated
+  // until the kernel reports it has finished with it, which costs more than copying small payloads.
+  static bool zero_copy_send;
+  static uint32_t zero_copy_threshold;
+
+  // The mechanism multiplexers use to transfer datagrams.  kIoUringBackend receives using a
+  // multishot io_uring request and submits each batch of sends with a single system call.  It
+  // requires Linux 6.0 or later, both to build and to run; where it's unavailable, multiplexers
+  // fall back to kAsioBackend.
+  // kFabricBackend uses no sockets, but passes datagrams between the multiplexers of this process
+  // in memory, e.g. to measure protocol costs without the kernel or to simulate many nodes.
+  enum MultiplexerBackendType { kAsioBackend, kIoUringBackend, kFabricBackend };
+  static MultiplexerBackendType multiplexer_backend;
+
   // Data Payload size permitted in RUDP.  Shall not exceed Packet Size defined.
   static uint32_t max_data_size;
   static uint32_t default_data_size;
@@ -66,6 +114,16 @@ struct Parameters {
   // packet in receiver.
   static Timeout default_receive_timeout;
 
+  // How lost data packets are recovered.  With kSenderTimeout the sender resends any packet which
+  // hasn't been acknowledged within its send timeout.  With kReceiverNegativeAck the receiver also
+  // sends a negative ack as soon as it sees a gap in the packets received, and repeats it (backing
+  // off from the round trip time up to default_receive_timeout) until the gap is filled.  A sender
+  // whose peer sends negative acks leaves the packets which that peer must know are missing to it,
+  // and times out only those sent after the last one acknowledged.  This is the mode new sockets
+  // start in; each may be given its own before connecting.
+  enum LossRecoveryMode { kSenderTimeout, kReceiverNegativeAck };
+  static LossRecoveryMode loss_recovery_mode;
+
   // Machine dependent parameter of send delay, depending on computation power and I/O speed.
   static Timeout default_send_delay;
 
@@ -78,6 +136,13 @@ struct Parameters {
   // Timeout defined for the fixed interval between Ack packets.
   static Timeout ack_interval;
 
+  // Bounds on delayed acknowledgement.  A receiver acks once it has received maximum_ack_interval
+  // data packets, or maximum_ack_delay after the first of them arrived, whichever comes first.
+  // Within these bounds both adapt to the packet rate and round trip time, or follow the frequency
+  // requested by the sender.  Out of order and duplicate packets are always acked immediately.
+  static uint32_t maximum_ack_interval;
+  static Timeout maximum_ack_delay;
+
   // Interval to calculate speed.
   static Timeout speed_calculate_inverval;
 
@@ -25,6 +25,7 @@
 #include <functional>
 #include <queue>
 #include <thread>
+#include <utility>
 
 #include "boost/asio/read.hpp"
 #include "boost/asio/write.hpp"
@@ -73,8 +74,8 @@ Connection::Connection(const std::shared_ptr<Transport>& transport,
       lifespan_timer_(strand_.get_io_service()),
       peer_node_id_(),
       peer_endpoint_(),
-      send_buffer_(),
       receive_buffer_(),
+      received_message_(),
       data_size_(0),
       data_received_(0),
       failed_probe_count_(0),
@@ -200,21 +201,22 @@ ip::udp::endpoint Connection::RemoteNatDetectionEndpoint() const {
   return socket_.RemoteNatDetectionEndpoint();
 }
 
-void Connection::StartSending(const std::string& data,
+void Connection::StartSending(std::string data, const MessageSentFunctor& message_sent_functor) {
+  StartSending(SharedBuffer::Adopt(std::move(data)), message_sent_functor);
+}
+
+void Connection::StartSending(const SharedBufferPtr& message,
                               const MessageSentFunctor& message_sent_functor) {
-  if (data.size() > static_cast<size_t>(ManagedConnections::kMaxMessageSize())) {
-    LOG(kError) << "Data size " << data.size() << " bytes (exceeds limit of "
+  size_t data_size(message->Capacity());
+  if (data_size > static_cast<size_t>(ManagedConnections::kMaxMessageSize())) {
+    LOG(kError) << "Data size " << data_size << " bytes (exceeds limit of "
                 << ManagedConnections::kMaxMessageSize() << ")";
-    InvokeSentFunctor(message_sent_functor, kMessageTooLarge);
+    return InvokeSentFunctor(message_sent_functor, kMessageTooLarge);
   }
   try {
-    // 2014-8-26 ned: TODO FIXME: This code is encrypting the message into
-    // a string which enters a queue. Encode() later on COPIES that string
-    // into send_buffer_ plus 3 bytes which it then hands off to be sent.
-    // This needs to go away and save another memory copy.
     strand_.post(
         std::bind(&Connection::DoQueueSendRequest, shared_from_this(),
-                  SendRequest(data, message_sent_functor)));
+                  SendRequest(message, message_sent_functor)));
   }
   catch (const std::exception& e) {
     LOG(kError) << "Failed to encrypt message: " << e.what();
@@ -250,8 +252,8 @@ void Connection::DoStartSending(SendRequest const request) {
     InvokeSentFunctor(message_sent_functor, kSendFailure);
     FinishSendAndQueueNext();
   } else {
-    EncodeData(request.encrypted_data_);
-    strand_.dispatch(std::bind(&Connection::StartWrite, shared_from_this(), wrapped_functor));
+    strand_.dispatch(std::bind(&Connection::StartWrite, shared_from_this(), request.message_,
+                               wrapped_functor));
   }
 }
 
@@ -487,13 +489,14 @@ void Connection::HandleReadSize(const bs::error_code& ec) {
        << 8) |
       receive_buffer_.at(3);
   // Allow some leeway for encryption overhead
-  if (data_size_ > ManagedConnections::kMaxMessageSize() + 1024) {
+  if (data_size_ < 0 || data_size_ > ManagedConnections::kMaxMessageSize() + 1024) {
     LOG(kError) << "Won't receive a message of size " << data_size_ << " which is > "
                 << ManagedConnections::kMaxMessageSize() + 1024 << ", closing.";
     return DoClose(boost::asio::error::not_connected);
   }
 
   data_received_ = 0;
+  received_message_ = std::make_shared<std::string>(static_cast<size_t>(data_size_), '\0');
 
   StartReadData();
 }
@@ -504,12 +507,10 @@ void Connection::StartReadData() {
                   << " already stopped.";
     return DoClose(boost::asio::error::not_connected);
   }
-  DataSize buffer_size = data_received_;
-  buffer_size += std::min(socket_.BestReadBufferSize(), data_size_ - data_received_);
-  receive_buffer_.resize(buffer_size);
-  boost::asio::mutable_buffer data_buffer = boost::asio::buffer(receive_buffer_) + data_received_;
+  // Read the rest of the message in one operation, which only completes once it has all arrived.
+  size_t remaining(static_cast<size_t>(data_size_ - data_received_));
   socket_.AsyncRead(
-      boost::asio::buffer(data_buffer), 1,
+      boost::asio::buffer(&(*received_message_)[0] + data_received_, remaining), remaining,
       strand_.wrap(std::bind(&Connection::HandleReadData, shared_from_this(), args::_1, args::_2)));
 }
 
@@ -534,7 +535,8 @@ void Connection::HandleReadData(const bs::error_code& ec, size_t length) {
   data_received_ += static_cast<DataSize>(length);
   if (data_received_ == data_size_) {
     if (std::shared_ptr<Transport> transport = transport_.lock()) {
-      transport->SignalMessageReceived(std::string(receive_buffer_.begin(), receive_buffer_.end()));
+      std::shared_ptr<const std::string> message(std::move(received_message_));
+      transport->SignalMessageReceived(message);
       StartReadSize();
     }
   } else {
@@ -551,16 +553,8 @@ void Connection::HandleReadData(const bs::error_code& ec, size_t length) {
   }
 }
 
-void Connection::EncodeData(const std::string& data) {
-  // Serialize message to internal buffer
-  DataSize msg_size = static_cast<DataSize>(data.size());
-  send_buffer_.clear();
-  for (int i = 0; i != 4; ++i)
-    send_buffer_.push_back(static_cast<char>(msg_size >> (8 * (3 - i))));
-  send_buffer_.insert(send_buffer_.end(), data.begin(), data.end());
-}
-
-void Connection::StartWrite(const MessageSentFunctor& message_sent_functor) {
+void Connection::StartWrite(const SharedBufferPtr& message,
+                            const MessageSentFunctor& message_sent_functor) {
   if (Stopped()) {
     LOG(kError) << "Failed to write from " << *multiplexer_ << " to " << socket_.PeerEndpoint()
                 << " - connection stopped.";
@@ -568,8 +562,14 @@ void Connection::StartWrite(const MessageSentFunctor& message_sent_functor) {
     FinishSendAndQueueNext();
     return DoClose(boost::asio::error::not_connected);
   }
+  // The message is preceded by its size, which the socket copies, so message itself needn't be.
+  std::array<unsigned char, sizeof(DataSize)> size_prefix;
+  DataSize msg_size = static_cast<DataSize>(message->Capacity());
+  for (int i = 0; i != 4; ++i)
+    size_prefix[i] = static_cast<unsigned char>(msg_size >> (8 * (3 - i)));
   socket_.AsyncWrite(
-      boost::asio::buffer(send_buffer_), message_sent_functor,
+      boost::asio::buffer(size_prefix), message,
+      boost::asio::buffer(message->Data(), message->Capacity()), message_sent_functor,
       strand_.wrap(std::bind(&Connection::HandleWrite, shared_from_this(), message_sent_functor)));
 }
 
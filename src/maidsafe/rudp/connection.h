@@ -33,6 +33,7 @@
 #include "boost/asio/ip/udp.hpp"
 #include "boost/asio/strand.hpp"
 
+#include "maidsafe/rudp/core/shared_buffer.h"
 #include "maidsafe/rudp/core/socket.h"
 #include "maidsafe/rudp/transport.h"
 
@@ -86,7 +87,12 @@ class Connection : public std::enable_shared_from_this<Connection> {
                        const std::function<void()>& failure_functor);
   void Ping(const NodeId& peer_node_id, const boost::asio::ip::udp::endpoint& peer_endpoint,
             const std::function<void(int)>& ping_functor);  // NOLINT (Fraser)
-  void StartSending(const std::string& data,
+  // Takes ownership of data and sends it as a message (see below).
+  void StartSending(std::string data,
+                    const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+  // Sends the whole of message, preceded by its size.  Its data packets refer to message rather
+  // than copying it.
+  void StartSending(const SharedBufferPtr& message,
                     const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
   State state() const;
   // Sets the state_ to kPermanent or kUnvalidated and sets the lifespan_timer_ to expire at
@@ -109,17 +115,12 @@ class Connection : public std::enable_shared_from_this<Connection> {
   Connection& operator=(const Connection&);
 
   struct SendRequest {
-    std::string encrypted_data_;
+    SharedBufferPtr message_;
     std::function<void(int)> message_sent_functor_;  // NOLINT (Dan)
 
-    SendRequest(std::string encrypted_data,
+    SendRequest(SharedBufferPtr message,
                 std::function<void(int)> message_sent_functor)  // NOLINT (Dan)
-#if defined(__GLIBCXX__)
-//  && __GLIBCXX__ < date (date in format of 20141218 as the date of fix of COW string)
-        : encrypted_data_(encrypted_data.data(), encrypted_data.size()),
-#else
-        : encrypted_data_(std::move(encrypted_data)),
-#endif
+        : message_(std::move(message)),
           message_sent_functor_(std::move(message_sent_functor)) {}
   };
 
@@ -158,7 +159,8 @@ class Connection : public std::enable_shared_from_this<Connection> {
   void StartReadData();
   void HandleReadData(const boost::system::error_code& ec, size_t length);
 
-  void StartWrite(const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
+  void StartWrite(const SharedBufferPtr& message,
+                  const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
   void HandleWrite(std::function<void(int)> message_sent_functor);        // NOLINT (Fraser)
 
   void StartProbing();
@@ -167,8 +169,6 @@ class Connection : public std::enable_shared_from_this<Connection> {
 
   void DoMakePermanent(bool validated);
 
-  void EncodeData(const std::string& data);
-
   void InvokeSentFunctor(const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
                          int result) const;
 
@@ -182,7 +182,10 @@ class Connection : public std::enable_shared_from_this<Connection> {
   boost::asio::deadline_timer timer_, probe_interval_timer_, lifespan_timer_;
   NodeId peer_node_id_;
   boost::asio::ip::udp::endpoint peer_endpoint_;
-  std::vector<unsigned char> send_buffer_, receive_buffer_;
+  std::vector<unsigned char> receive_buffer_;
+  // The message being received, into which its data is read straight from the socket's receive
+  // window once its size is known.  It's handed on to the transport without being copied again.
+  std::shared_ptr<std::string> received_message_;
   DataSize data_size_, data_received_;
   uint8_t failed_probe_count_;
   State state_;
@@ -27,6 +27,7 @@
 #include "maidsafe/rudp/connection.h"
 #include "maidsafe/rudp/transport.h"
 #include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
 #include "maidsafe/rudp/core/socket.h"
 #include "maidsafe/rudp/packets/handshake_packet.h"
 #include "maidsafe/rudp/parameters.h"
@@ -58,20 +59,36 @@ ConnectionManager::ConnectionManager(std::shared_ptr<Transport> transport,
                                      MultiplexerPtr multiplexer, NodeId this_node_id,
                                      std::shared_ptr<asymm::PublicKey> this_public_key)
     : connections_(),
+      connections_by_peer_id_(),
+      send_snapshot_(std::make_shared<ConnectionSnapshot>()),
       mutex_(),
       transport_(transport),
       strand_(strand),
       multiplexer_(std::move(multiplexer)),
       kThisNodeId_(std::move(this_node_id)),
       this_public_key_(std::move(this_public_key)),
-      sockets_() {
-  multiplexer_->dispatcher_.SetConnectionManager(this);
+      kSocketIdSecret_(RandomUint32()),
+      shards_() {
+  shards_.emplace_back(new Shard(strand_, multiplexer_, kSocketIdSecret_));
+  multiplexer_->dispatcher_.SetConnectionManager(this, 0);
 }
 
 ConnectionManager::~ConnectionManager() {
   Close();
 }
 
+void ConnectionManager::AddShard(const boost::asio::io_service::strand& strand,
+                                 MultiplexerPtr multiplexer) {
+  multiplexer->dispatcher_.SetConnectionManager(this, shards_.size());
+  shards_.emplace_back(new Shard(strand, std::move(multiplexer), kSocketIdSecret_));
+  // Shards are all added before any sockets, so every table can adopt the new shard count.
+  const uint32_t shard_count(static_cast<uint32_t>(shards_.size()));
+  for (uint32_t i(0); i != shard_count; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+    shards_[i]->sockets.SetShard(i, shard_count);
+  }
+}
+
 void ConnectionManager::Close() {
   std::lock_guard<std::mutex> lock(mutex_);
 
@@ -81,7 +98,8 @@ void ConnectionManager::Close() {
         });
   }
 
-  multiplexer_->dispatcher_.SetConnectionManager(nullptr);
+  for (auto& shard : shards_)
+    shard->multiplexer->dispatcher_.SetConnectionManager(nullptr, 0);
 }
 
 bool ConnectionManager::CanStartConnectingTo(NodeId peer_id, Endpoint peer_ep) const {
@@ -131,7 +149,8 @@ void ConnectionManager::Connect(const NodeId& peer_id, const Endpoint& peer_endp
 
   being_connected_.insert(std::make_pair(peer_id, peer_endpoint));
 
-  auto connection = std::make_shared<Connection>(transport, strand_, multiplexer_);
+  Shard& shard(*shards_[ShardFor(peer_endpoint)]);
+  auto connection = std::make_shared<Connection>(transport, shard.strand, shard.multiplexer);
 
   connection->StartConnecting(peer_id, peer_endpoint, validation_data, connect_attempt_timeout,
                               lifespan, on_connect, failure_functor);
@@ -147,7 +166,11 @@ int ConnectionManager::AddConnection(ConnectionPtr connection) {
     return kInvalidConnection;
   std::lock_guard<std::mutex> lock(mutex_);
   auto result(connections_.insert(connection));
-  return result.second ? kSuccess : kConnectionAlreadyExists;
+  if (!result.second)
+    return kConnectionAlreadyExists;
+  connections_by_peer_id_.insert(std::make_pair(connection->Socket().PeerNodeId(), result.first));
+  PublishSendSnapshot();
+  return kSuccess;
 }
 
 bool ConnectionManager::CloseConnection(const NodeId& peer_id) {
@@ -168,7 +191,18 @@ void ConnectionManager::RemoveConnection(ConnectionPtr connection) {
   std::lock_guard<std::mutex> lock(mutex_);
   assert(IsNormal(connection) || connection->state() == Connection::State::kDuplicate);
   MarkDoneConnecting(connection->PeerNodeId(), connection->PeerEndpoint());
-  connections_.erase(connection);
+  auto itr(connections_.find(connection));
+  if (itr == connections_.end())
+    return;
+  auto range(connections_by_peer_id_.equal_range(connection->Socket().PeerNodeId()));
+  for (auto index_itr(range.first); index_itr != range.second; ++index_itr) {
+    if (index_itr->second == itr) {
+      connections_by_peer_id_.erase(index_itr);
+      break;
+    }
+  }
+  connections_.erase(itr);
+  PublishSendSnapshot();
 }
 
 ConnectionManager::ConnectionPtr ConnectionManager::GetConnection(const NodeId& peer_id) {
@@ -185,39 +219,49 @@ void ConnectionManager::Ping(const NodeId& peer_id, const Endpoint& peer_endpoin
                              const std::function<void(int)>& ping_functor) {  // NOLINT (Fraser)
   if (std::shared_ptr<Transport> transport = transport_.lock()) {
     assert(ping_functor);
-    ConnectionPtr connection(std::make_shared<Connection>(transport, strand_, multiplexer_));
+    Shard& shard(*shards_[ShardFor(peer_endpoint)]);
+    ConnectionPtr connection(
+        std::make_shared<Connection>(transport, shard.strand, shard.multiplexer));
     connection->Ping(peer_id, peer_endpoint, ping_functor);
   } else {
     assert(0 && "Transport already closed");
   }
 }
 
-bool ConnectionManager::Send(const NodeId& peer_id, const std::string& message,
+bool ConnectionManager::Send(const NodeId& peer_id, std::string message,
                              const std::function<void(int)>& message_sent_functor) {  // NOLINT
-  std::unique_lock<std::mutex> lock(mutex_);
-  auto itr(FindConnection(peer_id));
-  if (itr == connections_.end()) {
+  std::shared_ptr<const ConnectionSnapshot> snapshot(std::atomic_load(&send_snapshot_));
+  auto itr(snapshot->find(peer_id));
+  if (itr == snapshot->end()) {
     LOG(kWarning) << kThisNodeId_ << " Not currently connected to " << peer_id;
     return false;
   }
 
-  ConnectionPtr connection(*itr);
-  lock.unlock();
-  // using COW std::string will cause thread sanitizer warning of data racing
-  std::shared_ptr<std::string> message_ptr(new std::string(message.data(), message.size()));
-  strand_.dispatch([=] { connection->StartSending(*message_ptr, message_sent_functor); });
+  ConnectionPtr connection(itr->second);
+  // The message isn't copied; its data packets all refer to shared_message.
+  SharedBufferPtr shared_message(SharedBuffer::Adopt(std::move(message)));
+  strand_.dispatch([=] { connection->StartSending(shared_message, message_sent_functor); });
   return true;
 }
 
 Socket* ConnectionManager::GetSocket(const boost::asio::const_buffer& data,
-                                     const Endpoint& endpoint) {
+                                     const Endpoint& endpoint, size_t shard) {
   uint32_t socket_id(0);
   if (!Packet::DecodeDestinationSocketId(&socket_id, data)) {
     LOG(kError) << kThisNodeId_ << " Received a non-RUDP packet from " << endpoint;
     return nullptr;
   }
 
-  SocketMap::const_iterator socket_iter(sockets_.end());
+  // A handshake on a new socket belongs to the shard which any connection to the sender would have
+  // been placed on.  Anything else belongs to the shard owning its destination socket.
+  size_t owner(socket_id == 0 ? ShardFor(endpoint) : socket_id % shards_.size());
+  if (owner != shard) {
+    ForwardToShard(owner, data, endpoint);
+    return nullptr;
+  }
+
+  std::unique_lock<std::mutex> lock(shards_[shard]->mutex);
+  SocketIndex& sockets(shards_[shard]->sockets);
   if (socket_id == 0) {
     HandshakePacket handshake_packet;
     if (!handshake_packet.Decode(data)) {
@@ -229,39 +273,31 @@ Socket* ConnectionManager::GetSocket(const boost::asio::const_buffer& data,
       // This is a handshake packet on a newly-added socket
       LOG(kVerbose) << kThisNodeId_
                     << " This is a handshake packet on a newly-added socket from " << endpoint;
-      socket_iter = std::find_if(sockets_.begin(), sockets_.end(),
-                                 [endpoint](const SocketMap::value_type & socket_pair) {
-        return socket_pair.second->PeerEndpoint() == endpoint && !socket_pair.second->IsConnected();
-      });
+      socket_id = sockets.FindByEndpoint(endpoint, true);
       // If the socket wasn't found, this could be a connect attempt from a peer using symmetric
       // NAT, so the peer's port may be different to what this node was told to expect.
-      if (socket_iter == sockets_.end()) {
-        socket_iter = std::find_if(sockets_.begin(), sockets_.end(),
-                                   [endpoint](const SocketMap::value_type & socket_pair) {
-          return socket_pair.second->PeerEndpoint().address() == endpoint.address() &&
-                 !OnPrivateNetwork(socket_pair.second->PeerEndpoint()) &&
-                 !socket_pair.second->IsConnected();
-        });
-        if (socket_iter != sockets_.end()) {
+      if (socket_id == 0 && !OnPrivateNetwork(endpoint)) {
+        socket_id = sockets.FindUnconnectedByAddress(endpoint.address());
+        if (socket_id != 0) {
+          Socket* socket(sockets.Find(socket_id));
           LOG(kVerbose) << kThisNodeId_ << " Updating peer's endpoint from "
-                        << socket_iter->second->PeerEndpoint() << " to " << endpoint;
-          socket_iter->second->UpdatePeerEndpoint(endpoint);
+                        << socket->PeerEndpoint() << " to " << endpoint;
+          socket->UpdatePeerEndpoint(endpoint);
+          sockets.UpdatePeerEndpoint(socket_id, endpoint);
           LOG(kVerbose) << kThisNodeId_
-                        << " Peer's endpoint now: " << socket_iter->second->PeerEndpoint()
-                        << "  and guessed port = " << socket_iter->second->PeerGuessedPort();
+                        << " Peer's endpoint now: " << socket->PeerEndpoint()
+                        << "  and guessed port = " << socket->PeerGuessedPort();
         }
       }
     } else {  // Session::mode_ != kNormal
-      socket_iter = std::find_if(sockets_.begin(), sockets_.end(),
-                                 [endpoint](const SocketMap::value_type & socket_pair) {
-        return socket_pair.second->PeerEndpoint() == endpoint;
-      });
-      if (socket_iter == sockets_.end()) {
+      socket_id = sockets.FindByEndpoint(endpoint, false);
+      if (socket_id == 0) {
         // This is a handshake packet from a peer trying to ping this node or join the network
+        lock.unlock();
         HandlePingFrom(handshake_packet, endpoint);
         return nullptr;
       } else {
-        if (sockets_.size() == 1U) {
+        if (sockets.Size() == 1U) {
           // This is a handshake packet from a peer replying to this node's join attempt,
           // or from a peer starting a zero state network with this node
           LOG(kVerbose) << kThisNodeId_ << " This is a handshake packet from " << endpoint
@@ -272,13 +308,12 @@ Socket* ConnectionManager::GetSocket(const boost::asio::const_buffer& data,
         }
       }
     }
-  } else {
-    // This packet is intended for a specific connection.
-    socket_iter = sockets_.find(socket_id);
   }
 
-  if (socket_iter != sockets_.end()) {
-    return socket_iter->second;
+  // The packet is intended for a specific connection, whether by id or as resolved above.
+  Socket* socket(socket_id == 0 ? nullptr : sockets.Find(socket_id));
+  if (socket) {
+    return socket;
   } else {
     const unsigned char* p = boost::asio::buffer_cast<const unsigned char*>(data);
     LOG(kVerbose) << kThisNodeId_ << "  Received a packet \"0x" << std::hex
@@ -354,7 +389,8 @@ Endpoint ConnectionManager::ThisEndpoint(const NodeId& peer_id) {
 }
 
 void ConnectionManager::SetBestGuessExternalEndpoint(const Endpoint& external_endpoint) {
-  multiplexer_->best_guess_external_endpoint_ = external_endpoint;
+  for (auto& shard : shards_)
+    shard->multiplexer->best_guess_external_endpoint_ = external_endpoint;
 }
 
 Endpoint ConnectionManager::RemoteNatDetectionEndpoint(const NodeId& peer_id) {
@@ -365,19 +401,46 @@ Endpoint ConnectionManager::RemoteNatDetectionEndpoint(const NodeId& peer_id) {
   return (*itr)->Socket().RemoteNatDetectionEndpoint();
 }
 
-uint32_t ConnectionManager::AddSocket(Socket* socket) {
-  // Generate a new unique id for the socket.
-  uint32_t id = 0;
-  while (id == 0 || sockets_.find(id) != sockets_.end())
-    id = RandomUint32();
-
-  sockets_[id] = socket;
+uint32_t ConnectionManager::AddSocket(Socket* socket, size_t shard) {
+  // The shard's table allocates an id congruent to its index modulo the number of shards, since
+  // packets are steered to the shard given by their destination id.
+  Shard& owner(*shards_[shard]);
+  std::lock_guard<std::mutex> lock(owner.mutex);
+  uint32_t id(owner.sockets.Add(socket, socket->PeerEndpoint()));
+  if (id == 0)
+    LOG(kError) << kThisNodeId_ << " Too many sockets to add another on shard " << shard;
   return id;
 }
 
 void ConnectionManager::RemoveSocket(uint32_t id) {
-  if (id)
-    sockets_.erase(id);
+  if (!id)
+    return;
+  Shard& owner(*shards_[id % shards_.size()]);
+  std::lock_guard<std::mutex> lock(owner.mutex);
+  owner.sockets.Remove(id);
+}
+
+size_t ConnectionManager::ShardFor(const Endpoint& peer_endpoint) const {
+  if (shards_.size() == 1U)
+    return 0;
+  // Peers on public networks are placed by address alone, so that a handshake arriving from an
+  // unexpected port (e.g. from behind symmetric NAT) still reaches the shard expecting it.
+  std::string key(peer_endpoint.address().to_string());
+  if (OnPrivateNetwork(peer_endpoint))
+    key += ':' + std::to_string(peer_endpoint.port());
+  return std::hash<std::string>()(key) % shards_.size();
+}
+
+void ConnectionManager::ForwardToShard(size_t shard, const boost::asio::const_buffer& data,
+                                       const Endpoint& endpoint) {
+  size_t length(boost::asio::buffer_size(data));
+  SharedBufferPtr datagram(SharedBuffer::Allocate(length));
+  boost::asio::buffer_copy(boost::asio::buffer(datagram->Data(), length), data);
+  MultiplexerPtr multiplexer(shards_[shard]->multiplexer);
+  shards_[shard]->strand.post([multiplexer, datagram, length, endpoint] {
+    multiplexer->dispatcher_.HandleReceiveFrom(boost::asio::buffer(datagram->Data(), length),
+                                               endpoint, datagram);
+  });
 }
 
 size_t ConnectionManager::NormalConnectionsCount() const {
@@ -388,10 +451,17 @@ size_t ConnectionManager::NormalConnectionsCount() const {
 ConnectionManager::ConnectionGroup::iterator ConnectionManager::FindConnection(
     const NodeId& peer_id) const {
   assert(!mutex_.try_lock());
-  return std::find_if(connections_.begin(), connections_.end(),
-                      [&peer_id](const ConnectionPtr & connection) {
-    return connection->Socket().PeerNodeId() == peer_id;
-  });
+  auto itr(connections_by_peer_id_.find(peer_id));
+  return itr == connections_by_peer_id_.end() ? connections_.end() : itr->second;
+}
+
+void ConnectionManager::PublishSendSnapshot() {
+  std::shared_ptr<ConnectionSnapshot> snapshot(std::make_shared<ConnectionSnapshot>());
+  snapshot->reserve(connections_by_peer_id_.size());
+  // emplace keeps the first entry for a peer, matching the one FindConnection would return.
+  for (const auto& entry : connections_by_peer_id_)
+    snapshot->emplace(entry.first, *entry.second);
+  std::atomic_store(&send_snapshot_, std::shared_ptr<const ConnectionSnapshot>(snapshot));
 }
 
 NodeId ConnectionManager::node_id() const { return kThisNodeId_; }
@@ -19,7 +19,6 @@
 #ifndef MAIDSAFE_RUDP_CONNECTION_MANAGER_H_
 #define MAIDSAFE_RUDP_CONNECTION_MANAGER_H_
 
-#include <unordered_map>
 #include <cstdint>
 #include <functional>
 #include <map>
@@ -27,7 +26,9 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/strand.hpp"
@@ -37,6 +38,9 @@
 #include "maidsafe/common/node_id.h"
 #include "maidsafe/common/rsa.h"
 
+#include "maidsafe/rudp/utils.h"
+#include "maidsafe/rudp/core/socket_index.h"
+
 namespace maidsafe {
 
 namespace rudp {
@@ -63,6 +67,12 @@ class ConnectionManager {
                     std::shared_ptr<asymm::PublicKey> this_public_key);
   ~ConnectionManager();
 
+  // Add a further multiplexer sharing the primary multiplexer's port, whose sockets' handlers run on
+  // strand.  Connections are spread across all the multiplexers by peer endpoint.  Must be called
+  // before any connections are made.
+  void AddShard(const boost::asio::io_service::strand& strand,
+                std::shared_ptr<Multiplexer> multiplexer);
+
   void Close();
 
   void Connect(const NodeId& peer_id, const Endpoint& peer_endpoint,
@@ -79,8 +89,8 @@ class ConnectionManager {
 
   void Ping(const NodeId& peer_id, const Endpoint& peer_endpoint,
             const std::function<void(int)>& ping_functor);  // NOLINT (Fraser)
-  // Returns false if the connection doesn't exist.
-  bool Send(const NodeId& peer_id, const std::string& message,
+  // Returns false if the connection doesn't exist, else takes ownership of message.
+  bool Send(const NodeId& peer_id, std::string message,
             const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
 
   bool MakeConnectionPermanent(const NodeId& peer_id, bool validated, Endpoint& peer_endpoint);
@@ -95,13 +105,14 @@ class ConnectionManager {
   // Get the remote endpoint offered for NAT detection by peer.
   Endpoint RemoteNatDetectionEndpoint(const NodeId& peer_id);
 
-  // Add a socket. Returns a new unique id for the socket.
-  uint32_t AddSocket(Socket* socket);
+  // Add a socket belonging to the given shard. Returns a new unique id for the socket.
+  uint32_t AddSocket(Socket* socket, size_t shard);
   void RemoveSocket(uint32_t id);
-  // Called by the Dispatcher when a new packet arrives for a socket.  Can return nullptr if no
-  // appropriate socket found.
+  // Called by the Dispatcher of the given shard when a new packet arrives for a socket.  Can return
+  // nullptr if no appropriate socket found, or if the packet belongs to a socket on another shard,
+  // in which case it is handed over to that shard.
   Socket* GetSocket(const boost::asio::const_buffer& data,
-                    const Endpoint& endpoint);
+                    const Endpoint& endpoint, size_t shard);
 
   size_t NormalConnectionsCount() const;
 
@@ -120,11 +131,38 @@ class ConnectionManager {
  private:
   typedef std::shared_ptr<Multiplexer> MultiplexerPtr;
   typedef std::set<ConnectionPtr> ConnectionGroup;
-  // Map of destination socket id to corresponding socket object.
-  typedef std::unordered_map<uint32_t, Socket*> SocketMap;
+  // Each connection in connections_, keyed by its peer's id.
+  typedef std::unordered_multimap<NodeId, ConnectionGroup::iterator, NodeIdHash> ConnectionIndex;
+  // An immutable copy of the connection found by FindConnection for each peer, read by Send without
+  // taking mutex_.
+  typedef std::unordered_map<NodeId, ConnectionPtr, NodeIdHash> ConnectionSnapshot;
+
+  // A multiplexer, the strand on which its sockets' handlers run, and the sockets it owns.  The ids
+  // of a shard's sockets are all congruent to its index modulo the number of shards.
+  struct Shard {
+    Shard(const boost::asio::io_service::strand& strand_in, MultiplexerPtr multiplexer_in,
+          uint32_t socket_id_secret)
+        : strand(strand_in),
+          multiplexer(std::move(multiplexer_in)),
+          mutex(),
+          sockets(socket_id_secret) {}
+    boost::asio::io_service::strand strand;
+    MultiplexerPtr multiplexer;
+    std::mutex mutex;
+    SocketIndex sockets;
+  };
+
+  // The shard on which a connection to peer_endpoint is placed.  The kernel's steering can't
+  // compute this, so handshakes for new sockets often need forwarding (see GetSocket).
+  size_t ShardFor(const Endpoint& peer_endpoint) const;
+  // Copy a packet received by one shard and dispatch it on the given shard instead.
+  void ForwardToShard(size_t shard, const boost::asio::const_buffer& data,
+                      const Endpoint& endpoint);
 
   void HandlePingFrom(const HandshakePacket& handshake_packet, const Endpoint& endpoint);
   ConnectionGroup::iterator FindConnection(const NodeId& peer_id) const;
+  // Rebuild and publish send_snapshot_.  Must be called with mutex_ held.
+  void PublishSendSnapshot();
 
   // TODO(PeterJ): Instead of using this set, it would be nicer if we
   // added a "not yet connected connection" into the connetions_ group
@@ -134,13 +172,19 @@ class ConnectionManager {
   // Because the connections can be in an idle state with no pending async operations, they are kept
   // alive with a shared_ptr in this set, as well as in the async operation handlers.
   ConnectionGroup connections_;
+  ConnectionIndex connections_by_peer_id_;
+  // Only ever accessed via std::atomic_load and std::atomic_store.
+  std::shared_ptr<const ConnectionSnapshot> send_snapshot_;
   mutable std::mutex mutex_;
   std::weak_ptr<Transport> transport_;
   boost::asio::io_service::strand strand_;
   std::shared_ptr<Multiplexer> multiplexer_;
   const NodeId kThisNodeId_;
   std::shared_ptr<asymm::PublicKey> this_public_key_;
-  SocketMap sockets_;
+  // Masks the socket ids allocated by every shard, so that peers can't predict them.
+  const uint32_t kSocketIdSecret_;
+  // The primary shard, using strand_ and multiplexer_, is always first.
+  std::vector<std::unique_ptr<Shard>> shards_;
 };
 
 }  // namespace detail
@@ -0,0 +1,151 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/asio_backend.h"
+
+#include <algorithm>
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace asio = boost::asio;
+namespace ip = boost::asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// The number of released receive buffers kept for reuse.  Any more (e.g. after a burst of packets
+// which were held for a while by the sockets' receive windows) are freed.
+const size_t kMaxFreeReceiveBuffers = 64;
+
+}  // unnamed namespace
+
+AsioBackend::AsioBackend(ip::udp::socket& socket)
+    : socket_(socket),
+      receive_buffer_pool_(SharedBufferPool::Create(Parameters::max_size, kMaxFreeReceiveBuffers)),
+      receive_buffer_(),
+      has_received_(false),
+      received_length_(0),
+      sender_endpoint_(),
+      receive_batch_(Parameters::receive_batch_size > 1
+                         ? new ReceiveBatch(Parameters::receive_batch_size) : nullptr) {}
+
+bool AsioBackend::Open() {
+  if (receive_batch_ && Parameters::udp_receive_offload &&
+      !receive_batch_->EnableCoalescing(socket_)) {
+    bs::error_code ec;
+    LOG(kInfo) << "UDP receive offload unsupported on " << socket_.local_endpoint(ec);
+  }
+  return true;
+}
+
+void AsioBackend::AsyncWait(WaitHandler handler) {
+  // With receive coalescing the first datagram can't be read by asio, since its segment size
+  // would be lost, so just wait for the socket to become readable and let the batch drain it.
+  if (receive_batch_ && receive_batch_->IsCoalescing()) {
+    socket_.async_receive_from(asio::null_buffers(), sender_endpoint_, 0,
+                               [handler](const bs::error_code& ec, size_t) { handler(ec); });
+    return;
+  }
+  if (!receive_buffer_ || !receive_buffer_->IsUnique())
+    receive_buffer_ = receive_buffer_pool_->Acquire();
+  socket_.async_receive_from(
+      asio::buffer(receive_buffer_->Data(), receive_buffer_->Capacity()), sender_endpoint_, 0,
+      [this, handler](const bs::error_code& ec, size_t length) {
+        received_length_ = length;
+        has_received_ = !ec;
+        handler(ec);
+      });
+}
+
+void AsioBackend::Receive(const ReceiveHandler& handler, bs::error_code& ec) {
+  ec.clear();
+  if (has_received_) {
+    has_received_ = false;
+    handler(asio::buffer(receive_buffer_->Data(), received_length_), sender_endpoint_,
+            receive_buffer_);
+    return;
+  }
+  if (receive_batch_) {
+    size_t count = receive_batch_->Receive(socket_, ec);
+    for (size_t i = 0; i < count; ++i)
+      DispatchBatched(i, handler);
+    return;
+  }
+  // A fresh buffer is needed whenever a packet keeps a reference to the one it was received into.
+  if (!receive_buffer_ || !receive_buffer_->IsUnique())
+    receive_buffer_ = receive_buffer_pool_->Acquire();
+  size_t length = socket_.receive_from(
+      asio::buffer(receive_buffer_->Data(), receive_buffer_->Capacity()), sender_endpoint_, 0, ec);
+  if (!ec)
+    handler(asio::buffer(receive_buffer_->Data(), length), sender_endpoint_, receive_buffer_);
+}
+
+void AsioBackend::DispatchBatched(size_t i, const ReceiveHandler& handler) {
+  asio::const_buffer data(receive_batch_->Data(i));
+  const ip::udp::endpoint& sender_endpoint(receive_batch_->SenderEndpoint(i));
+  if (!receive_batch_->IsCoalescing()) {
+    handler(data, sender_endpoint, receive_batch_->Buffer(i));
+    return;
+  }
+  size_t segment_size(receive_batch_->SegmentSize(i));
+  const unsigned char* begin(asio::buffer_cast<const unsigned char*>(data));
+  size_t length(asio::buffer_size(data));
+  if (segment_size == 0)
+    segment_size = length;
+  for (size_t offset(0); offset < length; offset += segment_size)
+    DispatchCopy(asio::buffer(begin + offset, std::min(segment_size, length - offset)),
+                 receive_batch_->Buffer(i), sender_endpoint, handler);
+}
+
+void AsioBackend::DispatchCopy(const asio::const_buffer& datagram,
+                               const SharedBufferPtr& coalesced_buffer,
+                               const ip::udp::endpoint& sender_endpoint,
+                               const ReceiveHandler& handler) {
+  size_t length(asio::buffer_size(datagram));
+  if (length > receive_buffer_pool_->BufferSize()) {
+    handler(datagram, sender_endpoint, coalesced_buffer);
+    return;
+  }
+  SharedBufferPtr buffer(receive_buffer_pool_->Acquire());
+  asio::buffer_copy(asio::buffer(buffer->Data(), length), datagram);
+  handler(asio::buffer(buffer->Data(), length), sender_endpoint, buffer);
+}
+
+void AsioBackend::SendTo(const std::vector<asio::mutable_buffer>& buffers,
+                         const ip::udp::endpoint& endpoint, bs::error_code& ec) {
+  socket_.send_to(buffers, endpoint, 0, ec);
+}
+
+size_t AsioBackend::Send(TransmitBatch& batch, size_t& segment_limit, ZeroCopyTracker* zero_copy,
+                         bs::error_code& ec) {
+  return batch.Send(socket_, segment_limit, zero_copy, ec);
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
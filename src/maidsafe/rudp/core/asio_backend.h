@@ -0,0 +1,98 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_ASIO_BACKEND_H_
+#define MAIDSAFE_RUDP_CORE_ASIO_BACKEND_H_
+
+#include <memory>
+#include <vector>
+
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/rudp/core/multiplexer_backend.h"
+#include "maidsafe/rudp/core/receive_batch.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// The default multiplexer backend.  It waits for datagrams using asio's reactor and transfers them
+// using ordinary socket calls, batched where enabled (see ReceiveBatch and TransmitBatch).
+class AsioBackend : public MultiplexerBackend {
+ public:
+  explicit AsioBackend(boost::asio::ip::udp::socket& socket);
+  virtual ~AsioBackend() {}
+
+  virtual bool Open();
+  virtual bool IsOpen() const { return socket_.is_open(); }
+  virtual boost::asio::ip::udp::endpoint LocalEndpoint(boost::system::error_code& ec) const {
+    return socket_.local_endpoint(ec);
+  }
+  virtual void Close() {}
+  virtual void AsyncWait(WaitHandler handler);
+  virtual void Receive(const ReceiveHandler& handler, boost::system::error_code& ec);
+  virtual void SendTo(const std::vector<boost::asio::mutable_buffer>& buffers,
+                      const boost::asio::ip::udp::endpoint& endpoint,
+                      boost::system::error_code& ec);
+  virtual size_t Send(TransmitBatch& batch, size_t& segment_limit, ZeroCopyTracker* zero_copy,
+                      boost::system::error_code& ec);
+
+ private:
+  // Disallow copying and assignment.
+  AsioBackend(const AsioBackend&);
+  AsioBackend& operator=(const AsioBackend&);
+
+  // Pass the i'th receive of the batch to handler, splitting it into its individual datagrams if
+  // the kernel coalesced several of them.
+  void DispatchBatched(size_t i, const ReceiveHandler& handler);
+  // Pass datagram, which lies within a coalesced receive buffer, to handler.  Coalesced receive
+  // buffers are far larger than any packet, so rather than letting the packets decoded from it keep
+  // such a buffer alive, datagram is first copied into one from receive_buffer_pool_.  That way a
+  // packet held by a receive window pins no more than max_size bytes, and the coalesced buffers
+  // can be refilled by the next receive.
+  void DispatchCopy(const boost::asio::const_buffer& datagram,
+                    const SharedBufferPtr& coalesced_buffer,
+                    const boost::asio::ip::udp::endpoint& sender_endpoint,
+                    const ReceiveHandler& handler);
+
+  boost::asio::ip::udp::socket& socket_;
+
+  // Buffers which single datagrams are received (or with coalescing, copied) into.  Packets may
+  // keep referring to the buffer they were received into, so these are pooled rather than reused in
+  // turn.
+  std::shared_ptr<SharedBufferPool> receive_buffer_pool_;
+  SharedBufferPtr receive_buffer_;
+  // Whether AsyncWait received a datagram into receive_buffer_ which Receive has yet to pass on.
+  bool has_received_;
+  size_t received_length_;
+  boost::asio::ip::udp::endpoint sender_endpoint_;
+
+  // Buffers used to drain queued datagrams several at a time.  Null if batching is disabled.
+  std::unique_ptr<ReceiveBatch> receive_batch_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_ASIO_BACKEND_H_
@@ -35,7 +35,31 @@ namespace rudp {
 
 namespace detail {
 
-static const bptime::time_duration kSynPeriod = bptime::milliseconds(10);
+namespace {
+
+// Delayed acks are sent after at least this many data packets (unless the peer asks for fewer)...
+const uint32_t kMinAckInterval = 2;
+// ... and delayed by at least this long, so that fast links don't spin the tick timer.
+const bptime::time_duration kMinAckDelay = bptime::milliseconds(1);
+
+// A missing packet isn't reported again any sooner than this after the last report, however short
+// the round trip time.
+const bptime::time_duration kMinNegativeAckTimeout = bptime::milliseconds(10);
+
+// The application's read rate is measured over periods of at least this long, so that the receive
+// window isn't resized on the strength of a single read.
+const bptime::time_duration kMinReadPeriod = bptime::milliseconds(10);
+
+// A quarter of the round trip time (in microseconds), bounded by kMinAckDelay and
+// Parameters::maximum_ack_delay.  The latter is used while the round trip time is unknown.
+bptime::time_duration QuarterRoundTripTime(uint32_t round_trip_time) {
+  if (round_trip_time == 0)
+    return Parameters::maximum_ack_delay;
+  bptime::time_duration quarter(bptime::microseconds(round_trip_time / 4));
+  return std::min(Parameters::maximum_ack_delay, std::max(quarter, kMinAckDelay));
+}
+
+}  // unnamed namespace
 
 CongestionControl::CongestionControl()
     : slow_start_phase_(true),
@@ -50,11 +74,18 @@ CongestionControl::CongestionControl()
       send_timeout_(Parameters::default_send_timeout),
       receive_delay_(Parameters::default_receive_delay),
       receive_timeout_(Parameters::default_receive_timeout),
-      ack_delay_(bptime::milliseconds(10)),
+      ack_delay_(Parameters::maximum_ack_delay),
       ack_timeout_(Parameters::default_ack_timeout),
-      ack_interval_(Parameters::maximum_segment_size),
+      ack_interval_(kMinAckInterval),
+      requested_ack_interval_(0),
+      requested_ack_delay_(),
       lost_packets_(0),
       corrupted_packets_(0),
+      packets_read_(0),
+      read_period_start_(TickTimer::Now()),
+      last_read_time_(read_period_start_),
+      read_busy_time_(),
+      reader_caught_up_(true),
       arrival_times_(),
       packet_pair_intervals_(),
       peer_connection_type_(0),
@@ -88,7 +119,19 @@ void CongestionControl::OnDataPacketReceived(uint32_t seqnum) {
     arrival_times_.pop_front();
 }
 
+void CongestionControl::OnDataRead(size_t packet_count, bool caught_up) {
+  // Until the application catches up, the time to its next read is time spent on the data it has.
+  bptime::ptime now = TickTimer::Now();
+  if (!reader_caught_up_)
+    read_busy_time_ += now - std::max(last_read_time_, read_period_start_);
+  packets_read_ += packet_count;
+  last_read_time_ = now;
+  reader_caught_up_ = caught_up;
+}
+
 void CongestionControl::OnGenerateAck(uint32_t /*seqnum*/) {
+  UpdateReceiveWindow();
+
   // Need to have received at least 8 packets to calculate receiving rate.
   if (arrival_times_.size() <= 8)
     return;
@@ -136,15 +179,52 @@ void CongestionControl::OnGenerateAck(uint32_t /*seqnum*/) {
         (packet_pair_median > 0) ? static_cast<uint32_t>(1000000 / packet_pair_median) : 0;
   }
 
-  // TODO(qi.ma@maidsafe.net) : The receive_window_size shall be based on the
-  // local processing power, i.e. the reading speed of the data flow
-  receive_window_size_ = Parameters::maximum_window_size;
-  //   receive_window_size_ = (packets_receiving_rate_ * round_trip_time_) / 1000000;
-  //   // The speed of generating Ack Packets shall be considered
-  //   receive_window_size_ *= (1000 / Parameters::ack_interval.total_milliseconds());
-  //   receive_window_size_ = std::max(receive_window_size_, Parameters::default_window_size);
-  //   receive_window_size_ = std::min(receive_window_size_, Parameters::maximum_window_size);
   // TODO(Team) calculate SND (send_delay_).
+  UpdateAckFrequency();
+}
+
+void CongestionControl::UpdateReceiveWindow() {
+  // The window has to hold whatever arrives between the application freeing space and the peer
+  // hearing of it and filling it: about a round trip time (allowing four deviations) plus the ack
+  // delay.  Until the round trip time is known, the window is left as it is.
+  if (round_trip_time_ == 0)
+    return;
+  bptime::time_duration fill_time(
+      bptime::microseconds(round_trip_time_ + UINT64_C(4) * round_trip_time_variance_));
+  fill_time += ack_delay_;
+  bptime::ptime now = TickTimer::Now();
+  bptime::time_duration period(now - read_period_start_);
+  if (period < std::max(fill_time, kMinReadPeriod))
+    return;
+
+  // The application's read rate is measured over the time it had data waiting to be read, as while
+  // it's caught up it's the network (e.g. a lost packet) which holds it back, not the other way
+  // round.  Aim for twice what it reads per fill time, but no more than double the window in one
+  // period: a reader which never falls behind will then see the window double each period until
+  // something else limits it.  A slow reader's window shrinks a segment at a time (as the peer's
+  // send window does), so that data it's already been sent still fits.  Memory is allocated for
+  // each packet held rather than for the whole window, so the limit bounds what a connection can
+  // use, not what it does use.
+  if (!reader_caught_up_)
+    read_busy_time_ += now - std::max(last_read_time_, read_period_start_);
+  uint64_t target = 2 * static_cast<uint64_t>(receive_window_size_);
+  if (read_busy_time_.total_microseconds() > 0) {
+    target = std::min<uint64_t>(target, (UINT64_C(2) * packets_read_ *
+                                         fill_time.total_microseconds()) /
+                                            read_busy_time_.total_microseconds());
+  }
+  packets_read_ = 0;
+  read_busy_time_ = bptime::time_duration();
+  read_period_start_ = now;
+  size_t limit = std::max<size_t>(
+      std::min<size_t>(Parameters::maximum_window_size,
+                       Parameters::maximum_receive_buffer_size / Parameters::max_size),
+      1);
+  size_t shrunk = receive_window_size_ -
+                  std::min<size_t>(receive_window_size_, Parameters::maximum_segment_size);
+  receive_window_size_ = static_cast<size_t>(std::max<uint64_t>(target, shrunk));
+  receive_window_size_ = std::max<size_t>(receive_window_size_, Parameters::default_window_size);
+  receive_window_size_ = std::min(receive_window_size_, limit);
 }
 
 void CongestionControl::OnAck(uint32_t /*seqnum*/) {}
@@ -155,9 +235,7 @@ void CongestionControl::OnAck(uint32_t /*seqnum*/, uint32_t round_trip_time,
   round_trip_time_ = round_trip_time;
   round_trip_time_variance_ = round_trip_time_variance;
 
-  ack_delay_ = bptime::microseconds(UINT64_C(4) * round_trip_time_);
-  ack_delay_ += bptime::microseconds(round_trip_time_variance_);
-  ack_delay_ += kSynPeriod;
+  UpdateAckFrequency();
 
   if (packets_receiving_rate) {
     uint64_t tmp = packets_receiving_rate_ * UINT64_C(7);
@@ -219,9 +297,34 @@ void CongestionControl::OnAckOfAck(uint32_t round_trip_time) {
   tmp = (tmp + diff) / 4;
   round_trip_time_variance_ = static_cast<uint32_t>(tmp);
 
-  ack_delay_ = bptime::microseconds(UINT64_C(4) * round_trip_time_);
-  ack_delay_ += bptime::microseconds(round_trip_time_variance_);
-  ack_delay_ += kSynPeriod;
+  UpdateAckFrequency();
+}
+
+void CongestionControl::OnAckFrequency(uint32_t ack_interval,
+                                       const bptime::time_duration& ack_delay) {
+  requested_ack_interval_ = std::max<uint32_t>(ack_interval, 1);
+  requested_ack_delay_ = ack_delay;
+  UpdateAckFrequency();
+}
+
+void CongestionControl::UpdateAckFrequency() {
+  // Never wait for more than a quarter of the receive window, so the peer's window can't fill while
+  // waiting for an ack.
+  uint32_t limit = static_cast<uint32_t>(std::min<size_t>(
+      Parameters::maximum_ack_interval, std::max<size_t>(receive_window_size_ / 4, 1)));
+  if (requested_ack_interval_ != 0) {
+    ack_interval_ = std::min(requested_ack_interval_, limit);
+    ack_delay_ = std::min(requested_ack_delay_, Parameters::maximum_ack_delay);
+    return;
+  }
+
+  // Otherwise aim for about four acks per round trip.  Until the rate and round trip time are
+  // known, that means acking every kMinAckInterval packets.
+  uint64_t quarter_rtt_packets =
+      (UINT64_C(1) * packets_receiving_rate_ * round_trip_time_) / 4000000;
+  ack_interval_ = static_cast<uint32_t>(
+      std::min<uint64_t>(std::max<uint64_t>(quarter_rtt_packets, kMinAckInterval), limit));
+  ack_delay_ = QuarterRoundTripTime(round_trip_time_);
 }
 
 void CongestionControl::SetPeerConnectionType(uint32_t connection_type) {
@@ -292,12 +395,35 @@ boost::posix_time::time_duration CongestionControl::ReceiveTimeout() const {
   return receive_timeout_;
 }
 
+bptime::time_duration CongestionControl::NegativeAckTimeout(uint32_t negative_ack_count) const {
+  // Until the round trip time is known, wait as long as the receive timeout.  After that, allow the
+  // round trip time and four deviations for the retransmission to arrive, doubling the wait after
+  // each report which didn't bring it.
+  if (round_trip_time_ == 0)
+    return receive_timeout_;
+  bptime::time_duration timeout(
+      bptime::microseconds(round_trip_time_ + UINT64_C(4) * round_trip_time_variance_));
+  timeout = std::max(timeout, kMinNegativeAckTimeout);
+  for (uint32_t i = 1; i < negative_ack_count && timeout < receive_timeout_; ++i)
+    timeout *= 2;
+  return std::min(timeout, receive_timeout_);
+}
+
 boost::posix_time::time_duration CongestionControl::AckDelay() const { return ack_delay_; }
 
 boost::posix_time::time_duration CongestionControl::AckTimeout() const { return ack_timeout_; }
 
 uint32_t CongestionControl::AckInterval() const { return ack_interval_; }
 
+uint32_t CongestionControl::PeerAckInterval() const {
+  return static_cast<uint32_t>(std::min<size_t>(std::max<size_t>(send_window_size_ / 4, 1),
+                                                Parameters::maximum_ack_interval));
+}
+
+bptime::time_duration CongestionControl::PeerAckDelay() const {
+  return QuarterRoundTripTime(round_trip_time_);
+}
+
 //  boost::posix_time::time_duration CongestionControl::AckInterval() const {
 //    return Parameters::ack_interval;
 //  }
@@ -46,6 +46,9 @@ class CongestionControl {
   void OnClose();
   void OnDataPacketSent(uint32_t seqnum);
   void OnDataPacketReceived(uint32_t seqnum);
+  // The application has read the data of packet_count received packets.  caught_up is true if it
+  // read everything which could be read (i.e. it was waiting for data rather than the other way).
+  void OnDataRead(size_t packet_count, bool caught_up);
   void OnGenerateAck(uint32_t seqnum);
   void OnAck(uint32_t seqnum);
   void OnAck(uint32_t seqnum, uint32_t round_trip_time, uint32_t round_trip_time_variance,
@@ -54,6 +57,9 @@ class CongestionControl {
   void OnNegativeAck(uint32_t seqnum);
   void OnSendTimeout(uint32_t seqnum);
   void OnAckOfAck(uint32_t round_trip_time);
+  // The peer has asked for data packets to be acked after at most ack_interval of them, or
+  // ack_delay after the first unacked one arrived.
+  void OnAckFrequency(uint32_t ack_interval, const boost::posix_time::time_duration& ack_delay);
 
   // Calculated values.
   uint32_t RoundTripTime() const;
@@ -69,11 +75,21 @@ class CongestionControl {
   boost::posix_time::time_duration SendTimeout() const;
   boost::posix_time::time_duration ReceiveDelay() const;
   boost::posix_time::time_duration ReceiveTimeout() const;
+  // How long to wait for a packet which has been reported missing negative_ack_count times before
+  // reporting it again.
+  boost::posix_time::time_duration NegativeAckTimeout(uint32_t negative_ack_count) const;
+  // The longest a received data packet may wait to be acked, and the number of data packets after
+  // which an ack is sent regardless.
   boost::posix_time::time_duration AckDelay() const;
   boost::posix_time::time_duration AckTimeout() const;
   uint32_t AckInterval() const;
   //  boost::posix_time::time_duration AckInterval() const;
 
+  // The ack frequency to request from the peer, so that acks arrive often enough to keep the send
+  // window open.
+  uint32_t PeerAckInterval() const;
+  boost::posix_time::time_duration PeerAckDelay() const;
+
   // Return the best read-buffer size
   int32_t BestReadBufferSize() const;
 
@@ -89,6 +105,14 @@ class CongestionControl {
   CongestionControl(const CongestionControl&);
   CongestionControl& operator=(const CongestionControl&);
 
+  // Recalculates ack_interval_ and ack_delay_ from the peer's request if it has made one, otherwise
+  // from the packet receiving rate and round trip time.
+  void UpdateAckFrequency();
+
+  // Resizes receive_window_size_ from the rate at which the application has been reading, once
+  // enough time has passed since the last resize to measure it.
+  void UpdateReceiveWindow();
+
   bool slow_start_phase_;
 
   uint32_t round_trip_time_;
@@ -106,10 +130,21 @@ class CongestionControl {
   boost::posix_time::time_duration ack_delay_;
   boost::posix_time::time_duration ack_timeout_;
   uint32_t ack_interval_;
+  // Zero if the peer hasn't requested an ack frequency.
+  uint32_t requested_ack_interval_;
+  boost::posix_time::time_duration requested_ack_delay_;
 
   size_t lost_packets_;
   size_t corrupted_packets_;
 
+  // The number of received packets the application has read since read_period_start_, and how long
+  // of that it has had data waiting to be read.
+  size_t packets_read_;
+  boost::posix_time::ptime read_period_start_;
+  boost::posix_time::ptime last_read_time_;
+  boost::posix_time::time_duration read_busy_time_;
+  bool reader_caught_up_;
+
   enum {
     kMaxArrivalTimes = 16 + 1
   };
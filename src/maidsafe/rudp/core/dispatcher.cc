@@ -37,43 +37,39 @@ namespace rudp {
 
 namespace detail {
 
-Dispatcher::Dispatcher() : connection_manager_(nullptr) {}
+Dispatcher::Dispatcher() : connection_manager_(nullptr), shard_(0) {}
 
-void Dispatcher::SetConnectionManager(ConnectionManager *connection_manager) {
-  std::lock_guard<decltype(mutex_)> guard(mutex_);
-  connection_manager_ = connection_manager;
+void Dispatcher::SetConnectionManager(ConnectionManager *connection_manager, size_t shard) {
+  if (connection_manager) {
+    shard_.store(shard, std::memory_order_relaxed);
+    connection_manager_.store(connection_manager, std::memory_order_release);
+  } else {
+    connection_manager_.store(nullptr, std::memory_order_release);
+    shard_.store(shard, std::memory_order_relaxed);
+  }
 }
 
 uint32_t Dispatcher::AddSocket(Socket* socket) {
-  ConnectionManager *connection_manager;
-  {
-    std::lock_guard<decltype(mutex_)> guard(mutex_);
-    connection_manager = connection_manager_;
-  }
-  return connection_manager ? connection_manager->AddSocket(socket) : 0;
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
+  return connection_manager ?
+      connection_manager->AddSocket(socket, shard_.load(std::memory_order_relaxed)) : 0;
 }
 
 void Dispatcher::RemoveSocket(uint32_t id) {
-  ConnectionManager *connection_manager;
-  {
-    std::lock_guard<decltype(mutex_)> guard(mutex_);
-    connection_manager = connection_manager_;
-  }
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
   if (connection_manager)
     connection_manager->RemoveSocket(id);
 }
 
 void Dispatcher::HandleReceiveFrom(const boost::asio::const_buffer& data,
-                                   const ip::udp::endpoint& endpoint) {
-  ConnectionManager* connection_manager;
-  {
-    std::lock_guard<decltype(mutex_)> guard(mutex_);
-    connection_manager = connection_manager_;
-  }
+                                   const ip::udp::endpoint& endpoint,
+                                   const SharedBufferPtr& buffer) {
+  ConnectionManager* connection_manager(connection_manager_.load(std::memory_order_acquire));
   if (connection_manager) {
-    Socket* socket(connection_manager->GetSocket(data, endpoint));
+    Socket* socket(connection_manager->GetSocket(data, endpoint,
+                                                 shard_.load(std::memory_order_relaxed)));
     if (socket) {
-      socket->HandleReceiveFrom(data, endpoint);
+      socket->HandleReceiveFrom(data, endpoint, buffer);
     }
   }
 }
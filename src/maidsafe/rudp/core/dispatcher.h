@@ -21,12 +21,15 @@
 #ifndef MAIDSAFE_RUDP_CORE_DISPATCHER_H_
 #define MAIDSAFE_RUDP_CORE_DISPATCHER_H_
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <mutex>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/ip/udp.hpp"
 
+#include "maidsafe/rudp/core/shared_buffer.h"
+
 namespace maidsafe {
 
 namespace rudp {
@@ -40,7 +43,9 @@ class Dispatcher {
  public:
   Dispatcher();
 
-  void SetConnectionManager(ConnectionManager* connection_manager);
+  // Set the connection manager, and the index of this dispatcher's multiplexer amongst those it
+  // manages.
+  void SetConnectionManager(ConnectionManager* connection_manager, size_t shard);
 
   // Add a socket. Returns a new unique id for the socket.
   uint32_t AddSocket(Socket* socket);
@@ -48,17 +53,21 @@ class Dispatcher {
   // Remove the socket corresponding to the given id.
   void RemoveSocket(uint32_t id);
 
-  // Handle a new packet by dispatching to the appropriate socket.
+  // Handle a new packet by dispatching to the appropriate socket.  The packet lies within buffer,
+  // to which the socket may keep a reference rather than copying the packet's payload.
   void HandleReceiveFrom(const boost::asio::const_buffer& data,
-                         const boost::asio::ip::udp::endpoint& endpoint);
+                         const boost::asio::ip::udp::endpoint& endpoint,
+                         const SharedBufferPtr& buffer);
 
  private:
   // Disallow copying and assignment.
   Dispatcher(const Dispatcher&);
   Dispatcher& operator=(const Dispatcher&);
 
-  std::mutex mutex_;
-  ConnectionManager* connection_manager_;
+  // Read on every received packet, so kept as atomics rather than behind a mutex.  shard_ is
+  // stored before connection_manager_ is published, and never changes while it is non-null.
+  std::atomic<ConnectionManager*> connection_manager_;
+  std::atomic<size_t> shard_;
 };
 
 }  // namespace detail
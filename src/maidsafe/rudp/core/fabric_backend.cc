@@ -0,0 +1,370 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/fabric_backend.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include "boost/asio/error.hpp"
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/utils.h"
+
+namespace asio = boost::asio;
+namespace ip = boost::asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// The number of datagrams each port's queue holds, roughly what a socket's default receive buffer
+// holds.  Must be a power of two.
+const size_t kQueueCapacity = 512;
+
+// The most datagrams passed on by a single call to Receive, so that a busy port can't starve the
+// multiplexer's other work.
+const size_t kMaxReceivesPerCall = 64;
+
+// The number of released send buffers kept for reuse by each backend.
+const size_t kMaxFreeSendBuffers = 64;
+
+// Binds to port 0 are given a free port from the dynamic range.
+const uint16_t kFirstDynamicPort = 49152;
+const uint16_t kDynamicPortCount = 16384;
+
+// The number of independently locked parts of the fabric's route table.
+const size_t kRouteStripes = 64;
+
+}  // unnamed namespace
+
+class FabricBackend::Port {
+ public:
+  struct Datagram {
+    Datagram() : buffer(), length(0), sender() {}
+    SharedBufferPtr buffer;
+    size_t length;
+    ip::udp::endpoint sender;
+  };
+
+  explicit Port(asio::io_service& io_service)
+      : io_service_(io_service),
+        endpoint_(),
+        cells_(new Cell[kQueueCapacity]),
+        enqueue_position_(0),
+        dequeue_position_(0),
+        waiter_mutex_(),
+        waiter_(),
+        work_(),
+        has_waiter_(false),
+        closed_(false) {
+    for (size_t i(0); i < kQueueCapacity; ++i)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  const ip::udp::endpoint& Endpoint() const { return endpoint_; }
+  void SetEndpoint(const ip::udp::endpoint& endpoint) { endpoint_ = endpoint; }
+  bool IsClosed() const { return closed_; }
+
+  // Queue a datagram and wake the receiver if it's waiting.  May be called from any thread.
+  // Returns false if the queue is full or the port closed, in which case the datagram is dropped.
+  bool Push(const SharedBufferPtr& buffer, size_t length, const ip::udp::endpoint& sender) {
+    if (closed_)
+      return false;
+    // Claim a cell, then publish the datagram in it by advancing the cell's sequence number.  A
+    // cell is free for position p once its sequence number is p, and full once it's p + 1.
+    size_t position(enqueue_position_.load(std::memory_order_relaxed));
+    Cell* cell(nullptr);
+    for (;;) {
+      cell = &cells_[position & (kQueueCapacity - 1)];
+      size_t sequence(cell->sequence.load(std::memory_order_acquire));
+      if (sequence == position) {
+        if (enqueue_position_.compare_exchange_weak(position, position + 1,
+                                                    std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (sequence < position) {
+        return false;
+      } else {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->datagram.buffer = buffer;
+    cell->datagram.length = length;
+    cell->datagram.sender = sender;
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    // Pairs with the fence in Wait, so that either the receiver sees this datagram or this sees the
+    // receiver waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (has_waiter_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(waiter_mutex_);
+      if (waiter_)
+        PostWaiter(bs::error_code());
+    }
+    return true;
+  }
+
+  // Take the oldest datagram from the queue.  Only the port's receiver may call this.
+  bool Pop(Datagram& datagram) {
+    Cell& cell(cells_[dequeue_position_ & (kQueueCapacity - 1)]);
+    if (cell.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1)
+      return false;
+    datagram = std::move(cell.datagram);
+    cell.sequence.store(dequeue_position_ + kQueueCapacity, std::memory_order_release);
+    ++dequeue_position_;
+    return true;
+  }
+
+  // Call handler once the queue isn't empty, or with an error once the port is closed.
+  void Wait(WaitHandler handler) {
+    std::lock_guard<std::mutex> lock(waiter_mutex_);
+    waiter_ = std::move(handler);
+    // As with any asio operation, the io_service mustn't run out of work while the wait is pending.
+    work_.reset(new asio::io_service::work(io_service_));
+    if (closed_) {
+      PostWaiter(asio::error::operation_aborted);
+      return;
+    }
+    has_waiter_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const Cell& cell(cells_[dequeue_position_ & (kQueueCapacity - 1)]);
+    if (cell.sequence.load(std::memory_order_acquire) == dequeue_position_ + 1)
+      PostWaiter(bs::error_code());
+  }
+
+  // Refuse further datagrams and abort any wait in progress.
+  void Close() {
+    closed_ = true;
+    std::lock_guard<std::mutex> lock(waiter_mutex_);
+    if (waiter_)
+      PostWaiter(asio::error::operation_aborted);
+  }
+
+ private:
+  // Disallow copying and assignment.
+  Port(const Port&);
+  Port& operator=(const Port&);
+
+  struct Cell {
+    Cell() : sequence(0), datagram() {}
+    std::atomic<size_t> sequence;
+    Datagram datagram;
+  };
+
+  // Requires waiter_mutex_ to be held.
+  void PostWaiter(const bs::error_code& ec) {
+    has_waiter_.store(false, std::memory_order_relaxed);
+    WaitHandler handler(std::move(waiter_));
+    waiter_ = nullptr;
+    io_service_.post([handler, ec] { handler(ec); });
+    work_.reset();
+  }
+
+  asio::io_service& io_service_;
+  ip::udp::endpoint endpoint_;
+  std::unique_ptr<Cell[]> cells_;
+  std::atomic<size_t> enqueue_position_;
+  size_t dequeue_position_;
+  std::mutex waiter_mutex_;
+  WaitHandler waiter_;
+  std::unique_ptr<asio::io_service::work> work_;
+  std::atomic<bool> has_waiter_, closed_;
+};
+
+namespace {
+
+// The process-wide table of bound ports.
+class Fabric {
+ public:
+  typedef std::shared_ptr<FabricBackend::Port> PortPtr;
+
+  static Fabric& Instance() {
+    // Never destroyed, since multiplexers may outlive other statics.
+    static Fabric* const fabric(new Fabric);
+    return *fabric;
+  }
+
+  ReturnCode Bind(const PortPtr& port, const ip::udp::endpoint& endpoint) {
+    if (endpoint.port() != 0)
+      return Insert(port, endpoint) ? kSuccess : kBindError;
+    for (uint16_t i(0); i < kDynamicPortCount; ++i) {
+      ip::udp::endpoint candidate(endpoint.address(),
+                                  kFirstDynamicPort + (next_port_++ % kDynamicPortCount));
+      if (Insert(port, candidate))
+        return kSuccess;
+    }
+    return kBindError;
+  }
+
+  void Unbind(const FabricBackend::Port& port) {
+    Stripe& stripe(StripeFor(port.Endpoint()));
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto itr(stripe.routes.find(port.Endpoint()));
+    if (itr != stripe.routes.end() && itr->second.get() == &port)
+      stripe.routes.erase(itr);
+  }
+
+  PortPtr Find(const ip::udp::endpoint& endpoint) {
+    Stripe& stripe(StripeFor(endpoint));
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto itr(stripe.routes.find(endpoint));
+    return itr == stripe.routes.end() ? PortPtr() : itr->second;
+  }
+
+ private:
+  struct Stripe {
+    std::mutex mutex;
+    std::unordered_map<ip::udp::endpoint, PortPtr, EndpointHash> routes;
+  };
+
+  Fabric() : stripes_(), next_port_(0) {}
+
+  Stripe& StripeFor(const ip::udp::endpoint& endpoint) {
+    return stripes_[EndpointHash()(endpoint) % kRouteStripes];
+  }
+
+  bool Insert(const PortPtr& port, const ip::udp::endpoint& endpoint) {
+    Stripe& stripe(StripeFor(endpoint));
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    if (stripe.routes.count(endpoint) != 0)
+      return false;
+    port->SetEndpoint(endpoint);
+    stripe.routes.insert(std::make_pair(endpoint, port));
+    return true;
+  }
+
+  std::array<Stripe, kRouteStripes> stripes_;
+  std::atomic<uint16_t> next_port_;
+};
+
+}  // unnamed namespace
+
+FabricBackend::FabricBackend(ip::udp::socket& socket)
+    : io_service_(socket.get_io_service()),
+      port_(),
+      send_buffer_pool_(SharedBufferPool::Create(Parameters::max_size, kMaxFreeSendBuffers)) {}
+
+FabricBackend::~FabricBackend() {
+  Close();
+}
+
+ReturnCode FabricBackend::Bind(const ip::udp::endpoint& endpoint) {
+  std::shared_ptr<Port> port(std::make_shared<Port>(io_service_));
+  ReturnCode result(Fabric::Instance().Bind(port, endpoint));
+  if (result != kSuccess) {
+    LOG(kError) << "Fabric endpoint " << endpoint << " is already bound.";
+    return result;
+  }
+  port_ = port;
+  return kSuccess;
+}
+
+bool FabricBackend::IsOpen() const {
+  return port_ && !port_->IsClosed();
+}
+
+ip::udp::endpoint FabricBackend::LocalEndpoint(bs::error_code& ec) const {
+  if (!IsOpen()) {
+    ec = asio::error::bad_descriptor;
+    return ip::udp::endpoint();
+  }
+  ec.clear();
+  return port_->Endpoint();
+}
+
+void FabricBackend::Close() {
+  if (!IsOpen())
+    return;
+  Fabric::Instance().Unbind(*port_);
+  port_->Close();
+}
+
+void FabricBackend::AsyncWait(WaitHandler handler) {
+  if (!port_) {
+    io_service_.post([handler] { handler(asio::error::bad_descriptor); });
+    return;
+  }
+  port_->Wait(std::move(handler));
+}
+
+void FabricBackend::Receive(const ReceiveHandler& handler, bs::error_code& ec) {
+  ec.clear();
+  if (!IsOpen()) {
+    ec = asio::error::bad_descriptor;
+    return;
+  }
+  Port::Datagram datagram;
+  size_t count(0);
+  while (count < kMaxReceivesPerCall && port_->Pop(datagram)) {
+    handler(asio::buffer(datagram.buffer->Data(), datagram.length), datagram.sender,
+            datagram.buffer);
+    ++count;
+  }
+  if (count == 0)
+    ec = asio::error::would_block;
+}
+
+template <typename BufferSequence>
+void FabricBackend::Deliver(const BufferSequence& buffers, const ip::udp::endpoint& endpoint) {
+  std::shared_ptr<Port> destination(Fabric::Instance().Find(endpoint));
+  if (!destination)
+    return;
+  // As with a socket, any part of the datagram which doesn't fit the receive buffer is lost.
+  SharedBufferPtr buffer(send_buffer_pool_->Acquire());
+  size_t length(asio::buffer_copy(asio::buffer(buffer->Data(), buffer->Capacity()), buffers));
+  destination->Push(buffer, length, port_->Endpoint());
+}
+
+void FabricBackend::SendTo(const std::vector<asio::mutable_buffer>& buffers,
+                           const ip::udp::endpoint& endpoint, bs::error_code& ec) {
+  ec.clear();
+  if (!IsOpen()) {
+    ec = asio::error::bad_descriptor;
+    return;
+  }
+  Deliver(buffers, endpoint);
+}
+
+size_t FabricBackend::Send(TransmitBatch& batch, size_t& /*segment_limit*/,
+                           ZeroCopyTracker* /*zero_copy*/, bs::error_code& ec) {
+  return batch.Send([this](const std::vector<asio::const_buffer>& buffers,
+                           const ip::udp::endpoint& endpoint, bs::error_code& send_ec) {
+                      if (IsOpen())
+                        Deliver(buffers, endpoint);
+                      else
+                        send_ec = asio::error::bad_descriptor;
+                    }, ec);
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
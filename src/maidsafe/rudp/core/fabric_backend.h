@@ -0,0 +1,91 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_FABRIC_BACKEND_H_
+#define MAIDSAFE_RUDP_CORE_FABRIC_BACKEND_H_
+
+#include <memory>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/rudp/core/multiplexer_backend.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A multiplexer backend which passes datagrams in memory between the multiplexers of this process,
+// without sockets or system calls.  Each bound endpoint is a port on a process-wide fabric, so any
+// number of nodes may be simulated using made-up addresses, and the protocol's own costs measured
+// without those of the kernel.
+//
+// Each port has a bounded lock-free queue which any thread may send to and only its multiplexer
+// receives from.  As with UDP, datagrams sent to a full queue or an unbound endpoint are silently
+// dropped.  A sent datagram is copied into a pooled buffer, which the receiving packets may keep
+// referring to as they would a buffer received from a socket.
+class FabricBackend : public MultiplexerBackend {
+ public:
+  explicit FabricBackend(boost::asio::ip::udp::socket& socket);
+  virtual ~FabricBackend();
+
+  virtual bool UsesSocket() const { return false; }
+  virtual ReturnCode Bind(const boost::asio::ip::udp::endpoint& endpoint);
+  virtual bool Open() { return true; }
+  virtual bool IsOpen() const;
+  virtual boost::asio::ip::udp::endpoint LocalEndpoint(boost::system::error_code& ec) const;
+  virtual void Close();
+  virtual void AsyncWait(WaitHandler handler);
+  virtual void Receive(const ReceiveHandler& handler, boost::system::error_code& ec);
+  virtual void SendTo(const std::vector<boost::asio::mutable_buffer>& buffers,
+                      const boost::asio::ip::udp::endpoint& endpoint,
+                      boost::system::error_code& ec);
+  virtual size_t Send(TransmitBatch& batch, size_t& segment_limit, ZeroCopyTracker* zero_copy,
+                      boost::system::error_code& ec);
+
+  // A bound endpoint and its queue of received datagrams.  Defined in fabric_backend.cc.
+  class Port;
+
+ private:
+  // Disallow copying and assignment.
+  FabricBackend(const FabricBackend&);
+  FabricBackend& operator=(const FabricBackend&);
+
+  // Copy the datagram gathered from buffers into a pooled buffer and queue it at endpoint's port.
+  template <typename BufferSequence>
+  void Deliver(const BufferSequence& buffers, const boost::asio::ip::udp::endpoint& endpoint);
+
+  boost::asio::io_service& io_service_;
+  // The port bound by the last call to Bind.  Only replaced while the multiplexer is closed.
+  std::shared_ptr<Port> port_;
+  // Buffers which sent datagrams are copied into.  They return here once every packet decoded
+  // from them at the receiving end has been released.
+  std::shared_ptr<SharedBufferPool> send_buffer_pool_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_FABRIC_BACKEND_H_
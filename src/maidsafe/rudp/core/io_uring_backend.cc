@@ -0,0 +1,569 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/io_uring_backend.h"
+
+#ifdef MAIDSAFE_RUDP_IO_URING_BACKEND
+
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <functional>
+#include <cstring>
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/rudp/parameters.h"
+
+#ifndef __NR_io_uring_setup
+#  define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#  define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#  define __NR_io_uring_register 427
+#endif
+
+namespace asio = boost::asio;
+namespace ip = boost::asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// The number of buffers provided to the kernel for receiving.  Must be a power of two.
+const unsigned kReceiveBufferCount = 256;
+const uint16_t kBufferGroup = 0;
+
+// The receive ring only ever holds the multishot receive and a cancellation of it, but needs room
+// for a completion per provided buffer.
+const unsigned kReceiveRingEntries = 4;
+const unsigned kReceiveCompletionEntries = kReceiveBufferCount * 2;
+
+// The longest chain of sends submitted at once.  Larger batches are sent in several chains.
+const unsigned kSendRingEntries = 64;
+
+// Identifies the completions on the receive ring.
+const uint64_t kReceiveTag = 1;
+const uint64_t kCancelTag = 2;
+
+int Setup(unsigned entries, io_uring_params& params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int Register(int descriptor, unsigned opcode, void* argument, unsigned count) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, descriptor, opcode, argument, count));
+}
+
+template <typename T>
+T LoadAcquire(const T* value) {
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void StoreRelease(T* location, T value) {
+  __atomic_store_n(location, value, __ATOMIC_RELEASE);
+}
+
+}  // unnamed namespace
+
+IoUringBackend::Ring::Ring()
+    : descriptor_(-1),
+      rings_(MAP_FAILED),
+      rings_size_(0),
+      submissions_(nullptr),
+      submissions_size_(0),
+      submission_head_(nullptr),
+      submission_tail_(nullptr),
+      submission_mask_(0),
+      submission_entries_(0),
+      completion_head_(nullptr),
+      completion_tail_(nullptr),
+      completion_mask_(0),
+      completions_(nullptr),
+      local_tail_(0) {}
+
+bool IoUringBackend::Ring::Create(unsigned entries, unsigned completion_entries) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  if (completion_entries != 0) {
+    params.flags |= IORING_SETUP_CQSIZE;
+    params.cq_entries = completion_entries;
+  }
+  descriptor_ = Setup(entries, params);
+  if (descriptor_ < 0)
+    return false;
+  // Kernels old enough to need separate mappings for the two queues lack the features used here.
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+    Destroy();
+    return false;
+  }
+
+  rings_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                         params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  rings_ = ::mmap(nullptr, rings_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  descriptor_, IORING_OFF_SQ_RING);
+  submissions_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* submissions(::mmap(nullptr, submissions_size_, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, descriptor_, IORING_OFF_SQES));
+  if (rings_ == MAP_FAILED || submissions == MAP_FAILED) {
+    if (submissions != MAP_FAILED)
+      ::munmap(submissions, submissions_size_);
+    Destroy();
+    return false;
+  }
+  submissions_ = static_cast<io_uring_sqe*>(submissions);
+
+  char* base(static_cast<char*>(rings_));
+  submission_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+  submission_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+  submission_mask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+  submission_entries_ = params.sq_entries;
+  completion_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+  completion_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+  completion_mask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+  completions_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+  // Each slot of the submission queue permanently refers to the entry with the same index.
+  unsigned* array(reinterpret_cast<unsigned*>(base + params.sq_off.array));
+  for (unsigned i = 0; i < submission_entries_; ++i)
+    array[i] = i;
+  local_tail_ = *submission_tail_;
+  return true;
+}
+
+void IoUringBackend::Ring::Destroy() {
+  if (submissions_)
+    ::munmap(submissions_, submissions_size_);
+  if (rings_ != MAP_FAILED)
+    ::munmap(rings_, rings_size_);
+  if (descriptor_ >= 0)
+    ::close(descriptor_);
+  descriptor_ = -1;
+  rings_ = MAP_FAILED;
+  submissions_ = nullptr;
+}
+
+io_uring_sqe* IoUringBackend::Ring::NextSubmission() {
+  if (local_tail_ - LoadAcquire(submission_head_) >= submission_entries_)
+    return nullptr;
+  io_uring_sqe* submission(&submissions_[local_tail_ & submission_mask_]);
+  std::memset(submission, 0, sizeof(*submission));
+  ++local_tail_;
+  return submission;
+}
+
+int IoUringBackend::Ring::Enter(unsigned wait_count) {
+  StoreRelease(submission_tail_, local_tail_);
+  for (;;) {
+    unsigned pending(local_tail_ - LoadAcquire(submission_head_));
+    if (pending == 0 && wait_count == 0)
+      return 0;
+    int result(static_cast<int>(::syscall(__NR_io_uring_enter, descriptor_, pending, wait_count,
+                                           wait_count != 0 ? IORING_ENTER_GETEVENTS : 0U,
+                                           nullptr, 0)));
+    if (result >= 0 && static_cast<unsigned>(result) >= pending)
+      return 0;
+    if (result < 0 && errno != EINTR)
+      return -errno;
+  }
+}
+
+io_uring_cqe* IoUringBackend::Ring::PeekCompletion() {
+  unsigned head(*completion_head_);
+  if (head == LoadAcquire(completion_tail_))
+    return nullptr;
+  return &completions_[head & completion_mask_];
+}
+
+void IoUringBackend::Ring::ConsumeCompletion() {
+  StoreRelease(completion_head_, *completion_head_ + 1);
+}
+
+IoUringBackend::IoUringBackend(ip::udp::socket& socket)
+    : socket_(socket),
+      io_service_(socket.get_io_service()),
+      mutex_(),
+      open_(false),
+      receiving_(false),
+      receive_ring_(),
+      receive_header_(),
+      buffer_ring_(nullptr),
+      buffer_ring_size_(0),
+      buffer_ring_tail_(0),
+      receive_buffer_pool_(),
+      buffers_(),
+      received_(),
+      event_descriptor_(socket.get_io_service()),
+      event_count_(0),
+      receive_fallback_(),
+      send_mutex_(),
+      send_ring_() {}
+
+IoUringBackend::~IoUringBackend() { Close(); }
+
+bool IoUringBackend::Open() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (open_)
+    return true;
+  if (!receive_ring_.Create(kReceiveRingEntries, kReceiveCompletionEntries) ||
+      !send_ring_.Create(kSendRingEntries, 0)) {
+    LOG(kInfo) << "io_uring unavailable - errno " << errno;
+    Release();
+    return false;
+  }
+
+  // Register the ring of buffers which the kernel takes receive buffers from.  Each buffer holds
+  // the kernel's description of the message and the sender's address, followed by the datagram.
+  buffer_ring_size_ = kReceiveBufferCount * sizeof(io_uring_buf);
+  void* buffer_ring(::mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (buffer_ring == MAP_FAILED) {
+    Release();
+    return false;
+  }
+  buffer_ring_ = static_cast<io_uring_buf_ring*>(buffer_ring);
+  io_uring_buf_reg registration;
+  std::memset(&registration, 0, sizeof(registration));
+  registration.ring_addr = reinterpret_cast<uint64_t>(buffer_ring_);
+  registration.ring_entries = kReceiveBufferCount;
+  registration.bgid = kBufferGroup;
+  if (Register(receive_ring_.Descriptor(), IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+    LOG(kInfo) << "io_uring provided buffer rings unsupported - errno " << errno;
+    Release();
+    return false;
+  }
+
+  receive_header_ = msghdr();
+  receive_header_.msg_namelen = sizeof(sockaddr_in6);
+  receive_buffer_pool_ = SharedBufferPool::Create(
+      sizeof(io_uring_recvmsg_out) + receive_header_.msg_namelen + Parameters::max_size,
+      kReceiveBufferCount);
+  buffers_.resize(kReceiveBufferCount);
+  buffer_ring_tail_ = 0;
+  for (uint16_t i = 0; i < kReceiveBufferCount; ++i) {
+    buffers_[i] = receive_buffer_pool_->Acquire();
+    ProvideBuffer(i);
+  }
+  PublishBuffers();
+
+  // Have the kernel signal each completion through an eventfd, which asio can wait on.
+  int event_descriptor(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  if (event_descriptor < 0 || Register(receive_ring_.Descriptor(), IORING_REGISTER_EVENTFD,
+                                       &event_descriptor, 1) != 0) {
+    if (event_descriptor >= 0)
+      ::close(event_descriptor);
+    Release();
+    return false;
+  }
+  bs::error_code ec;
+  event_descriptor_.assign(event_descriptor, ec);
+  if (ec) {
+    ::close(event_descriptor);
+    Release();
+    return false;
+  }
+
+  // The receive is only armed by the first Receive, since the kernel cancels a request when the
+  // thread which submitted it exits, and Open may be called from a transient thread.
+  open_ = true;
+  receiving_ = false;
+  receive_fallback_.reset();
+  return true;
+}
+
+void IoUringBackend::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!open_)
+    return;
+  open_ = false;
+  if (receiving_) {
+    // The kernel may write to the provided buffers until the multishot receive has ended.
+    io_uring_sqe* submission(receive_ring_.NextSubmission());
+    if (submission) {
+      submission->opcode = IORING_OP_ASYNC_CANCEL;
+      submission->addr = kReceiveTag;
+      submission->user_data = kCancelTag;
+    }
+    int result(receive_ring_.Enter(0));
+    while (receiving_ && submission && result == 0) {
+      io_uring_cqe* completion(receive_ring_.PeekCompletion());
+      if (!completion) {
+        result = receive_ring_.Enter(1);
+        continue;
+      }
+      if (completion->user_data == kReceiveTag && (completion->flags & IORING_CQE_F_MORE) == 0)
+        receiving_ = false;
+      receive_ring_.ConsumeCompletion();
+    }
+    if (receiving_)
+      LOG(kError) << "Failed to cancel io_uring receive - error " << -result;
+  }
+  Release();
+}
+
+void IoUringBackend::Release() {
+  bs::error_code ec;
+  event_descriptor_.close(ec);
+  if (buffer_ring_ && !receiving_) {
+    // If the receive couldn't be cancelled the kernel may still use the buffers, so leak them.
+    ::munmap(buffer_ring_, buffer_ring_size_);
+    buffers_.clear();
+  }
+  buffer_ring_ = nullptr;
+  receiving_ = false;
+  receive_ring_.Destroy();
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  send_ring_.Destroy();
+}
+
+void IoUringBackend::AsyncWait(WaitHandler handler) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!open_) {
+    io_service_.post(std::bind(handler, bs::error_code(asio::error::bad_descriptor)));
+    return;
+  }
+  if (receive_fallback_) {
+    receive_fallback_->AsyncWait(handler);
+    return;
+  }
+  if (!receiving_) {
+    io_service_.post(std::bind(handler, bs::error_code()));
+    return;
+  }
+  // Reading the eventfd resets it, and completes straight away if anything was posted since the
+  // last read, so no completion can be missed between Receive reaping and the next wait.
+  event_descriptor_.async_read_some(asio::buffer(&event_count_, sizeof(event_count_)),
+                                    [handler](const bs::error_code& ec, size_t) { handler(ec); });
+}
+
+void IoUringBackend::Receive(const ReceiveHandler& handler, bs::error_code& ec) {
+  ec.clear();
+  AsioBackend* receive_fallback(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+      ec = asio::error::bad_descriptor;
+      return;
+    }
+    receive_fallback = receive_fallback_.get();
+    if (!receive_fallback) {
+      ReapReceives();
+      if (received_.empty()) {
+        if (!receiving_)
+          ArmReceive();
+        ec = asio::error::would_block;
+        return;
+      }
+    }
+  }
+  if (receive_fallback) {
+    receive_fallback->Receive(handler, ec);
+    return;
+  }
+
+  // Dispatch without the lock, since handling a packet may involve closing the multiplexer.
+  for (const Received& received : received_)
+    handler(received.data, received.sender_endpoint, received.buffer);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Received& received : received_) {
+    received.buffer.reset();
+    if (open_)
+      ProvideBuffer(received.buffer_id);
+  }
+  received_.clear();
+  if (open_) {
+    PublishBuffers();
+    // The kernel ends a multishot receive if it runs out of buffers or completion queue space.
+    if (!receiving_)
+      ArmReceive();
+  }
+}
+
+void IoUringBackend::ArmReceive() {
+  int result(-EBUSY);
+  if (io_uring_sqe* submission = receive_ring_.NextSubmission()) {
+    submission->opcode = IORING_OP_RECVMSG;
+    submission->fd = socket_.native_handle();
+    submission->addr = reinterpret_cast<uint64_t>(&receive_header_);
+    submission->len = 1;
+    submission->ioprio = IORING_RECV_MULTISHOT;
+    submission->flags = IOSQE_BUFFER_SELECT;
+    submission->buf_group = kBufferGroup;
+    submission->user_data = kReceiveTag;
+    result = receive_ring_.Enter(0);
+    if (result == 0) {
+      receiving_ = true;
+      return;
+    }
+  }
+  // Nothing else would arm it, so without a fallback every wait would complete straight away.
+  LOG(kError) << "Failed to submit io_uring receive - error " << -result
+              << " - falling back to asio";
+  receive_fallback_.reset(new AsioBackend(socket_));
+  receive_fallback_->Open();
+}
+
+void IoUringBackend::ReapReceives() {
+  const size_t header_size(sizeof(io_uring_recvmsg_out) + receive_header_.msg_namelen);
+  while (io_uring_cqe* completion = receive_ring_.PeekCompletion()) {
+    if (completion->user_data != kReceiveTag) {
+      receive_ring_.ConsumeCompletion();
+      continue;
+    }
+    if ((completion->flags & IORING_CQE_F_MORE) == 0)
+      receiving_ = false;
+    if (completion->res < 0 && completion->res != -ENOBUFS && completion->res != -ECANCELED)
+      LOG(kWarning) << "io_uring receive failed - error " << -completion->res;
+    if ((completion->flags & IORING_CQE_F_BUFFER) == 0) {
+      receive_ring_.ConsumeCompletion();
+      continue;
+    }
+
+    uint16_t buffer_id(static_cast<uint16_t>(completion->flags >> IORING_CQE_BUFFER_SHIFT));
+    const SharedBufferPtr& buffer(buffers_[buffer_id]);
+    io_uring_recvmsg_out message;
+    std::memcpy(&message, buffer->Data(), sizeof(message));
+    size_t length(completion->res > 0 ? static_cast<size_t>(completion->res) : 0);
+    // Truncated datagrams are larger than any packet, so are dropped.
+    if (length < header_size || (message.flags & MSG_TRUNC) != 0 ||
+        message.namelen > receive_header_.msg_namelen) {
+      ProvideBuffer(buffer_id);
+      receive_ring_.ConsumeCompletion();
+      continue;
+    }
+
+    received_.push_back(Received());
+    Received& received(received_.back());
+    received.buffer_id = buffer_id;
+    received.buffer = buffer;
+    received.data = asio::buffer(buffer->Data() + header_size,
+                                 std::min<size_t>(message.payloadlen, length - header_size));
+    std::memcpy(received.sender_endpoint.data(), buffer->Data() + sizeof(message),
+                message.namelen);
+    received.sender_endpoint.resize(message.namelen);
+    receive_ring_.ConsumeCompletion();
+  }
+  PublishBuffers();
+}
+
+void IoUringBackend::ProvideBuffer(uint16_t buffer_id) {
+  if (!buffers_[buffer_id]->IsUnique())
+    buffers_[buffer_id] = receive_buffer_pool_->Acquire();
+  // The ring is indexed directly, since in C++ the header's flexible array member is offset by an
+  // empty struct.  The first entry's last field doubles as the ring's tail.
+  io_uring_buf& entry(reinterpret_cast<io_uring_buf*>(buffer_ring_)[buffer_ring_tail_ &
+                                                                    (kReceiveBufferCount - 1)]);
+  entry.addr = reinterpret_cast<uint64_t>(buffers_[buffer_id]->Data());
+  entry.len = static_cast<uint32_t>(buffers_[buffer_id]->Capacity());
+  entry.bid = buffer_id;
+  ++buffer_ring_tail_;
+}
+
+void IoUringBackend::PublishBuffers() {
+  StoreRelease(&buffer_ring_->tail, buffer_ring_tail_);
+}
+
+void IoUringBackend::SendTo(const std::vector<asio::mutable_buffer>& buffers,
+                            const ip::udp::endpoint& endpoint, bs::error_code& ec) {
+  socket_.send_to(buffers, endpoint, 0, ec);
+}
+
+size_t IoUringBackend::Send(TransmitBatch& batch, size_t& segment_limit,
+                            ZeroCopyTracker* zero_copy, bs::error_code& ec) {
+  int descriptor(socket_.native_handle());
+  return batch.Send([this, descriptor](mmsghdr* messages, unsigned int count, int flags) {
+                      // Zero-copy completions are tracked through the socket's error queue,
+                      // which needs the sends numbered in the order they're made.
+                      if (flags != 0)
+                        return ::sendmmsg(descriptor, messages, count, flags);
+                      return SubmitSends(messages, count, flags);
+                    }, segment_limit, zero_copy, ec);
+}
+
+int IoUringBackend::SubmitSends(mmsghdr* messages, unsigned int count, int flags) {
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  if (send_ring_.Descriptor() < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  count = std::min(count, kSendRingEntries);
+  for (unsigned int i = 0; i < count; ++i) {
+    io_uring_sqe* submission(send_ring_.NextSubmission());
+    submission->opcode = IORING_OP_SENDMSG;
+    submission->fd = socket_.native_handle();
+    submission->addr = reinterpret_cast<uint64_t>(&messages[i].msg_hdr);
+    submission->len = 1;
+    submission->msg_flags = static_cast<uint32_t>(flags);
+    submission->user_data = i;
+    if (i + 1 < count)
+      submission->flags = IOSQE_IO_LINK;
+  }
+
+  int result(send_ring_.Enter(count));
+  // Every submission completes, so all must be consumed even if waiting failed.  A failure cancels
+  // the rest of the chain, so the messages accepted are those before the first failure.
+  unsigned int completed(0), accepted(count);
+  int error(0);
+  while (completed < count && result == 0) {
+    io_uring_cqe* completion(send_ring_.PeekCompletion());
+    if (!completion) {
+      result = send_ring_.Enter(1);
+      continue;
+    }
+    unsigned int index(static_cast<unsigned int>(completion->user_data));
+    if (completion->res < 0 && index < accepted) {
+      accepted = index;
+      error = -completion->res;
+    } else if (completion->res >= 0) {
+      messages[index].msg_len = static_cast<unsigned int>(completion->res);
+    }
+    send_ring_.ConsumeCompletion();
+    ++completed;
+  }
+  if (result != 0) {
+    // The ring is unusable, and the submissions still outstanding may yet complete.
+    LOG(kError) << "io_uring send failed - error " << -result;
+    send_ring_.Destroy();
+    errno = -result;
+    return -1;
+  }
+  if (accepted == 0) {
+    errno = error;
+    return -1;
+  }
+  return static_cast<int>(accepted);
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_IO_URING_BACKEND
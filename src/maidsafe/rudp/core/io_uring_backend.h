@@ -0,0 +1,198 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_IO_URING_BACKEND_H_
+#define MAIDSAFE_RUDP_CORE_IO_URING_BACKEND_H_
+
+#if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#  endif
+#endif
+
+// The multishot recvmsg and provided buffer ring interfaces first appeared in the Linux 6.0
+// headers.  Built against older headers, IoUringBackend is left out and MultiplexerBackend::Create
+// returns an AsioBackend in its place.
+#ifdef IORING_RECV_MULTISHOT
+#  define MAIDSAFE_RUDP_IO_URING_BACKEND
+#endif
+
+#ifdef MAIDSAFE_RUDP_IO_URING_BACKEND
+
+#include <sys/socket.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/udp.hpp"
+#include "boost/asio/posix/stream_descriptor.hpp"
+
+#include "maidsafe/rudp/core/asio_backend.h"
+#include "maidsafe/rudp/core/multiplexer_backend.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
+
+struct io_uring_buf_ring;
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A multiplexer backend which transfers datagrams using io_uring (Linux 6.0 or later).
+//
+// Datagrams are received by a single multishot recvmsg request, which the kernel keeps armed and
+// which takes a buffer for each datagram from a ring of buffers provided to it, so receiving costs
+// no system call per datagram.  The kernel signals completions through an eventfd which asio waits
+// on.  As with a receive batch, a buffer still referenced by a packet once its datagram has been
+// dispatched is replaced from a pool before being provided to the kernel again.  Receive offload
+// isn't used.  If the receive can't be armed, receiving falls back to an AsioBackend on the same
+// socket for as long as the backend stays open.
+//
+// Each batch of sends is submitted as a chain of linked sendmsg requests with a single system call,
+// which also waits for the chain to complete so the batch may be reused as soon as Send returns.
+// Linking stops the chain at the first failure, so a partial send behaves as it does with sendmmsg.
+// Zero-copy and single datagrams are sent directly on the socket, since there's nothing to batch.
+class IoUringBackend : public MultiplexerBackend {
+ public:
+  explicit IoUringBackend(boost::asio::ip::udp::socket& socket);
+  virtual ~IoUringBackend();
+
+  virtual bool Open();
+  virtual bool IsOpen() const { return socket_.is_open(); }
+  virtual boost::asio::ip::udp::endpoint LocalEndpoint(boost::system::error_code& ec) const {
+    return socket_.local_endpoint(ec);
+  }
+  virtual void Close();
+  virtual void AsyncWait(WaitHandler handler);
+  virtual void Receive(const ReceiveHandler& handler, boost::system::error_code& ec);
+  virtual void SendTo(const std::vector<boost::asio::mutable_buffer>& buffers,
+                      const boost::asio::ip::udp::endpoint& endpoint,
+                      boost::system::error_code& ec);
+  virtual size_t Send(TransmitBatch& batch, size_t& segment_limit, ZeroCopyTracker* zero_copy,
+                      boost::system::error_code& ec);
+
+ private:
+  // Disallow copying and assignment.
+  IoUringBackend(const IoUringBackend&);
+  IoUringBackend& operator=(const IoUringBackend&);
+
+  // A submission and completion queue pair shared with the kernel.
+  class Ring {
+   public:
+    Ring();
+    ~Ring() { Destroy(); }
+
+    // Create the ring with room for entries submissions and, if non-zero, completion_entries
+    // completions.  Returns false if io_uring is unavailable.
+    bool Create(unsigned entries, unsigned completion_entries);
+    void Destroy();
+    int Descriptor() const { return descriptor_; }
+
+    // Returns a cleared submission queue entry, or null if the queue is full.
+    io_uring_sqe* NextSubmission();
+
+    // Submit the queued entries and wait until at least wait_count completions are available (it
+    // may return sooner if interrupted).  Returns 0, or a negated errno value on failure.
+    int Enter(unsigned wait_count);
+
+    // The oldest completion not yet consumed, or null if there is none.
+    io_uring_cqe* PeekCompletion();
+    void ConsumeCompletion();
+
+   private:
+    Ring(const Ring&);
+    Ring& operator=(const Ring&);
+
+    int descriptor_;
+    void* rings_;
+    size_t rings_size_;
+    io_uring_sqe* submissions_;
+    size_t submissions_size_;
+    unsigned *submission_head_, *submission_tail_, submission_mask_, submission_entries_;
+    unsigned *completion_head_, *completion_tail_, completion_mask_;
+    io_uring_cqe* completions_;
+    unsigned local_tail_;
+  };
+
+  // A datagram reaped from the receive ring, held while it is dispatched.
+  struct Received {
+    Received() : buffer_id(0), buffer(), data(), sender_endpoint() {}
+    uint16_t buffer_id;
+    SharedBufferPtr buffer;
+    boost::asio::const_buffer data;
+    boost::asio::ip::udp::endpoint sender_endpoint;
+  };
+
+  // Tear down whatever Open set up.  Requires mutex_ to be locked.
+  void Release();
+  // Submit the multishot receive, falling back to receive_fallback_ if it can't be.  Requires
+  // mutex_ to be locked.
+  void ArmReceive();
+  // Move the completed receives to received_, noting whether the multishot receive has ended.
+  // Requires mutex_ to be locked.
+  void ReapReceives();
+  // Queue buffer_id's buffer to be provided to the kernel again, replacing it from the pool if a
+  // packet still refers to it.  Requires mutex_ to be locked.
+  void ProvideBuffer(uint16_t buffer_id);
+  // Make the queued buffers visible to the kernel.  Requires mutex_ to be locked.
+  void PublishBuffers();
+  // Submit count messages to the send ring, as a TransmitBatch::MessageSender.
+  int SubmitSends(mmsghdr* messages, unsigned int count, int flags);
+
+  boost::asio::ip::udp::socket& socket_;
+  boost::asio::io_service& io_service_;
+
+  // Guards the receive side, which Close may tear down while a dispatch is in progress.
+  std::mutex mutex_;
+  bool open_, receiving_;
+  Ring receive_ring_;
+  // The template for the multishot receive's messages, which only sets the sender address's size.
+  msghdr receive_header_;
+  io_uring_buf_ring* buffer_ring_;
+  size_t buffer_ring_size_;
+  uint16_t buffer_ring_tail_;
+  std::shared_ptr<SharedBufferPool> receive_buffer_pool_;
+  // The buffer currently provided to the kernel under each buffer id.
+  std::vector<SharedBufferPtr> buffers_;
+  std::vector<Received> received_;
+  // Signalled by the kernel on each completion, and the count read from it by AsyncWait.
+  boost::asio::posix::stream_descriptor event_descriptor_;
+  uint64_t event_count_;
+  // Receives in place of the ring once arming it has failed, so that waits don't complete straight
+  // away forever.  Only replaced by Open, since Receive uses it without the lock.
+  std::unique_ptr<AsioBackend> receive_fallback_;
+
+  // Guards the send ring, which must only have a single submitter.
+  std::mutex send_mutex_;
+  Ring send_ring_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_IO_URING_BACKEND
+
+#endif  // MAIDSAFE_RUDP_CORE_IO_URING_BACKEND_H_
@@ -20,16 +20,20 @@
 
 #include "maidsafe/rudp/core/multiplexer.h"
 
-#ifdef MAIDSAFE_WIN32
-#  define WIN32_LEAN_AND_MEAN 1
-#  include <windows.h>
-#else
-#  include <sys/mman.h>
-#  ifndef MAP_ANONYMOUS
-#    define MAP_ANONYMOUS MAP_ANON
+#ifdef __linux__
+#  include <linux/filter.h>
+#  include <sys/socket.h>
+#  ifndef SO_REUSEPORT
+#    define SO_REUSEPORT 15
+#  endif
+#  ifndef SO_ATTACH_REUSEPORT_CBPF
+#    define SO_ATTACH_REUSEPORT_CBPF 51
 #  endif
 #endif
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <thread>
 
 #include "maidsafe/rudp/managed_connections.h"
 #include "maidsafe/rudp/packets/packet.h"
@@ -46,72 +50,37 @@ namespace detail {
 
 Multiplexer::Multiplexer(boost::asio::io_service& asio_service)
     : socket_(asio_service),
-      sender_endpoint_(),
+      backend_(MultiplexerBackend::Create(Parameters::multiplexer_backend, socket_)),
+      accepting_sends_(false),
+      sends_in_progress_(0),
+      segment_limit_(0),
+      zero_copy_(),
       dispatcher_(),
       external_endpoint_(),
       best_guess_external_endpoint_(),
-      mutex_() {
-        bool bad = false;
-        for (auto &i : receive_buffers_) {
-          i = allocate_dma_buffer_(Parameters::max_size);
-          if (!(i))
-            bad = true;
-        }
-        for (auto &i : send_buffers_) {
-          i = allocate_dma_buffer_(Parameters::max_size);
-          if (!(i))
-            bad = true;
-        }
-        if (bad) {
-          for (auto &i : receive_buffers_)
-            if (i)
-              deallocate_dma_buffer_(i, Parameters::max_size);
-          for (auto &i : send_buffers_)
-            if (i)
-              deallocate_dma_buffer_(i, Parameters::max_size);
-          throw std::bad_alloc();
-        }
-        receive_buffer_ = receive_buffers_.begin();
-        send_buffer_ = send_buffers_.begin();
-      }
-
-Multiplexer::~Multiplexer() {
-  for (auto &i : receive_buffers_)
-    if (i)
-      deallocate_dma_buffer_(i, Parameters::max_size);
-  for (auto &i : send_buffers_)
-    if (i)
-      deallocate_dma_buffer_(i, Parameters::max_size);
-}
+      mutex_() {}
 
-#ifdef MAIDSAFE_WIN32
-unsigned char *Multiplexer::allocate_dma_buffer_(size_t len) {
-  void *ret = VirtualAlloc(nullptr, len, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
-  return reinterpret_cast<unsigned char *>(ret);
-}
-void Multiplexer::deallocate_dma_buffer_(unsigned char *buf, size_t /*len*/) {
-  VirtualFree(buf, 0, MEM_RELEASE);
-}
-#else
-unsigned char *Multiplexer::allocate_dma_buffer_(size_t len) {
-  void *ret = mmap(nullptr, len, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_SHARED,
-                   -1, 0);
-  return reinterpret_cast<unsigned char *>(ret);
-}
-void Multiplexer::deallocate_dma_buffer_(unsigned char *buf, size_t len) {
-  munmap(buf, len);
-}
-#endif
+Multiplexer::~Multiplexer() {}
 
 ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint) {
   std::lock_guard<std::mutex> lock(mutex_);
-  if (socket_.is_open()) {
+  if (backend_->IsOpen()) {
     LOG(kWarning) << "Multiplexer already open.";
     return kAlreadyStarted;
   }
 
   assert(!endpoint.address().is_unspecified());
 
+  if (!backend_->UsesSocket()) {
+    ReturnCode result(backend_->Bind(endpoint));
+    if (result != kSuccess) {
+      LOG(kError) << "Multiplexer backend failed to bind " << endpoint;
+      return result;
+    }
+    accepting_sends_ = true;
+    return kSuccess;
+  }
+
   bs::error_code ec;
   socket_.open(endpoint.protocol(), ec);
 
@@ -130,45 +99,176 @@ ReturnCode Multiplexer::Open(const ip::udp::endpoint& endpoint) {
     return kSetOptionFailure;
   }
 
-  if (endpoint.port() == 0U) {
+#ifdef __linux__
+  if (ShardCount() > 1) {
+    int enable = 1;
+    if (::setsockopt(socket_.native_handle(), SOL_SOCKET, SO_REUSEPORT, &enable,
+                     sizeof(enable)) != 0) {
+      LOG(kError) << "Multiplexer failed to enable port sharing while attempting on " << endpoint;
+      return kSetOptionFailure;
+    }
+  }
+#endif
+
+  segment_limit_ = Parameters::udp_segmentation_offload &&
+                   TransmitBatch::SegmentationSupported(socket_) ? Parameters::kUDPPayload : 0;
+
+  // Zero-copy sends are only made from transmit batches.
+  if (Parameters::zero_copy_send && Parameters::transmit_batch_size > 1) {
+    std::lock_guard<std::mutex> zero_copy_lock(zero_copy_.mutex());
+    if (!zero_copy_.Enable(socket_))
+      LOG(kInfo) << "Zero-copy sends unsupported on " << endpoint;
+  }
+
+  // A shared port must not be the well-known resilience port, or unrelated transports would join.
+  bool bound(false);
+  if (endpoint.port() == 0U && ShardCount() == 1U) {
     // Try to bind to Resilience port first. If this fails, just fall back to port 0 (i.e. any port)
     socket_.bind(ip::udp::endpoint(endpoint.address(), ManagedConnections::kResiliencePort()), ec);
-    if (!ec)
-      return kSuccess;
+    bound = !ec;
   }
 
-  socket_.bind(endpoint, ec);
-  if (ec) {
-    LOG(kError) << "Multiplexer socket binding error while attempting on " << endpoint
-                << "  Error: " << ec.value();
-    return kBindError;
+  if (!bound) {
+    socket_.bind(endpoint, ec);
+    if (ec) {
+      LOG(kError) << "Multiplexer socket binding error while attempting on " << endpoint
+                  << "  Error: " << ec.value();
+      return kBindError;
+    }
   }
 
+  if (!backend_->Open()) {
+    LOG(kInfo) << "Multiplexer backend unsupported on " << endpoint << ", falling back to asio";
+    backend_ = MultiplexerBackend::Create(Parameters::kAsioBackend, socket_);
+    backend_->Open();
+  }
+
+  accepting_sends_ = true;
   return kSuccess;
 }
 
 bool Multiplexer::IsOpen() const {
   std::lock_guard<std::mutex> lock(mutex_);
-  return socket_.is_open();
+  return backend_->IsOpen();
 }
 
 void Multiplexer::Close() {
+  // Refuse further sends and wait for those in progress to finish before closing the socket.
+  accepting_sends_ = false;
+  while (sends_in_progress_ != 0)
+    std::this_thread::yield();
+
   bs::error_code ec;
   std::lock_guard<std::mutex> lock(mutex_);
+  backend_->Close();
   socket_.close(ec);
   if (ec)
     LOG(kWarning) << "Multiplexer closing error: " << ec.message();
-  assert(!socket_.is_open());
+  assert(!backend_->IsOpen());
   external_endpoint_ = ip::udp::endpoint();
   best_guess_external_endpoint_ = ip::udp::endpoint();
+  std::lock_guard<std::mutex> zero_copy_lock(zero_copy_.mutex());
+  zero_copy_.Reset();
+}
+
+size_t Multiplexer::ShardCount() {
+#ifdef __linux__
+  // Shards share a port using SO_REUSEPORT, so must use real sockets.
+  if (Parameters::multiplexer_backend == Parameters::kFabricBackend)
+    return 1;
+  return std::max(Parameters::multiplexer_shards, 1U);
+#else
+  return 1;
+#endif
+}
+
+ReturnCode Multiplexer::SteerToShards(size_t shard_count) {
+#ifdef __linux__
+  // The program sees the UDP payload, in which the destination socket id is the big-endian
+  // 32-bit word at offset 12 (see Packet::DecodeDestinationSocketId).
+  const uint32_t modulus(static_cast<uint32_t>(shard_count));
+  sock_filter code[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 12),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 2, 0),
+    BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, modulus),
+    BPF_STMT(BPF_RET | BPF_A, 0),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_RXHASH)),
+    BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, modulus),
+    BPF_STMT(BPF_RET | BPF_A, 0)
+  };
+  sock_fprog program = { static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code };
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (::setsockopt(socket_.native_handle(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                   sizeof(program)) != 0) {
+    LOG(kWarning) << "Failed to attach shard steering program - errno " << errno;
+    return kSetOptionFailure;
+  }
+  return kSuccess;
+#else
+  static_cast<void>(shard_count);
+  return kSetOptionFailure;
+#endif
+}
+
+ReturnCode Multiplexer::Flush(TransmitBatch& batch) {
+  // Flushes follow the processing of each received packet, so this is a timely point to release
+  // payloads which the kernel has finished sending.
+  if (zero_copy_.IsEnabled())
+    ReapZeroCopySends();
+  if (batch.IsEmpty())
+    return kSuccess;
+  size_t queued = batch.Size();
+  size_t sent = 0;
+  bs::error_code ec;
+  {
+    ScopedSend send(*this);
+    if (send.IsOpen()) {
+      // Lowered by Send if the kernel rejects segmentation at some size.  Concurrent updates
+      // from other sockets' flushes may be lost, which only costs another rejected attempt.
+      size_t segment_limit(segment_limit_);
+      sent = backend_->Send(batch, segment_limit, &zero_copy_, ec);
+      if (segment_limit != segment_limit_)
+        segment_limit_ = segment_limit;
+    } else {
+      batch.Clear();
+      ec = boost::asio::error::bad_descriptor;
+    }
+  }
+  if (sent != queued) {
+#ifndef NDEBUG
+    if (!local_endpoint().address().is_unspecified()) {
+      LOG(kWarning) << "Error sending batch from " << local_endpoint() << " - only " << sent
+                    << " of " << queued << " packets sent - " << ec.message();
+    }
+#endif
+    return kSendFailure;
+  }
+  return kSuccess;
+}
+
+void Multiplexer::ReapZeroCopySends() {
+  ScopedSend send(*this);
+  if (!send.IsOpen())
+    return;
+  std::lock_guard<std::mutex> lock(zero_copy_.mutex());
+  if (zero_copy_.HasPinned())
+    zero_copy_.Reap(socket_);
+}
+
+SharedBufferPtr Multiplexer::ZeroCopyBuffer(const DataPacket& packet) const {
+  if (!zero_copy_.IsEnabled() ||
+      boost::asio::buffer_size(packet.Payload()) < Parameters::zero_copy_threshold) {
+    return SharedBufferPtr();
+  }
+  return packet.Buffer();
 }
 
 ip::udp::endpoint Multiplexer::local_endpoint() const {
   boost::system::error_code ec;
   std::lock_guard<std::mutex> lock(mutex_);
-  ip::udp::endpoint local_endpoint(socket_.local_endpoint(ec));
+  ip::udp::endpoint local_endpoint(backend_->LocalEndpoint(ec));
   if (ec) {
-    if (socket_.is_open())
+    if (backend_->IsOpen())
       LOG(kError) << ec.message();
     return ip::udp::endpoint();
   }
@@ -21,8 +21,9 @@
 #ifndef MAIDSAFE_RUDP_CORE_MULTIPLEXER_H_
 #define MAIDSAFE_RUDP_CORE_MULTIPLEXER_H_
 
-#include <array>
+#include <atomic>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -34,6 +35,11 @@
 
 #include "maidsafe/rudp/operations/dispatch_op.h"
 #include "maidsafe/rudp/core/dispatcher.h"
+#include "maidsafe/rudp/core/multiplexer_backend.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
+#include "maidsafe/rudp/core/transmit_batch.h"
+#include "maidsafe/rudp/core/zero_copy_tracker.h"
+#include "maidsafe/rudp/packets/data_packet.h"
 #include "maidsafe/rudp/packets/packet.h"
 #include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/return_codes.h"
@@ -61,17 +67,23 @@ class Multiplexer {
   // Close the multiplexer.
   void Close();
 
-  // Asynchronously receive a single packet and dispatch it.
+  // The number of multiplexers to open per transport, all sharing a single port.  If greater than
+  // 1, Open enables port sharing on the socket.
+  static size_t ShardCount();
+
+  // Have the kernel deliver each packet arriving at this multiplexer's port to the shard_count
+  // multiplexers sharing it (in the order they were opened) according to the packet's destination
+  // socket id modulo shard_count.  Packets with no destination socket id are spread by flow hash,
+  // so a handshake for a new socket may still arrive at a shard other than the one which will own
+  // the connection, and need handing over.
+  ReturnCode SteerToShards(size_t shard_count);
+
+  // Asynchronously wait for packets to arrive and dispatch them.  All packets which are already
+  // queued are drained (in batches if enabled) and dispatched.
   template <typename DispatchHandler>
   void AsyncDispatch(DispatchHandler handler) {
     std::lock_guard<std::mutex> lock(mutex_);
-    unsigned char *data = *receive_buffer_++;
-    if (receive_buffer_ == receive_buffers_.end())
-      receive_buffer_ = receive_buffers_.begin();
-    auto buffer = boost::asio::buffer(data, Parameters::max_size);
-    DispatchOp<DispatchHandler> op(handler, socket_, buffer,
-                                   sender_endpoint_, dispatcher_);
-    socket_.async_receive_from(buffer, sender_endpoint_, 0, op);
+    backend_->AsyncWait(DispatchOp<DispatchHandler>(handler, *backend_, dispatcher_));
   }
 
  private:
@@ -149,33 +161,25 @@ class Multiplexer {
     }
   }
 
-  // Called by the socket objects to send a packet. Returns kSuccess if the data was sent
-  // successfully, kSendFailure otherwise.
+  // Called by the socket objects to send a packet, encoding it into buffer, which must be at least
+  // Parameters::max_size bytes and must not be in use by any other thread.  Returns kSuccess if the
+  // data was sent successfully, kSendFailure otherwise.
   template <typename Packet>
-  ReturnCode SendTo(const Packet& packet, const boost::asio::ip::udp::endpoint& endpoint) {
-    unsigned char *data = *send_buffer_++;
-    if (send_buffer_ == send_buffers_.end())
-      send_buffer_ = send_buffers_.begin();
+  ReturnCode SendTo(const Packet& packet, const boost::asio::ip::udp::endpoint& endpoint,
+                    const boost::asio::mutable_buffer& buffer) {
     std::vector<boost::asio::mutable_buffer> buffers;
     buffers.reserve(2);  // in case Encode expands for a gather send
-    buffers.push_back(boost::asio::mutable_buffer(data, Parameters::max_size));
-    if (size_t length = packet.Encode(buffers)) {
+    buffers.push_back(buffer);
+    if (size_t length = Encode(packet, buffers)) {
       boost::system::error_code ec;
-      if (length < boost::asio::buffer_size(buffers)) {
-        assert(buffers.size() == 1);
-        if (buffers.size() != 1)
-          abort();  // Someone messed up a gather send calculation
-        // Trim the single buffer to the output length
-        buffers[0]=boost::asio::mutable_buffer(
-          boost::asio::buffer_cast<unsigned char*>(buffers[0]),
-          length);
-      }
       auto &state = getPacketLossState();
       if (state.enabled && state.should_drop_this_packet(length))
         return kSuccess;
       {
-        std::lock_guard<std::mutex> lock(mutex_);
-        socket_.send_to(buffers, endpoint, 0, ec);
+        ScopedSend send(*this);
+        if (!send.IsOpen())
+          return kSendFailure;
+        backend_->SendTo(buffers, endpoint, ec);
       }
       if (ec) {
 #ifndef NDEBUG
@@ -192,6 +196,31 @@ class Multiplexer {
     return kSendFailure;
   }
 
+  // Called by the socket objects to queue a packet in batch, to be transmitted by a later call to
+  // Flush.  If the batch is already full it is flushed first.  Returns kSuccess if the packet was
+  // queued, kSendFailure if it couldn't be encoded.  Any gather buffer used by the packet's
+  // encoding must remain valid until the batch is flushed.
+  template <typename Packet>
+  ReturnCode QueueTo(const Packet& packet, const boost::asio::ip::udp::endpoint& endpoint,
+                     TransmitBatch& batch) {
+    if (batch.IsFull())
+      Flush(batch);
+    std::vector<boost::asio::mutable_buffer> buffers;
+    buffers.reserve(2);  // in case Encode expands for a gather send
+    buffers.push_back(batch.NextBuffer());
+    if (size_t length = Encode(packet, buffers)) {
+      auto &state = getPacketLossState();
+      if (!state.enabled || !state.should_drop_this_packet(length))
+        batch.Push(buffers, endpoint, ZeroCopyBuffer(packet));
+      return kSuccess;
+    }
+    return kSendFailure;
+  }
+
+  // Transmit all packets queued in batch.  Returns kSuccess if they were all sent successfully,
+  // kSendFailure otherwise.
+  ReturnCode Flush(TransmitBatch& batch);
+
   boost::asio::ip::udp::endpoint local_endpoint() const;
 
   // Returns external_endpoint_ if valid, else best_guess_external_endpoint_.
@@ -205,23 +234,69 @@ class Multiplexer {
   Multiplexer(const Multiplexer&);
   Multiplexer& operator=(const Multiplexer&);
 
-  static unsigned char *allocate_dma_buffer_(size_t len);
-  static void deallocate_dma_buffer_(unsigned char *buf, size_t len);
+  // Registers a send in progress on socket_ for its lifetime.  Close waits for all sends in
+  // progress to finish before closing the socket, so sending needs no lock and concurrent sends
+  // from different sockets proceed in parallel.  Nothing may be sent unless IsOpen() is true.
+  class ScopedSend {
+   public:
+    explicit ScopedSend(Multiplexer& multiplexer) : multiplexer_(multiplexer), is_open_(false) {
+      ++multiplexer_.sends_in_progress_;
+      is_open_ = multiplexer_.accepting_sends_;
+    }
+    ~ScopedSend() { --multiplexer_.sends_in_progress_; }
+    bool IsOpen() const { return is_open_; }
+
+   private:
+    ScopedSend(const ScopedSend&);
+    ScopedSend& operator=(const ScopedSend&);
+
+    Multiplexer& multiplexer_;
+    bool is_open_;
+  };
+
+  // Release the payloads of zero-copy sends which the kernel has finished with.
+  void ReapZeroCopySends();
+
+  // The buffer holding packet's payload if the packet should be sent without copying it, else null.
+  template <typename Packet>
+  SharedBufferPtr ZeroCopyBuffer(const Packet& /*packet*/) const {
+    return SharedBufferPtr();
+  }
+  SharedBufferPtr ZeroCopyBuffer(const DataPacket& packet) const;
+
+  // Encode packet into buffers, trimming the first buffer to the encoded length if the packet
+  // didn't expand it into a gather send.  Returns the encoded length, or 0 on failure.
+  template <typename Packet>
+  static size_t Encode(const Packet& packet, std::vector<boost::asio::mutable_buffer>& buffers) {
+    size_t length = packet.Encode(buffers);
+    if (length && length < boost::asio::buffer_size(buffers)) {
+      assert(buffers.size() == 1);
+      if (buffers.size() != 1)
+        abort();  // Someone messed up a gather send calculation
+      // Trim the single buffer to the output length
+      buffers[0] = boost::asio::mutable_buffer(
+        boost::asio::buffer_cast<unsigned char*>(buffers[0]),
+        length);
+    }
+    return length;
+  }
 
   // The UDP socket used for all RUDP protocol communication.
   boost::asio::ip::udp::socket socket_;
 
-  // 2014-8-26 ned:
-  // BSD and Windows can DMA UDP packets straight to/from
-  // userspace, but only iff we alternate the buffers handed off
-  // to the network stack. Read more about it at
-  // http://www.freebsd.org/cgi/man.cgi?query=zero_copy.
-  typedef std::array<unsigned char *, 2> dma_buffers_type_;
-  dma_buffers_type_ receive_buffers_, send_buffers_;
-  dma_buffers_type_::iterator receive_buffer_, send_buffer_;
-
-  // The remote UDP endpoint we are sending to.
-  boost::asio::ip::udp::endpoint sender_endpoint_;
+  // Transfers datagrams, usually over socket_.  Only replaced by Open, while no sends are
+  // permitted.
+  std::unique_ptr<MultiplexerBackend> backend_;
+
+  // Whether sends are currently permitted, and the number in progress.  See ScopedSend.
+  std::atomic<bool> accepting_sends_;
+  std::atomic<int> sends_in_progress_;
+
+  // The largest datagram which may be sent using segmentation offload, or 0 if it's unavailable.
+  std::atomic<size_t> segment_limit_;
+
+  // Payloads of datagrams sent using MSG_ZEROCOPY, which the kernel may still be reading.
+  ZeroCopyTracker zero_copy_;
 
   // Dispatcher keeps track of the active sockets.
   Dispatcher dispatcher_;
@@ -0,0 +1,48 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/multiplexer_backend.h"
+
+#include "maidsafe/rudp/core/asio_backend.h"
+#include "maidsafe/rudp/core/fabric_backend.h"
+#include "maidsafe/rudp/core/io_uring_backend.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+std::unique_ptr<MultiplexerBackend> MultiplexerBackend::Create(
+    Parameters::MultiplexerBackendType type, boost::asio::ip::udp::socket& socket) {
+  if (type == Parameters::kFabricBackend)
+    return std::unique_ptr<MultiplexerBackend>(new FabricBackend(socket));
+#ifdef MAIDSAFE_RUDP_IO_URING_BACKEND
+  if (type == Parameters::kIoUringBackend)
+    return std::unique_ptr<MultiplexerBackend>(new IoUringBackend(socket));
+#else
+  static_cast<void>(type);
+#endif
+  return std::unique_ptr<MultiplexerBackend>(new AsioBackend(socket));
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
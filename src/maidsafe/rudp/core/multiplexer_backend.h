@@ -0,0 +1,106 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_MULTIPLEXER_BACKEND_H_
+#define MAIDSAFE_RUDP_CORE_MULTIPLEXER_BACKEND_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/ip/udp.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "maidsafe/rudp/core/shared_buffer.h"
+#include "maidsafe/rudp/core/transmit_batch.h"
+#include "maidsafe/rudp/core/zero_copy_tracker.h"
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/return_codes.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// The mechanism a multiplexer uses to transfer datagrams.  Most backends use the multiplexer's UDP
+// socket, which the multiplexer owns, configures and binds; the backend only receives and sends on
+// it.  Others (e.g. the in-process fabric) leave the socket closed and bind endpoints themselves.
+//
+// Receiving is split into waiting and draining, so that the multiplexer's dispatch operation can
+// run in its handler's context (e.g. a strand) whichever thread the backend completes the wait on.
+class MultiplexerBackend {
+ public:
+  typedef std::function<void(const boost::system::error_code&)> WaitHandler;
+  // Called for each datagram received, with the buffer holding it.
+  typedef std::function<void(const boost::asio::const_buffer&,
+                             const boost::asio::ip::udp::endpoint&,
+                             const SharedBufferPtr&)> ReceiveHandler;
+
+  // Create a backend of the given type for socket.
+  static std::unique_ptr<MultiplexerBackend> Create(Parameters::MultiplexerBackendType type,
+                                                    boost::asio::ip::udp::socket& socket);
+
+  virtual ~MultiplexerBackend() {}
+
+  // Whether datagrams are transferred over the multiplexer's socket.  If not, the multiplexer calls
+  // Bind rather than opening and binding the socket, and Open is never called.
+  virtual bool UsesSocket() const { return true; }
+
+  // Claim endpoint, or any free port on its address if its port is 0.  Only called if the backend
+  // doesn't use the socket.
+  virtual ReturnCode Bind(const boost::asio::ip::udp::endpoint& /*endpoint*/) { return kBindError; }
+
+  // Start transferring datagrams, once the socket has been opened and bound.  Returns false if the
+  // backend can't be used on this system, in which case the multiplexer falls back to another.
+  virtual bool Open() = 0;
+
+  // Whether the socket (or the backend's own endpoint) is open, and the endpoint it is bound to.
+  virtual bool IsOpen() const = 0;
+  virtual boost::asio::ip::udp::endpoint LocalEndpoint(boost::system::error_code& ec) const = 0;
+
+  // Stop transferring datagrams.  Called once no sends are in progress, before the socket is
+  // closed.  Any wait in progress completes with an error.
+  virtual void Close() = 0;
+
+  // Call handler once datagrams may be available to Receive, or with an error if the backend has
+  // been closed.  Only one wait may be in progress at a time.
+  virtual void AsyncWait(WaitHandler handler) = 0;
+
+  // Pass each datagram which has already arrived to handler, without blocking.  If there were
+  // none, ec is set (typically to would_block).  Must not be called concurrently with itself.
+  virtual void Receive(const ReceiveHandler& handler, boost::system::error_code& ec) = 0;
+
+  // Send a single datagram gathered from buffers.
+  virtual void SendTo(const std::vector<boost::asio::mutable_buffer>& buffers,
+                      const boost::asio::ip::udp::endpoint& endpoint,
+                      boost::system::error_code& ec) = 0;
+
+  // Send all datagrams queued in batch and empty it, as TransmitBatch::Send.
+  virtual size_t Send(TransmitBatch& batch, size_t& segment_limit, ZeroCopyTracker* zero_copy,
+                      boost::system::error_code& ec) = 0;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_MULTIPLEXER_BACKEND_H_
@@ -22,6 +22,8 @@
 #define MAIDSAFE_RUDP_CORE_PEER_H_
 
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 #include "boost/asio/ip/udp.hpp"
 #include "maidsafe/common/log.h"
@@ -44,7 +46,11 @@ class Peer {
         socket_id_(0),
         node_id_(),
         public_key_(),
-        peer_guessed_port_(0) {}
+        peer_guessed_port_(0),
+        send_buffer_(Parameters::max_size),
+        transmit_batch_(Parameters::transmit_batch_size > 1
+                            ? new TransmitBatch(Parameters::transmit_batch_size) : nullptr),
+        transmit_batch_depth_(0) {}
 
   // Endpoint of peer
   const boost::asio::ip::udp::endpoint& PeerEndpoint() const { return peer_endpoint_; }
@@ -69,9 +75,21 @@ class Peer {
   uint16_t PeerGuessedPort() const { return peer_guessed_port_; }
   void SetPeerGuessedPort() { peer_guessed_port_ = peer_endpoint_.port(); }
 
+  // Sends the packet immediately, or queues it if a transmit batch is currently open.
   template <typename Packet>
   ReturnCode Send(const Packet& packet) {
-    return multiplexer_.SendTo(packet, peer_endpoint_);
+    if (transmit_batch_depth_ != 0 && transmit_batch_)
+      return multiplexer_.QueueTo(packet, peer_endpoint_, *transmit_batch_);
+    return multiplexer_.SendTo(packet, peer_endpoint_, boost::asio::buffer(send_buffer_));
+  }
+
+  // Packets sent between these calls are queued and transmitted together when the outermost batch
+  // is closed.  Calls may be nested.
+  void OpenTransmitBatch() { ++transmit_batch_depth_; }
+  void CloseTransmitBatch() {
+    assert(transmit_batch_depth_ != 0);
+    if (--transmit_batch_depth_ == 0 && transmit_batch_)
+      multiplexer_.Flush(*transmit_batch_);
   }
 
  private:
@@ -95,6 +113,26 @@ class Peer {
   // set by the ConnectionManager if it detects that the peer's actual external port is different to
   // the one provided by the peer as its best guess.
   uint16_t peer_guessed_port_;
+  // Buffer into which packets sent immediately are encoded.  Each socket has its own, so that
+  // sockets on different threads can send at once.
+  std::vector<unsigned char> send_buffer_;
+  // Packets queued during the current send pass.  Null if batching is disabled.
+  std::unique_ptr<TransmitBatch> transmit_batch_;
+  unsigned transmit_batch_depth_;
+};
+
+// Opens a transmit batch on the peer for the lifetime of this object.
+class ScopedTransmitBatch {
+ public:
+  explicit ScopedTransmitBatch(Peer& peer) : peer_(peer) { peer_.OpenTransmitBatch(); }
+  ~ScopedTransmitBatch() { peer_.CloseTransmitBatch(); }
+
+ private:
+  // Disallow copying and assignment.
+  ScopedTransmitBatch(const ScopedTransmitBatch&);
+  ScopedTransmitBatch& operator=(const ScopedTransmitBatch&);
+
+  Peer& peer_;
 };
 
 }  // namespace detail
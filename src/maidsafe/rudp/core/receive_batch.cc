@@ -0,0 +1,211 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/receive_batch.h"
+
+#ifdef __linux__
+#  include <netinet/in.h>
+#  include <netinet/udp.h>
+#endif
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace asio = boost::asio;
+namespace ip = boost::asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+#ifdef __linux__
+#  ifndef SOL_UDP
+#    define SOL_UDP 17
+#  endif
+#  ifndef UDP_GRO
+#    define UDP_GRO 104
+#  endif
+
+const size_t kMaxCoalescedSize = 65535;
+const size_t kControlSpace = CMSG_SPACE(sizeof(int));
+
+// Extract the segment size reported by the kernel for a coalesced receive, or 0 if none.
+size_t CoalescedSegmentSize(msghdr& header) {
+  for (cmsghdr* control_message = CMSG_FIRSTHDR(&header); control_message;
+       control_message = CMSG_NXTHDR(&header, control_message)) {
+    if (control_message->cmsg_level == SOL_UDP && control_message->cmsg_type == UDP_GRO) {
+      int segment_size = 0;
+      std::memcpy(&segment_size, CMSG_DATA(control_message), sizeof(segment_size));
+      return static_cast<size_t>(segment_size);
+    }
+  }
+  return 0;
+}
+#endif
+
+}  // unnamed namespace
+
+ReceiveBatch::ReceiveBatch(size_t capacity)
+    : capacity_(capacity),
+      pool_(),
+      buffers_(capacity),
+      lengths_(capacity, 0),
+      segment_sizes_(capacity, 0),
+      sender_endpoints_(capacity),
+#ifdef __linux__
+      iovecs_(capacity),
+      headers_(capacity),
+      control_(),
+      coalescing_(false),
+      use_fallback_(false) {
+#else
+      coalescing_(false),
+      use_fallback_(true) {
+#endif
+  AllocateBuffers(Parameters::max_size);
+}
+
+void ReceiveBatch::AllocateBuffers(size_t buffer_size) {
+  // Enough free buffers are kept to refill the whole batch without allocating.
+  pool_ = SharedBufferPool::Create(buffer_size, capacity_);
+  for (size_t i = 0; i < capacity_; ++i) {
+    buffers_[i] = pool_->Acquire();
+#ifdef __linux__
+    iovecs_[i].iov_base = buffers_[i]->Data();
+    iovecs_[i].iov_len = buffers_[i]->Capacity();
+    headers_[i] = mmsghdr();
+    headers_[i].msg_hdr.msg_iov = &iovecs_[i];
+    headers_[i].msg_hdr.msg_iovlen = 1;
+#endif
+  }
+}
+
+void ReceiveBatch::ReplenishBuffer(size_t i) {
+  if (buffers_[i]->IsUnique())
+    return;
+  buffers_[i] = pool_->Acquire();
+#ifdef __linux__
+  iovecs_[i].iov_base = buffers_[i]->Data();
+#endif
+}
+
+#ifdef __linux__
+bool ReceiveBatch::EnableCoalescing(ip::udp::socket& socket) {
+  if (use_fallback_)
+    return false;
+  int enable = 1;
+  if (::setsockopt(socket.native_handle(), SOL_UDP, UDP_GRO, &enable, sizeof(enable)) != 0)
+    return false;
+  if (!coalescing_) {
+    // A coalesced receive can hold up to a full UDP payload's worth of datagrams.  Callers should
+    // copy the datagrams out rather than let packets keep such a large buffer alive.
+    AllocateBuffers(kMaxCoalescedSize);
+    control_.assign(capacity_ * kControlSpace, 0);
+    coalescing_ = true;
+  }
+  return true;
+}
+#else
+bool ReceiveBatch::EnableCoalescing(ip::udp::socket& /*socket*/) { return false; }
+#endif
+
+asio::const_buffer ReceiveBatch::Data(size_t i) const {
+  assert(i < capacity_);
+  return asio::buffer(buffers_[i]->Data(), lengths_[i]);
+}
+
+const SharedBufferPtr& ReceiveBatch::Buffer(size_t i) const {
+  assert(i < capacity_);
+  return buffers_[i];
+}
+
+const ip::udp::endpoint& ReceiveBatch::SenderEndpoint(size_t i) const {
+  assert(i < capacity_);
+  return sender_endpoints_[i];
+}
+
+size_t ReceiveBatch::SegmentSize(size_t i) const {
+  assert(i < capacity_);
+  return segment_sizes_[i];
+}
+
+size_t ReceiveBatch::ReceiveOne(ip::udp::socket& socket, bs::error_code& ec) {
+  ReplenishBuffer(0);
+  lengths_[0] = socket.receive_from(asio::buffer(buffers_[0]->Data(), buffers_[0]->Capacity()),
+                                    sender_endpoints_[0], 0, ec);
+  segment_sizes_[0] = 0;
+  return ec ? 0 : 1;
+}
+
+#ifdef __linux__
+size_t ReceiveBatch::Receive(ip::udp::socket& socket, bs::error_code& ec) {
+  if (use_fallback_)
+    return ReceiveOne(socket, ec);
+
+  // The kernel overwrites the name and control lengths, so these must be reset before each call.
+  for (size_t i = 0; i < capacity_; ++i) {
+    ReplenishBuffer(i);
+    headers_[i].msg_hdr.msg_name = sender_endpoints_[i].data();
+    headers_[i].msg_hdr.msg_namelen = static_cast<socklen_t>(sender_endpoints_[i].capacity());
+    if (coalescing_) {
+      headers_[i].msg_hdr.msg_control = &control_[i * kControlSpace];
+      headers_[i].msg_hdr.msg_controllen = kControlSpace;
+    }
+  }
+
+  int count = ::recvmmsg(socket.native_handle(), headers_.data(),
+                         static_cast<unsigned int>(capacity_), MSG_DONTWAIT, nullptr);
+  if (count < 0) {
+    if (errno == ENOSYS) {
+      use_fallback_ = true;
+      return ReceiveOne(socket, ec);
+    }
+    ec = bs::error_code(errno, asio::error::get_system_category());
+    return 0;
+  }
+  if (count == 0) {
+    ec = asio::error::would_block;
+    return 0;
+  }
+
+  ec.clear();
+  for (int i = 0; i < count; ++i) {
+    lengths_[i] = headers_[i].msg_len;
+    sender_endpoints_[i].resize(headers_[i].msg_hdr.msg_namelen);
+    segment_sizes_[i] = coalescing_ ? CoalescedSegmentSize(headers_[i].msg_hdr) : 0;
+  }
+  return static_cast<size_t>(count);
+}
+#else
+size_t ReceiveBatch::Receive(ip::udp::socket& socket, bs::error_code& ec) {
+  return ReceiveOne(socket, ec);
+}
+#endif
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
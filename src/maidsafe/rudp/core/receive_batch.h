@@ -0,0 +1,106 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_RECEIVE_BATCH_H_
+#define MAIDSAFE_RUDP_CORE_RECEIVE_BATCH_H_
+
+#ifdef __linux__
+#  include <sys/socket.h>
+#endif
+#include <cstdint>
+#include <vector>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/ip/udp.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "maidsafe/rudp/core/shared_buffer.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A ring of pooled receive buffers which can be filled with several datagrams using a single system
+// call.  Where recvmmsg is available, Receive drains up to Capacity() datagrams at once.  Elsewhere
+// it falls back to receiving a single datagram per call.  Packets decoded from a buffer may keep a
+// reference to it, in which case the buffer is replaced from the pool before the next Receive.
+//
+// If coalescing is enabled, the kernel may merge consecutive datagrams from the same sender into a
+// single receive (UDP generic receive offload).  SegmentSize then gives the size of the individual
+// datagrams, which the caller is responsible for splitting apart.
+class ReceiveBatch {
+ public:
+  explicit ReceiveBatch(size_t capacity);
+
+  // Enable UDP generic receive offload on the socket and enlarge the buffers to hold coalesced
+  // datagrams.  Returns false, leaving the batch unchanged, if the socket doesn't support it.
+  bool EnableCoalescing(boost::asio::ip::udp::socket& socket);
+  bool IsCoalescing() const { return coalescing_; }
+
+  // Receive as many datagrams as are immediately available, up to Capacity().  Returns the number
+  // of datagrams received.  If none could be received, ec is set (typically to would_block).
+  size_t Receive(boost::asio::ip::udp::socket& socket, boost::system::error_code& ec);
+
+  size_t Capacity() const { return capacity_; }
+
+  // The data and sender of the i'th datagram from the most recent call to Receive, and the buffer
+  // holding the data.
+  boost::asio::const_buffer Data(size_t i) const;
+  const SharedBufferPtr& Buffer(size_t i) const;
+  const boost::asio::ip::udp::endpoint& SenderEndpoint(size_t i) const;
+
+  // The size of each datagram coalesced into the i'th receive, the last of which may be shorter.
+  // 0 if the receive holds a single datagram.
+  size_t SegmentSize(size_t i) const;
+
+ private:
+  // Disallow copying and assignment.
+  ReceiveBatch(const ReceiveBatch&);
+  ReceiveBatch& operator=(const ReceiveBatch&);
+
+  size_t ReceiveOne(boost::asio::ip::udp::socket& socket, boost::system::error_code& ec);
+  void AllocateBuffers(size_t buffer_size);
+  // Replace the i'th buffer with a free one if it is still referenced by a previously received
+  // packet.
+  void ReplenishBuffer(size_t i);
+
+  const size_t capacity_;
+  std::shared_ptr<SharedBufferPool> pool_;
+  std::vector<SharedBufferPtr> buffers_;
+  std::vector<size_t> lengths_, segment_sizes_;
+  std::vector<boost::asio::ip::udp::endpoint> sender_endpoints_;
+#ifdef __linux__
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> headers_;
+  // Ancillary data buffers which receive the segment size of coalesced datagrams.
+  std::vector<char> control_;
+#endif
+  bool coalescing_;
+  // Set if the kernel reports that recvmmsg is unsupported, after which ReceiveOne is used.
+  bool use_fallback_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_RECEIVE_BATCH_H_
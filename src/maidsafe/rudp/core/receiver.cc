@@ -33,6 +33,7 @@
 #include "maidsafe/rudp/core/congestion_control.h"
 #include "maidsafe/rudp/core/peer.h"
 #include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/packets/ack_frequency_packet.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
 #include "maidsafe/rudp/packets/negative_ack_packet.h"
 
@@ -52,14 +53,36 @@ Receiver::Receiver(Peer& peer, TickTimer& tick_timer,
       congestion_control_(congestion_control),
       unread_packets_(),
       acks_(),
+      received_sequences_(),
       last_ack_packet_sequence_number_(0),
+      advertised_buffer_size_(std::numeric_limits<uint32_t>::max()),
+      unacked_packet_count_(0),
+      ack_due_(bptime::pos_infin),
+      ack_frequency_sequence_number_(0),
+      loss_recovery_mode_(Parameters::loss_recovery_mode),
+      missing_sequences_(),
+      negative_ack_due_(bptime::pos_infin),
       ack_sent_time_(tick_timer_.Now()) {}
 
 void Receiver::Reset(uint32_t initial_sequence_number) {
   unread_packets_.Reset(initial_sequence_number);
+  received_sequences_.Clear();
+  unacked_packet_count_ = 0;
+  ack_due_ = bptime::pos_infin;
+  advertised_buffer_size_ = std::numeric_limits<uint32_t>::max();
+  missing_sequences_.Clear();
+  negative_ack_due_ = bptime::pos_infin;
   last_ack_packet_sequence_number_ = initial_sequence_number;
 }
 
+void Receiver::SetLossRecoveryMode(Parameters::LossRecoveryMode mode) {
+  loss_recovery_mode_ = mode;
+  if (loss_recovery_mode_ != Parameters::kReceiverNegativeAck) {
+    missing_sequences_.Clear();
+    negative_ack_due_ = bptime::pos_infin;
+  }
+}
+
 bool Receiver::Flushed() const {
   // mjc : check
   // uint32_t ack_packet_seqnum = AckPacketSequenceNumber();
@@ -71,6 +94,7 @@ size_t Receiver::ReadData(const boost::asio::mutable_buffer& data) {
   unsigned char* begin = boost::asio::buffer_cast<unsigned char*>(data);
   unsigned char* ptr = begin;
   unsigned char* end = begin + boost::asio::buffer_size(data);
+  size_t packets_read = 0;
 
   for (uint32_t n = unread_packets_.Begin(); (n != unread_packets_.End()) && (ptr < end);
        n = unread_packets_.Next(n)) {
@@ -78,21 +102,35 @@ size_t Receiver::ReadData(const boost::asio::mutable_buffer& data) {
     //    LOG(kSuccess) << p.packet.MessageNumber() << std::boolalpha << "\t"
     //                  << p.packet.FirstPacketInMessage() << "\t"
     //                  << p.packet.LastPacketInMessage();
-    if (p.lost) {
+    if (p.lost)
       break;
-    } else if (p.packet.Data().size() > p.bytes_read) {
-      size_t length = std::min<size_t>(end - ptr, p.packet.Data().size() - p.bytes_read);
-      std::memcpy(ptr, p.packet.Data().data() + p.bytes_read, length);
+    // The payload usually still lies in the buffer it was received into, so this is its only copy.
+    boost::asio::const_buffer payload(p.packet.Payload());
+    size_t payload_size(boost::asio::buffer_size(payload));
+    if (payload_size > p.bytes_read) {
+      size_t length = std::min<size_t>(end - ptr, payload_size - p.bytes_read);
+      std::memcpy(ptr, boost::asio::buffer_cast<const unsigned char*>(payload) + p.bytes_read,
+                  length);
       ptr += length;
       p.bytes_read += length;
-      if (p.packet.Data().size() == p.bytes_read) {
+      if (payload_size == p.bytes_read) {
         unread_packets_.Remove();
+        ++packets_read;
       }
     } else {
       unread_packets_.Remove();
+      ++packets_read;
     }
   }
 
+  // The rate at which the application reads determines the size of the receive window.  If the peer
+  // may be waiting for room, it's acked straight away rather than waiting for more data to arrive.
+  bool caught_up = unread_packets_.IsEmpty() || unread_packets_.Front().lost;
+  congestion_control_.OnDataRead(packets_read, caught_up);
+  if (packets_read && WindowUpdateDue()) {
+    ack_due_ = tick_timer_.Now();
+    HandleTick();
+  }
   return ptr - begin;
 }
 
@@ -101,14 +139,28 @@ void Receiver::HandleData(const DataPacket& packet) {
 
   uint32_t seqnum = packet.PacketSequenceNumber();
 
+  // Anything other than the next packet expected means one has been lost or reordered, and a
+  // duplicate suggests an ack was lost, so these are acked immediately to speed up recovery.
+  bool ack_now = (seqnum != unread_packets_.End());
+
   // Make sure there is space in the window for packets that are expected soon.
   // sliding_window will keep appending till reach the current seqnum or full.
   // i.e. any un-received packet, having previous seqnum, will be given an empty
   // reserved slot.
   // Later arrived packet, having less seqnum, will not affect sliding window
-  while (unread_packets_.IsComingSoon(seqnum) && !unread_packets_.IsFull())
-    // New entries are marked "lost" by default, and reserve_time set to now
-    unread_packets_.Append();
+  // New entries are marked "lost" by default, and reserve_time set to now (window slots are reused,
+  // so it has to be set here rather than left to UnreadPacket's constructor).
+  // When sending negative acks, any skipped over are reported missing straight away.
+  bptime::ptime now = tick_timer_.Now();
+  bool negative_acks = (loss_recovery_mode_ == Parameters::kReceiverNegativeAck);
+  while (unread_packets_.IsComingSoon(seqnum) && !unread_packets_.IsFull()) {
+    uint32_t n = unread_packets_.Append();
+    unread_packets_[n].reserve_time = now;
+    if (negative_acks && n != seqnum) {
+      missing_sequences_.Insert(n);
+      negative_ack_due_ = now;
+    }
+  }
 
   // Ignore any packet which isn't in the window.
   // The empty slot will got populated here, if the packet arrived later having
@@ -121,9 +173,13 @@ void Receiver::HandleData(const DataPacket& packet) {
       p.packet = packet;
       p.lost = false;
       p.bytes_read = 0;
-      received_sequences_.insert(seqnum);
+      received_sequences_.Insert(seqnum);
+      if (negative_acks)
+        missing_sequences_.Erase(seqnum, seqnum);
+      ++unacked_packet_count_;
     } else {
       LOG(kWarning) << "Seqnum already received: " << seqnum;
+      ack_now = true;
     }
   } else {
     LOG(kWarning) << "Ignoring incoming packet with seqnum " << seqnum
@@ -131,12 +187,14 @@ void Receiver::HandleData(const DataPacket& packet) {
                   << unread_packets_.End();
   }
 
-  if (received_sequences_.size() % congestion_control_.AckInterval() == 0) {
+  if (ack_now || unacked_packet_count_ >= congestion_control_.AckInterval()) {
     // Send acknowledgement packets immediately.
+    ack_due_ = now;
     HandleTick();
-  } else {
-    // Schedule generation of acknowledgement packets for later.
-    // tick_timer_.TickAfter(congestion_control_.AckDelay());
+  } else if (unacked_packet_count_ == 1) {
+    // Schedule generation of acknowledgement packets for when this packet has waited long enough.
+    ack_due_ = now + congestion_control_.AckDelay();
+    tick_timer_.TickAt(ack_due_);
   }
 
   if (tick_timer_.Expired()) {
@@ -155,10 +213,8 @@ void Receiver::HandleAckOfAck(const AckOfAckPacket& packet) {
       congestion_control_.OnAckOfAck(static_cast<uint32_t>(rtt_us));
     }
 
-    for (auto seq_range : a.packet.GetSequenceRanges()) {
-      for (uint32_t seq = seq_range.first; seq <= seq_range.second; ++seq)
-        received_sequences_.erase(seq);
-    }
+    for (auto seq_range : a.packet.GetSequenceRanges())
+      received_sequences_.Erase(seq_range.first, seq_range.second);
   }
 
   while (acks_.Contains(ack_seqnum)) {
@@ -166,37 +222,62 @@ void Receiver::HandleAckOfAck(const AckOfAckPacket& packet) {
   }
 }
 
+void Receiver::HandleAckFrequency(const AckFrequencyPacket& packet) {
+  // Ignore a request which has been overtaken by a later one.
+  uint32_t n = packet.RequestSequenceNumber();
+  if (static_cast<int32_t>(n - ack_frequency_sequence_number_) <= 0)
+    return;
+  ack_frequency_sequence_number_ = n;
+  congestion_control_.OnAckFrequency(packet.AckInterval(),
+                                     bptime::microseconds(packet.AckDelay()));
+}
+
 void Receiver::HandleTick() {
   bptime::ptime now = tick_timer_.Now();
 
-  AddAckToWindow(now);
+  // Ack once a received packet has waited as long as it may, or if the last ack hasn't itself been
+  // acknowledged in time (each ack repeats the ranges of any earlier ones still unacknowledged).
+  if (now >= ack_due_ ||
+      (!acks_.IsEmpty() && now >= acks_.Back().send_time + congestion_control_.AckTimeout())) {
+    AddAckToWindow(now);
+  }
+  if (!ack_due_.is_pos_infinity())
+    tick_timer_.TickAt(ack_due_);
   if (!acks_.IsEmpty()) {
 //    if (acks_.Back().send_time + congestion_control_.AckTimeout() > now) {
       tick_timer_.TickAt(acks_.Back().send_time + congestion_control_.AckTimeout());
 //    }
   }
 
-  // mjc : remove the receiver side control of NAK. The sender and receiver are
-  //       currently fighting and flooding the channel with useless retransmission.
-  //       There are advantages/disadvantages to each approach (producer vs consumer control).
-  //       Rework to allow selection. The NAK algorithm needs to be more sophesticated however.
-  //
-  // Generate a negative acknowledgement packet to request missing packets.
-  // NegativeAckPacket negative_ack;
-  // negative_ack.SetDestinationSocketId(peer_.SocketId());
-  // AddMissingSequenceNumbersToNegAck(negative_ack);
-  // if (negative_ack.HasSequenceNumbers()) {
-  //   peer_.Send(negative_ack);
-  //   tick_timer_.TickAt(now + congestion_control_.AckTimeout());
-  // }
+  // Request missing packets which are due to be reported.  Unless the peer has been told to expect
+  // them, its sender retransmits on timeout instead (see Parameters::loss_recovery_mode).
+  if (loss_recovery_mode_ == Parameters::kReceiverNegativeAck) {
+    if (now >= negative_ack_due_)
+      SendNegativeAck(now);
+    if (!negative_ack_due_.is_pos_infinity())
+      tick_timer_.TickAt(negative_ack_due_);
+  }
 }
 
 void Receiver::AddAckToWindow(const bptime::ptime& now) {
   // mjc : arg not used ... just stick something in there for now
   congestion_control_.OnGenerateAck(1);
+  unacked_packet_count_ = 0;
+  ack_due_ = bptime::pos_infin;
 
   AckPacket ack_packet;
   AddAckPacketSequenceNumbers(ack_packet);
+  // A window update with nothing new to acknowledge repeats the ack of the latest packet received,
+  // and is itself repeated until acknowledged.  The slots at the end of the window may only be
+  // reserved for packets still to arrive, and if none has arrived the last one read is used (the
+  // peer ignores it if it isn't awaiting its ack).
+  if (!ack_packet.HasSequenceNumbers() && (WindowUpdateDue() || !acks_.IsEmpty())) {
+    const uint32_t kMaxSequenceNumber = UnreadPacketWindow::kMaxSequenceNumber;
+    uint32_t n = (unread_packets_.End() + kMaxSequenceNumber) & kMaxSequenceNumber;
+    while (unread_packets_.Contains(n) && unread_packets_[n].lost)
+      n = (n + kMaxSequenceNumber) & kMaxSequenceNumber;
+    ack_packet.AddSequenceNumber(n);
+  }
 
   if (ack_packet.HasSequenceNumbers()) {
     if (acks_.IsFull())
@@ -211,7 +292,8 @@ void Receiver::AddAckToWindow(const bptime::ptime& now) {
     a.packet.SetHasOptionalFields(true);
     a.packet.SetRoundTripTime(congestion_control_.RoundTripTime());
     a.packet.SetRoundTripTimeVariance(congestion_control_.RoundTripTimeVariance());
-    a.packet.SetAvailableBufferSize(AvailableBufferSize());
+    advertised_buffer_size_ = AvailableBufferSize();
+    a.packet.SetAvailableBufferSize(advertised_buffer_size_);
     a.packet.SetPacketsReceivingRate(congestion_control_.PacketsReceivingRate());
     a.packet.SetEstimatedLinkCapacity(congestion_control_.EstimatedLinkCapacity());
 
@@ -220,32 +302,59 @@ void Receiver::AddAckToWindow(const bptime::ptime& now) {
   }
 }
 
-void Receiver::AddMissingSequenceNumbersToNegAck(NegativeAckPacket& negative_ack) {
-  uint32_t n = unread_packets_.Begin();
-  uint32_t nack_count = 0;
-  while (n != unread_packets_.End() && nack_count <= Parameters::maximum_segment_size) {
-    if (unread_packets_[n].lost) {
-      uint32_t begin = n;
-      uint32_t end;
-      do {
-        ++nack_count;
-        end = n;
-        n = unread_packets_.Next(n);
-      } while (n != unread_packets_.End() && unread_packets_[n].lost &&
-               nack_count <= Parameters::maximum_segment_size);
-
-      if (begin == end)
-        negative_ack.AddSequenceNumber(begin);
-      else
-        negative_ack.AddSequenceNumbers(begin, end);
-
-      // Only re-request the first block of missing sequence numbers.
-      break;
+void Receiver::SendNegativeAck(const bptime::ptime& now) {
+  NegativeAckPacket negative_ack;
+  negative_ack.SetDestinationSocketId(peer_.SocketId());
+  AddMissingSequenceNumbersToNegAck(negative_ack, now);
 
+  // Send can fail but that is ok. The packets will be reported again once their timeouts expire.
+  if (negative_ack.HasSequenceNumbers())
+    peer_.Send(negative_ack);
+}
+
+void Receiver::AddMissingSequenceNumbersToNegAck(NegativeAckPacket& negative_ack,
+                                                 const bptime::ptime& now) {
+  // Report the missing packets which are due, oldest first, in runs of consecutive sequence
+  // numbers.  Each run takes one or two words and the packet is kept within the default packet
+  // size, so any which don't fit are left due and reported on the next tick.
+  const size_t kMaxWords = (Parameters::default_size - ControlPacket::kHeaderSize) / 4;
+  size_t words = 0;
+  bool in_run = false;
+  uint32_t run_first = 0, run_last = 0;
+  auto end_run = [&]() {
+    if (!in_run)
+      return;
+    if (run_first == run_last) {
+      negative_ack.AddSequenceNumber(run_first);
+      --words;
     } else {
-      n = unread_packets_.Next(n);
+      negative_ack.AddSequenceNumbers(run_first, run_last);
     }
-  }
+    in_run = false;
+  };
+
+  negative_ack_due_ = bptime::pos_infin;
+  missing_sequences_.ForEachRange([&](uint32_t first, uint32_t last) {
+    for (uint32_t n = first;; n = unread_packets_.Next(n)) {
+      UnreadPacket& p = unread_packets_[n];
+      if (p.negative_ack_due <= now && (in_run || words + 2 <= kMaxWords)) {
+        if (!in_run) {
+          in_run = true;
+          run_first = n;
+          words += 2;
+        }
+        run_last = n;
+        ++p.negative_ack_count;
+        p.negative_ack_due = now + congestion_control_.NegativeAckTimeout(p.negative_ack_count);
+      } else {
+        end_run();
+      }
+      negative_ack_due_ = std::min(negative_ack_due_, p.negative_ack_due);
+      if (n == last)
+        break;
+    }
+    end_run();
+  });
 }
 
 uint32_t Receiver::AvailableBufferSize() const {
@@ -255,19 +364,19 @@ uint32_t Receiver::AvailableBufferSize() const {
   return static_cast<uint32_t>(free_packets * Parameters::max_data_size);
 }
 
+bool Receiver::WindowUpdateDue() const {
+  // Waiting until the room has grown by a segment (or half the window, if that's smaller) means the
+  // peer isn't told of each packet read separately.
+  size_t threshold = std::max<size_t>(
+      std::min<size_t>(unread_packets_.MaximumSize() / 2, Parameters::maximum_segment_size), 1);
+  uint64_t available = AvailableBufferSize();
+  return available >= advertised_buffer_size_ + UINT64_C(1) * threshold * Parameters::max_data_size;
+}
+
 void Receiver::AddAckPacketSequenceNumbers(AckPacket & packet) {
-  auto iter = received_sequences_.begin();
-  auto iter_end = received_sequences_.end();
-  while (iter != iter_end) {
-    uint32_t first = *iter;
-    uint32_t last = first;
-    ++iter;
-    while (iter != iter_end && *iter == last+1) {
-      last = *iter;
-      ++iter;
-    }
+  received_sequences_.ForEachRange([&packet](uint32_t first, uint32_t last) {
     packet.AddSequenceNumbers(first, last);
-  }
+  });
 }
 
 }  // namespace detail
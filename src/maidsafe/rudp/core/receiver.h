@@ -23,15 +23,16 @@
 
 #include <cstdint>
 #include <deque>
-#include <set>
 
 #include "boost/asio/buffer.hpp"
 #include "boost/asio/deadline_timer.hpp"
 #include "boost/asio/ip/udp.hpp"
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
+#include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/packets/ack_packet.h"
 #include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/core/sequence_bitmap.h"
 #include "maidsafe/rudp/core/sliding_window.h"
 
 namespace maidsafe {
@@ -40,6 +41,7 @@ namespace rudp {
 
 namespace detail {
 
+class AckFrequencyPacket;
 class AckOfAckPacket;
 class CongestionControl;
 class NegativeAckPacket;
@@ -53,6 +55,10 @@ class Receiver {
   // Reset receiver so that it is ready to start receiving data from the specified sequence number.
   void Reset(uint32_t initial_sequence_number);
 
+  // Set whether missing packets are reported to the peer in negative acks.  Should be set before
+  // data starts to arrive, and not switched back once any negative acks have been sent.
+  void SetLossRecoveryMode(Parameters::LossRecoveryMode mode);
+
   // Determine whether all acknowledgements have been processed.
   bool Flushed() const;
 
@@ -65,6 +71,9 @@ class Receiver {
   // Handle an acknowledgement of an acknowledgement packet.
   void HandleAckOfAck(const AckOfAckPacket& packet);
 
+  // Handle the peer's request for how often its data packets should be acknowledged.
+  void HandleAckFrequency(const AckFrequencyPacket& packet);
+
   // Handle a tick in the system time.
   void HandleTick();
 
@@ -76,12 +85,22 @@ class Receiver {
   // Helper function to decide the addition of an ack packet to the sliding window
   void AddAckToWindow(const boost::posix_time::ptime& now);
 
-  // Helper function to add the sequence numbers of missing packets to a negative ack packet
-  void AddMissingSequenceNumbersToNegAck(NegativeAckPacket& negative_ack);
+  // Helper function to send a negative ack for the missing packets due to be reported (again), and
+  // to work out when the next will be due.
+  void SendNegativeAck(const boost::posix_time::ptime& now);
+
+  // Helper function to add the sequence numbers of missing packets due to be reported to a negative
+  // ack packet
+  void AddMissingSequenceNumbersToNegAck(NegativeAckPacket& negative_ack,
+                                         const boost::posix_time::ptime& now);
 
   // Helper function to calculate the available buffer size.
   uint32_t AvailableBufferSize() const;
 
+  // Whether reading has made enough room since the last ack that the peer, which may have stopped
+  // sending for lack of it, should be told.
+  bool WindowUpdateDue() const;
+
   // Calculate the sequence number which should be sent in an acknowledgement.
   void AddAckPacketSequenceNumbers(AckPacket & packet);
 
@@ -99,11 +118,16 @@ class Receiver {
         : packet(),
           lost(true),
           bytes_read(0),
-          reserve_time(boost::asio::deadline_timer::traits_type::now()) {}
+          reserve_time(boost::asio::deadline_timer::traits_type::now()),
+          negative_ack_count(0),
+          negative_ack_due(boost::posix_time::neg_infin) {}
     DataPacket packet;
     bool lost;
     size_t bytes_read;
     boost::posix_time::ptime reserve_time;
+    // The number of times the packet has been reported missing, and when it's next due to be.
+    uint32_t negative_ack_count;
+    boost::posix_time::ptime negative_ack_due;
 
     bool Missing(boost::posix_time::time_duration time_out) {
       boost::posix_time::ptime now = boost::asio::deadline_timer::traits_type::now();
@@ -127,12 +151,31 @@ class Receiver {
   typedef SlidingWindow<Ack> AckWindow;
   AckWindow acks_;
 
-  typedef std::set<uint32_t> ReceivedSequenceSet;
-  ReceivedSequenceSet received_sequences_;
+  // The sequence numbers of packets received since the last acknowledgement of an acknowledgement
+  // which covered them.
+  SequenceBitmap received_sequences_;
 
   // The last packet sequence number to have been acknowledged.
   uint32_t last_ack_packet_sequence_number_;
 
+  // The available buffer size reported in the last ack sent, or the maximum value if none has been.
+  uint32_t advertised_buffer_size_;
+
+  // The number of data packets received since the last ack was generated, and the time by which the
+  // next ack is due (pos_infin if there's nothing new to ack).
+  uint32_t unacked_packet_count_;
+  boost::posix_time::ptime ack_due_;
+
+  // The request number of the last ack frequency requested by the peer.
+  uint32_t ack_frequency_sequence_number_;
+
+  Parameters::LossRecoveryMode loss_recovery_mode_;
+
+  // In kReceiverNegativeAck mode, the sequence numbers of the packets in the unread window which
+  // are still missing, and the earliest time at which one of them is due to be reported.
+  SequenceBitmap missing_sequences_;
+  boost::posix_time::ptime negative_ack_due_;
+
   // Next time the ack packet shall be sent
   boost::posix_time::ptime ack_sent_time_;
 };
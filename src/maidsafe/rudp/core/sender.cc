@@ -22,12 +22,14 @@
 
 #include <algorithm>
 #include <cassert>
+#include <utility>
 
 #include "maidsafe/common/utils.h"
 
 #include "maidsafe/rudp/core/congestion_control.h"
 #include "maidsafe/rudp/core/peer.h"
 #include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/packets/ack_frequency_packet.h"
 #include "maidsafe/rudp/packets/ack_packet.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
 #include "maidsafe/rudp/packets/keepalive_packet.h"
@@ -47,14 +49,29 @@ Sender::Sender(Peer& peer, TickTimer& tick_timer, CongestionControl& congestion_
       tick_timer_(tick_timer),
       congestion_control_(congestion_control),
       unacked_packets_(),
+      acked_end_(unacked_packets_.End()),
+      peer_sends_negative_acks_(false),
+      peer_receive_space_(Parameters::default_window_size),
+      loss_list_(),
+      first_unsent_(unacked_packets_.End()),
+      sent_packets_(),
       send_timeout_(),
-      current_message_number_(0) {}
+      current_message_number_(0),
+      ack_frequency_sequence_number_(0),
+      requested_ack_interval_(0),
+      requested_ack_delay_(0) {}
 
 uint32_t Sender::GetNextPacketSequenceNumber() const { return unacked_packets_.End(); }
 
 bool Sender::Flushed() const { return unacked_packets_.IsEmpty(); }
 
-size_t Sender::AddData(const boost::asio::const_buffer& data, uint32_t message_number) {
+size_t Sender::AddData(const SharedBufferPtr& buffer, const boost::asio::const_buffer& data,
+                       uint32_t message_number) {
+  return AddData(boost::asio::const_buffer(), buffer, data, message_number);
+}
+
+size_t Sender::AddData(const boost::asio::const_buffer& prefix, const SharedBufferPtr& buffer,
+                       const boost::asio::const_buffer& data, uint32_t message_number) {
   if ((congestion_control_.SendWindowSize() == 0) && (unacked_packets_.Size() == 0))
     unacked_packets_.SetMaximumSize(Parameters::default_window_size);
   else
@@ -63,9 +80,13 @@ size_t Sender::AddData(const boost::asio::const_buffer& data, uint32_t message_n
   const unsigned char* begin = boost::asio::buffer_cast<const unsigned char*>(data);
   const unsigned char* ptr = begin;
   const unsigned char* end = begin + boost::asio::buffer_size(data);
+  size_t prefix_size = boost::asio::buffer_size(prefix);
+  size_t prefix_added = 0;
+  assert(prefix_size <= DataPacket::kMaxPrefixSize &&
+         prefix_size < congestion_control_.SendDataSize());
 
-  while (!unacked_packets_.IsFull() && (ptr < end)) {
-    size_t length = std::min<size_t>(congestion_control_.SendDataSize(), end - ptr);
+  while (!unacked_packets_.IsFull() && ((prefix_size != 0) || (ptr < end))) {
+    size_t length = std::min<size_t>(congestion_control_.SendDataSize() - prefix_size, end - ptr);
     uint32_t n = unacked_packets_.Append();
 
     UnackedPacket& p = unacked_packets_[n];
@@ -77,18 +98,21 @@ size_t Sender::AddData(const boost::asio::const_buffer& data, uint32_t message_n
     p.packet.SetMessageNumber(message_number);
     p.packet.SetTimeStamp(0);
     p.packet.SetDestinationSocketId(peer_.SocketId());
-    p.packet.SetData(ptr, ptr + length);
-    p.lost = true;  // Mark as lost so that DoSend() will send it.
+    p.packet.SetData(boost::asio::buffer(prefix, prefix_size), buffer,
+                     boost::asio::buffer(ptr, length));
 
     ptr += length;
+    prefix_added += prefix_size;
+    prefix_size = 0;
   }
 
   DoSend();
 
-  return ptr - begin;
+  return prefix_added + (ptr - begin);
 }
 
 void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed_message_numbers) {
+  ScopedTransmitBatch batch(peer_);
   if (packet.HasOptionalFields()) {
     congestion_control_.OnAck(1,  // seqnum,
                               packet.RoundTripTime(),
@@ -105,13 +129,29 @@ void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed
   response_packet.SetDestinationSocketId(peer_.SocketId());
   response_packet.SetAckSequenceNumber(packet.AckSequenceNumber());
   peer_.Send(response_packet);
+  RequestAckFrequency();
+
 
+  // The peer's available buffer size is what it has room for after the latest packet it's received,
+  // which is the latest one acknowledged (by this or an earlier ack).
+  if (packet.HasOptionalFields())
+    peer_receive_space_ = packet.AvailableBufferSize() / Parameters::max_data_size;
 
   // mark ack'd packets
   for (auto seq_range : packet.GetSequenceRanges()) {
+    if (unacked_packets_.Contains(seq_range.second) && IsSent(seq_range.second) &&
+        !IsBeforeAcked(seq_range.second)) {
+      acked_end_ = unacked_packets_.Next(seq_range.second);
+    }
     for (uint32_t seq = seq_range.first; seq <= seq_range.second; ++seq) {
-      if (unacked_packets_.Contains(seq))
-        unacked_packets_[seq].ackd = true;
+      if (unacked_packets_.Contains(seq) && IsSent(seq)) {
+        UnackedPacket& p = unacked_packets_[seq];
+        p.ackd = true;
+        if (p.lost) {
+          loss_list_.erase(seq);
+          p.lost = false;
+        }
+      }
     }
   }
 
@@ -127,25 +167,66 @@ void Sender::HandleAck(const AckPacket& packet, std::vector<uint32_t>& completed
     new_room = true;
     unacked_packets_.Remove();
   }
+  DropStaleSends();
 
   if (new_room)
     DoSend();
 }
 
 void Sender::HandleNegativeAck(const NegativeAckPacket& packet) {
-  // Mark the specified packets as lost.
-  for (uint32_t n = unacked_packets_.Begin(); n != unacked_packets_.End();
-       n = unacked_packets_.Next(n)) {
-    if (packet.ContainsSequenceNumber(n)) {
-      congestion_control_.OnNegativeAck(n);
-      unacked_packets_[n].lost = true;
+  peer_sends_negative_acks_ = true;
+
+  // Mark the specified packets as lost.  Each range is clipped to the window, which is itself one or
+  // (if it wraps around) two ranges, so only the slots named are visited.
+  if (!unacked_packets_.IsEmpty()) {
+    const uint32_t kMaxSequenceNumber = UnackedPacketWindow::kMaxSequenceNumber;
+    uint32_t window_first = unacked_packets_.Begin();
+    uint32_t window_last = (unacked_packets_.End() + kMaxSequenceNumber) & kMaxSequenceNumber;
+    std::pair<uint32_t, uint32_t> window_ranges[2];
+    size_t window_range_count = 0;
+    if (window_first <= window_last) {
+      window_ranges[window_range_count++] = std::make_pair(window_first, window_last);
+    } else {
+      window_ranges[window_range_count++] = std::make_pair(window_first, kMaxSequenceNumber);
+      window_ranges[window_range_count++] = std::make_pair(0u, window_last);
+    }
+    for (const auto& range : packet.GetSequenceRanges()) {
+      for (size_t i = 0; i < window_range_count; ++i) {
+        uint32_t last = std::min(range.second, window_ranges[i].second);
+        for (uint32_t n = std::max(range.first, window_ranges[i].first); n <= last; ++n) {
+          if (MarkLost(n))
+            congestion_control_.OnNegativeAck(n);
+        }
+      }
     }
   }
 
   DoSend();
 }
 
+void Sender::RequestAckFrequency() {
+  uint32_t ack_interval = congestion_control_.PeerAckInterval();
+  uint32_t ack_delay =
+      static_cast<uint32_t>(congestion_control_.PeerAckDelay().total_microseconds());
+  // The delay follows the round trip time, so only changes of at least a factor of two count.
+  if (ack_interval == requested_ack_interval_ && ack_delay < 2 * requested_ack_delay_ &&
+      2 * ack_delay > requested_ack_delay_) {
+    return;
+  }
+
+  AckFrequencyPacket request;
+  request.SetDestinationSocketId(peer_.SocketId());
+  request.SetRequestSequenceNumber(++ack_frequency_sequence_number_);
+  request.SetAckInterval(ack_interval);
+  request.SetAckDelay(ack_delay);
+  if (peer_.Send(request) == kSuccess) {
+    requested_ack_interval_ = ack_interval;
+    requested_ack_delay_ = ack_delay;
+  }
+}
+
 void Sender::HandleTick() {
+  ScopedTransmitBatch batch(peer_);
   bptime::ptime now = tick_timer_.Now();
   if (send_timeout_ <= now) {
     // Clear timeout. Will be reset next time a data packet is sent.
@@ -158,41 +239,57 @@ void Sender::HandleTick() {
 }
 
 void Sender::DoSend() {
+  // The packets remain in unacked_packets_ until at least the end of this pass, so they can be
+  // gathered straight from there when the batch is flushed.
+  ScopedTransmitBatch batch(peer_);
   uint32_t packets_sent = 0;
   bptime::ptime now = tick_timer_.Now();
 
-  for (UnackedPacketWindow::seq_num_t n = unacked_packets_.Begin();
-       n != unacked_packets_.End() && packets_sent < Parameters::default_burst_send_size;
-       n = unacked_packets_.Next(n)) {
+  while (packets_sent < Parameters::default_burst_send_size) {
+    bool retransmit = !loss_list_.empty();
+    if (!retransmit && (first_unsent_ == unacked_packets_.End() || !PeerHasRoom()))
+      break;
+    UnackedPacketWindow::seq_num_t n = retransmit ? *loss_list_.begin() : first_unsent_;
     UnackedPacket& p = unacked_packets_[n];
-    if (p.lost) {
-      // peer_.Send is a blockable function call, it will only returned when
-      // the UDP socket sent out the packet successfully. So here the all
-      // un-acked packets can be sent out one-by-one in a bunch, i.e. the whole
-      // buffer (packet_size * window_size) will be sent out at once.
-      // If we make the Send to be unblockable, i.e. handled by a seperate
-      // thread, then we will need to first Check whether we are allowed to
-      // send another packet at this time.
-      if (peer_.Send(p.packet) == kSuccess) {
-        ++packets_sent;
-        p.lost = false;
-        p.last_send_time = now;
-        congestion_control_.OnDataPacketSent(n);
-      } else {
-        LOG(kVerbose) << "DoSend - failed sending packet " << n;
-      }
+    // peer_.Send is a blockable function call, it will only returned when
+    // the UDP socket sent out the packet successfully. So here the all
+    // un-acked packets can be sent out one-by-one in a bunch, i.e. the whole
+    // buffer (packet_size * window_size) will be sent out at once.
+    // If we make the Send to be unblockable, i.e. handled by a seperate
+    // thread, then we will need to first Check whether we are allowed to
+    // send another packet at this time.
+    if (peer_.Send(p.packet) != kSuccess) {
+      // Left where it is, to be tried again on the next pass.
+      LOG(kVerbose) << "DoSend - failed sending packet " << n;
+      break;
+    }
+    if (retransmit) {
+      loss_list_.erase(loss_list_.begin());
+      p.lost = false;
+    } else {
+      first_unsent_ = unacked_packets_.Next(first_unsent_);
     }
+    ++packets_sent;
+    p.last_send_time = now;
+    sent_packets_.push_back(std::make_pair(n, now));
+    congestion_control_.OnDataPacketSent(n);
   }
 
-  if (packets_sent)
+  // Set the send timeout so that unacknowledged packets can be marked as lost.  The oldest
+  // outstanding send is the first to time out.
+  DropStaleSends();
+  send_timeout_ = sent_packets_.empty() ?
+      bptime::ptime(bptime::pos_infin) :
+      sent_packets_.front().second + congestion_control_.SendTimeout();
+
+  if (packets_sent) {
     tick_timer_.TickAt(now + congestion_control_.SendDelay());
-  else
+  } else if (!sent_packets_.empty()) {
+    // Wake when the oldest send times out, but no sooner than a send would be allowed anyway, so a
+    // failing send can't cause a busy loop.
+    tick_timer_.TickAt(std::max(send_timeout_, now + congestion_control_.SendDelay()));
+  } else {
     tick_timer_.TickAt(now + congestion_control_.SendTimeout());
-
-
-  // Set the send timeout so that unacknowledged packets can be marked as lost.
-  if (!unacked_packets_.IsEmpty()) {
-    send_timeout_ = unacked_packets_.Front().last_send_time + congestion_control_.SendTimeout();
   }
 }
 
@@ -202,15 +299,55 @@ void Sender::MarkExpiredPackets() {
 }
 
 void Sender::MarkExpiredPackets(boost::posix_time::ptime expire_time) {
-  // Mark all timedout unacknowledged packets as lost.
-  for (UnackedPacketWindow::seq_num_t n = unacked_packets_.Begin();
-       n != unacked_packets_.End();
-       n = unacked_packets_.Next(n)) {
-    if (!unacked_packets_[n].ackd &&
-        (unacked_packets_[n].last_send_time + congestion_control_.SendTimeout()) < expire_time) {
+  // Mark all timedout unacknowledged packets as lost.  Sends are queued in the order made, so only
+  // those which have timed out are visited.
+  DropStaleSends();
+  // If the peer sends negative acks, those for packets it knows are missing are left to it, since
+  // resending them here too would only duplicate its requests.
+  while (!sent_packets_.empty() &&
+         (sent_packets_.front().second + congestion_control_.SendTimeout()) < expire_time) {
+    uint32_t n = sent_packets_.front().first;
+    sent_packets_.pop_front();
+    if ((!peer_sends_negative_acks_ || !IsBeforeAcked(n)) && MarkLost(n))
       congestion_control_.OnSendTimeout(n);
-      unacked_packets_[n].lost = true;
+    DropStaleSends();
+  }
+}
+
+bool Sender::IsSent(uint32_t n) const {
+  const uint32_t kMaxSequenceNumber = UnackedPacketWindow::kMaxSequenceNumber;
+  uint32_t begin = unacked_packets_.Begin();
+  return ((n - begin) & kMaxSequenceNumber) < ((first_unsent_ - begin) & kMaxSequenceNumber);
+}
+
+bool Sender::PeerHasRoom() const {
+  const uint32_t kMaxSequenceNumber = UnackedPacketWindow::kMaxSequenceNumber;
+  return ((first_unsent_ - acked_end_) & kMaxSequenceNumber) < peer_receive_space_;
+}
+
+bool Sender::IsBeforeAcked(uint32_t n) const {
+  const uint32_t kMaxSequenceNumber = UnackedPacketWindow::kMaxSequenceNumber;
+  uint32_t begin = unacked_packets_.Begin();
+  return ((n - begin) & kMaxSequenceNumber) < ((acked_end_ - begin) & kMaxSequenceNumber);
+}
+
+bool Sender::MarkLost(uint32_t n) {
+  UnackedPacket& p = unacked_packets_[n];
+  if (p.lost || p.ackd || !IsSent(n))
+    return false;
+  p.lost = true;
+  loss_list_.insert(n);
+  return true;
+}
+
+void Sender::DropStaleSends() {
+  while (!sent_packets_.empty()) {
+    uint32_t n = sent_packets_.front().first;
+    if (unacked_packets_.Contains(n) && !unacked_packets_[n].ackd &&
+        unacked_packets_[n].last_send_time == sent_packets_.front().second) {
+      break;
     }
+    sent_packets_.pop_front();
   }
 }
 
@@ -22,6 +22,9 @@
 #define MAIDSAFE_RUDP_CORE_SENDER_H_
 
 #include <cstdint>
+#include <deque>
+#include <set>
+#include <utility>
 #include <vector>
 
 #include "boost/asio/buffer.hpp"
@@ -29,6 +32,7 @@
 #include "boost/date_time/posix_time/posix_time_types.hpp"
 
 #include "maidsafe/rudp/return_codes.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
 #include "maidsafe/rudp/core/sliding_window.h"
 #include "maidsafe/rudp/packets/data_packet.h"
 #include "maidsafe/rudp/packets/shutdown_packet.h"
@@ -56,8 +60,15 @@ class Sender {
   // Determine whether all data has been transmitted to the peer.
   bool Flushed() const;
 
-  // Adds some application data to be sent. Returns number of bytes copied.
-  size_t AddData(const boost::asio::const_buffer& data, uint32_t message_number);
+  // Adds some application data, which must lie within buffer, to be sent.  The data packets refer
+  // to buffer rather than copying from it.  Returns number of bytes added.
+  size_t AddData(const SharedBufferPtr& buffer, const boost::asio::const_buffer& data,
+                 uint32_t message_number);
+  // As above, but data is preceded by prefix, of at most DataPacket::kMaxPrefixSize bytes, which is
+  // copied into the first packet.  Either all of prefix is added or none of it; the bytes added
+  // include it.
+  size_t AddData(const boost::asio::const_buffer& prefix, const SharedBufferPtr& buffer,
+                 const boost::asio::const_buffer& data, uint32_t message_number);
 
   // Notify the other side that the current connection is to be dropped
   void NotifyClose();
@@ -83,9 +94,32 @@ class Sender {
   Sender(const Sender&);
   Sender& operator=(const Sender&);
 
-  // Send waiting packets.
+  // Send waiting packets: those on the loss list first, then any not yet sent.
   void DoSend();
 
+  // Whether the packet with sequence number n has been sent at least once.
+  // Precondition: unacked_packets_.Contains(n) or n == unacked_packets_.End().
+  bool IsSent(uint32_t n) const;
+
+  // Whether the peer has room for the first unsent packet.
+  bool PeerHasRoom() const;
+
+  // Whether the packet with sequence number n precedes one which the peer has acknowledged, so that
+  // a peer which sends negative acks knows it to be missing.
+  // Precondition: unacked_packets_.Contains(n).
+  bool IsBeforeAcked(uint32_t n) const;
+
+  // Put a sent, unacknowledged packet on the loss list, unless it's already there.  Returns whether
+  // the packet was newly added.
+  bool MarkLost(uint32_t n);
+
+  // Pop entries from the front of sent_packets_ which no longer refer to an outstanding send.
+  void DropStaleSends();
+
+  // Ask the peer to ack at the frequency congestion control now wants, if that has changed much
+  // since it was last asked.
+  void RequestAckFrequency();
+
   // Called to mark unacked packets that have expired and should be
   // proactively resent
   void MarkExpiredPackets();
@@ -103,6 +137,7 @@ class Sender {
   struct UnackedPacket {
     UnackedPacket() : packet(), lost(false), ackd(false), last_send_time() {}
     DataPacket packet;
+    // Whether the packet is on loss_list_.
     bool lost;
     bool ackd;
     boost::posix_time::ptime last_send_time;
@@ -112,10 +147,49 @@ class Sender {
   typedef SlidingWindow<UnackedPacket> UnackedPacketWindow;
   UnackedPacketWindow unacked_packets_;
 
-  // The next time at which all unacked packets will be considered lost.
+  // One past the latest sequence number the peer has acknowledged.  Never before the window begins.
+  uint32_t acked_end_;
+
+  // Whether the peer has sent a negative ack, i.e. reports any gaps in the packets it receives.  If
+  // so, packets before acked_end_ are only resent when the peer asks, rather than on timeout too.
+  bool peer_sends_negative_acks_;
+
+  // The number of packets after acked_end_ which the peer last reported having room for.  Packets
+  // are only sent for the first time while there's room for them at the peer.
+  size_t peer_receive_space_;
+
+  // Orders sequence numbers within the window, allowing for wraparound.  The window is far smaller
+  // than half the sequence number space, so this is a strict weak ordering of its contents.
+  struct WindowOrder {
+    bool operator()(uint32_t lhs, uint32_t rhs) const {
+      return lhs != rhs && ((rhs - lhs) & UnackedPacketWindow::kMaxSequenceNumber) < 0x40000000;
+    }
+  };
+
+  // The sent packets needing retransmission (following a negative ack or timeout), oldest first.
+  // Only ever holds packets in the window which haven't been acknowledged.
+  std::set<uint32_t, WindowOrder> loss_list_;
+
+  // The packets from this one to the end of the window have not been sent yet.
+  uint32_t first_unsent_;
+
+  // Each send of a packet, and when it was made, in the order made.  An entry is stale once its
+  // packet has been acknowledged, resent or removed from the window.  Since every send times out
+  // after the same interval, this is the sender's retransmission timer queue: sends expire from the
+  // front, so finding the expired ones costs only as many as there are.
+  std::deque<std::pair<uint32_t, boost::posix_time::ptime>> sent_packets_;
+
+  // The time at which the oldest outstanding send times out, and the tick timer is set to wake the
+  // sender if it has nothing to send before then.
   boost::posix_time::ptime send_timeout_;
 
   uint32_t current_message_number_;
+
+  // The last ack frequency requested from the peer, and the number of that request.  Requests
+  // aren't retransmitted: if one is lost the peer keeps its previous policy until the next is sent.
+  uint32_t ack_frequency_sequence_number_;
+  uint32_t requested_ack_interval_;
+  uint32_t requested_ack_delay_;
 };
 
 }  // namespace detail
@@ -0,0 +1,154 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/sequence_bitmap.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+const uint32_t kHalfSequenceSpace = (SequenceBitmap::kMaxSequenceNumber >> 1) + 1;
+
+uint32_t PopCount(uint64_t word) {
+#ifdef _MSC_VER
+  return static_cast<uint32_t>(__popcnt64(word));
+#else
+  return static_cast<uint32_t>(__builtin_popcountll(word));
+#endif
+}
+
+}  // unnamed namespace
+
+SequenceBitmap::SequenceBitmap()
+    : words_(), mask_(0), first_word_(0), word_count_(0), base_(0), size_(0) {}
+
+bool SequenceBitmap::Contains(uint32_t n) const {
+  uint32_t offset(Offset(n));
+  if (offset >= word_count_ * kWordBits)
+    return false;
+  return (Word(offset / kWordBits) & (uint64_t(1) << (offset % kWordBits))) != 0;
+}
+
+bool SequenceBitmap::Insert(uint32_t n) {
+  assert(n <= kMaxSequenceNumber);
+  uint32_t word_base(n & ~(kWordBits - 1));
+  if (word_count_ == 0) {
+    base_ = word_base;
+    first_word_ = 0;
+  } else if (Offset(n) >= kHalfSequenceSpace) {
+    // n precedes the bitmap, so it has to be extended backwards.
+    size_t extra_words(((base_ - word_base) & kMaxSequenceNumber) / kWordBits);
+    Reserve(word_count_ + extra_words);
+    first_word_ = (first_word_ - extra_words) & mask_;
+    word_count_ += extra_words;
+    base_ = word_base;
+  }
+
+  uint32_t offset(Offset(n));
+  size_t index(offset / kWordBits);
+  if (index >= word_count_) {
+    Reserve(index + 1);
+    word_count_ = index + 1;
+  }
+
+  uint64_t bit(uint64_t(1) << (offset % kWordBits));
+  uint64_t& word(Word(index));
+  if ((word & bit) != 0)
+    return false;
+  word |= bit;
+  ++size_;
+  return true;
+}
+
+void SequenceBitmap::Erase(uint32_t first, uint32_t last) {
+  assert(first <= kMaxSequenceNumber && last <= kMaxSequenceNumber);
+  if (word_count_ == 0)
+    return;
+
+  // Clip the range to the bitmap, treating offsets in the second half of the sequence number space
+  // as preceding base_.
+  uint32_t limit(static_cast<uint32_t>(word_count_ * kWordBits));
+  uint32_t first_offset(Offset(first)), last_offset(Offset(last));
+  bool first_precedes(first_offset >= kHalfSequenceSpace);
+  bool last_precedes(last_offset >= kHalfSequenceSpace);
+  if (last_precedes || (!first_precedes && first_offset > last_offset) ||
+      (!first_precedes && first_offset >= limit)) {
+    return;
+  }
+  ClearBits(first_precedes ? 0 : first_offset, std::min(last_offset, limit - 1));
+
+  if (size_ == 0) {
+    word_count_ = 0;
+    return;
+  }
+  while (Word(0) == 0) {
+    first_word_ = (first_word_ + 1) & mask_;
+    --word_count_;
+    base_ = (base_ + kWordBits) & kMaxSequenceNumber;
+  }
+  while (Word(word_count_ - 1) == 0)
+    --word_count_;
+}
+
+void SequenceBitmap::Clear() {
+  for (size_t i = 0; i != word_count_; ++i)
+    Word(i) = 0;
+  word_count_ = 0;
+  size_ = 0;
+}
+
+void SequenceBitmap::Reserve(size_t word_count) {
+  if (word_count <= words_.size())
+    return;
+  size_t capacity(std::max<size_t>(words_.size(), 4));
+  while (capacity < word_count)
+    capacity *= 2;
+  std::vector<uint64_t> words(capacity, 0);
+  for (size_t i = 0; i != word_count_; ++i)
+    words[i] = Word(i);
+  words_.swap(words);
+  mask_ = capacity - 1;
+  first_word_ = 0;
+}
+
+void SequenceBitmap::ClearBits(uint32_t first, uint32_t last) {
+  size_t first_index(first / kWordBits), last_index(last / kWordBits);
+  for (size_t i = first_index; i <= last_index; ++i) {
+    uint64_t mask(~uint64_t(0));
+    if (i == first_index)
+      mask &= ~uint64_t(0) << (first % kWordBits);
+    if (i == last_index)
+      mask &= ~uint64_t(0) >> (kWordBits - 1 - last % kWordBits);
+    uint64_t& word(Word(i));
+    size_ -= PopCount(word & mask);
+    word &= ~mask;
+  }
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
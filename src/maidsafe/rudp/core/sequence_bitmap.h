@@ -0,0 +1,138 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_SEQUENCE_BITMAP_H_
+#define MAIDSAFE_RUDP_CORE_SEQUENCE_BITMAP_H_
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A set of packet sequence numbers, held as a bitmap anchored at the 64-bit word containing the
+// oldest of them.  Inserting is constant time (other than when the bitmap grows) and runs of
+// consecutive sequence numbers are found a word at a time, so e.g. building an ack costs time in
+// proportion to the number of gaps and words rather than the number of packets.
+//
+// Sequence numbers wrap around after kMaxSequenceNumber, so the set must never span more than half
+// of the sequence number space.
+class SequenceBitmap {
+ public:
+  static const uint32_t kMaxSequenceNumber = 0x7fffffff;
+
+  SequenceBitmap();
+
+  bool IsEmpty() const { return size_ == 0; }
+  size_t Size() const { return size_; }
+
+  bool Contains(uint32_t n) const;
+
+  // Adds n to the set.  Returns false if it was already present.
+  bool Insert(uint32_t n);
+
+  // Removes the sequence numbers from first to last inclusive, which wrap around if last < first.
+  void Erase(uint32_t first, uint32_t last);
+
+  void Clear();
+
+  // Calls f(first, last) for each run of consecutive sequence numbers, oldest first.  A run which
+  // wraps around is reported as a single one with last < first.
+  template <typename Function>
+  void ForEachRange(Function f) const {
+    bool in_run(false);
+    uint32_t run_start(0);
+    for (size_t i = 0; i != word_count_; ++i) {
+      uint64_t word(Word(i));
+      uint32_t offset(static_cast<uint32_t>(i * kWordBits));
+      if (in_run) {
+        if (word == ~uint64_t(0))
+          continue;
+        uint32_t end(CountTrailingZeros(~word));
+        f(SequenceNumber(run_start), SequenceNumber(offset + end - 1));
+        in_run = false;
+        word &= ~uint64_t(0) << end;
+      }
+      while (word != 0) {
+        uint32_t start(CountTrailingZeros(word));
+        uint64_t gaps(~word & (~uint64_t(0) << start));
+        if (gaps == 0) {
+          in_run = true;
+          run_start = offset + start;
+          break;
+        }
+        uint32_t end(CountTrailingZeros(gaps));
+        f(SequenceNumber(offset + start), SequenceNumber(offset + end - 1));
+        word &= ~uint64_t(0) << end;
+      }
+    }
+    if (in_run) {
+      f(SequenceNumber(run_start),
+        SequenceNumber(static_cast<uint32_t>(word_count_ * kWordBits - 1)));
+    }
+  }
+
+ private:
+  static const uint32_t kWordBits = 64;
+
+  static uint32_t CountTrailingZeros(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;  // NOLINT
+    _BitScanForward64(&index, word);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(word));
+#endif
+  }
+
+  // The distance from base_ to n, which is at least kMaxSequenceNumber / 2 if n precedes base_.
+  uint32_t Offset(uint32_t n) const { return (n - base_) & kMaxSequenceNumber; }
+  uint32_t SequenceNumber(uint32_t offset) const { return (base_ + offset) & kMaxSequenceNumber; }
+
+  uint64_t& Word(size_t i) { return words_[(first_word_ + i) & mask_]; }
+  const uint64_t& Word(size_t i) const { return words_[(first_word_ + i) & mask_]; }
+
+  // Ensures there are slots for at least word_count words.
+  void Reserve(size_t word_count);
+
+  // Clears the bits from offset first to last inclusive, both of which must lie in the bitmap.
+  void ClearBits(uint32_t first, uint32_t last);
+
+  // The bitmap is a ring buffer of words, with a power of two number of slots, which are all zero
+  // other than the word_count_ slots in use starting at first_word_.
+  std::vector<uint64_t> words_;
+  size_t mask_, first_word_, word_count_;
+  // The sequence number of the first word's lowest bit.  Always a multiple of kWordBits.
+  uint32_t base_;
+  size_t size_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SEQUENCE_BITMAP_H_
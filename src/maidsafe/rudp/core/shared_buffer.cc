@@ -0,0 +1,111 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/shared_buffer.h"
+
+#include <cassert>
+#include <utility>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+SharedBuffer::SharedBuffer(size_t capacity, std::weak_ptr<SharedBufferPool> pool)
+    : references_(0),
+      capacity_(capacity),
+      allocated_(new unsigned char[capacity]),
+      adopted_(),
+      data_(allocated_.get()),
+      pool_(std::move(pool)) {}
+
+SharedBuffer::SharedBuffer(std::string adopted)
+    : references_(0),
+      capacity_(adopted.size()),
+      allocated_(),
+      adopted_(std::move(adopted)),
+      data_(reinterpret_cast<unsigned char*>(&adopted_[0])),
+      pool_() {}
+
+SharedBufferPtr SharedBuffer::Allocate(size_t capacity) {
+  return SharedBufferPtr(new SharedBuffer(capacity, std::weak_ptr<SharedBufferPool>()));
+}
+
+SharedBufferPtr SharedBuffer::Adopt(std::string data) {
+  return SharedBufferPtr(new SharedBuffer(std::move(data)));
+}
+
+void intrusive_ptr_add_ref(SharedBuffer* buffer) {
+  buffer->references_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void intrusive_ptr_release(SharedBuffer* buffer) {
+  if (buffer->references_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  if (std::shared_ptr<SharedBufferPool> pool = buffer->pool_.lock())
+    pool->Recycle(buffer);
+  else
+    delete buffer;
+}
+
+SharedBufferPool::SharedBufferPool(size_t buffer_size, size_t max_free_buffers)
+    : buffer_size_(buffer_size),
+      max_free_buffers_(max_free_buffers),
+      mutex_(),
+      free_buffers_() {}
+
+std::shared_ptr<SharedBufferPool> SharedBufferPool::Create(size_t buffer_size,
+                                                           size_t max_free_buffers) {
+  return std::shared_ptr<SharedBufferPool>(new SharedBufferPool(buffer_size, max_free_buffers));
+}
+
+SharedBufferPool::~SharedBufferPool() {
+  for (auto buffer : free_buffers_)
+    delete buffer;
+}
+
+SharedBufferPtr SharedBufferPool::Acquire() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_buffers_.empty()) {
+      SharedBuffer* buffer(free_buffers_.back());
+      free_buffers_.pop_back();
+      return SharedBufferPtr(buffer);
+    }
+  }
+  return SharedBufferPtr(new SharedBuffer(buffer_size_, shared_from_this()));
+}
+
+void SharedBufferPool::Recycle(SharedBuffer* buffer) {
+  assert(buffer->references_ == 0);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_buffers_.size() < max_free_buffers_) {
+      free_buffers_.push_back(buffer);
+      return;
+    }
+  }
+  delete buffer;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,120 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_SHARED_BUFFER_H_
+#define MAIDSAFE_RUDP_CORE_SHARED_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "boost/intrusive_ptr.hpp"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+class SharedBuffer;
+class SharedBufferPool;
+
+typedef boost::intrusive_ptr<SharedBuffer> SharedBufferPtr;
+
+// A reference counted block of memory holding packet payloads, e.g. a buffer into which datagrams
+// are received, which data packets decoded from it refer to rather than copying their payload.  The
+// buffer is only returned to its pool (or freed, if it has none) once the last reference to it is
+// released.
+class SharedBuffer {
+ public:
+  // Allocate a buffer which belongs to no pool.
+  static SharedBufferPtr Allocate(size_t capacity);
+  // Take ownership of data rather than copying it, e.g. to send an application's message in data
+  // packets which refer to it.  The buffer belongs to no pool.
+  static SharedBufferPtr Adopt(std::string data);
+
+  unsigned char* Data() { return data_; }
+  const unsigned char* Data() const { return data_; }
+  size_t Capacity() const { return capacity_; }
+
+  // Whether the caller holds the only reference, i.e. whether the buffer may be overwritten.
+  bool IsUnique() const { return references_.load(std::memory_order_acquire) == 1; }
+
+  friend void intrusive_ptr_add_ref(SharedBuffer* buffer);
+  friend void intrusive_ptr_release(SharedBuffer* buffer);
+
+ private:
+  friend class SharedBufferPool;
+
+  SharedBuffer(size_t capacity, std::weak_ptr<SharedBufferPool> pool);
+  explicit SharedBuffer(std::string adopted);
+
+  // Disallow copying and assignment.
+  SharedBuffer(const SharedBuffer&);
+  SharedBuffer& operator=(const SharedBuffer&);
+
+  std::atomic<int> references_;
+  const size_t capacity_;
+  // The memory is held by allocated_, unless the buffer was created by Adopt.
+  std::unique_ptr<unsigned char[]> allocated_;
+  std::string adopted_;
+  unsigned char* const data_;
+  std::weak_ptr<SharedBufferPool> pool_;
+};
+
+// A free list of equally sized buffers.  Released buffers are kept for reuse (up to a limit), so in
+// the steady state e.g. receiving doesn't allocate.  The last reference to a buffer may be released
+// by whichever thread reads its data, so the pool is thread-safe.
+class SharedBufferPool : public std::enable_shared_from_this<SharedBufferPool> {
+ public:
+  // At most max_free_buffers released buffers are kept, the rest are freed.
+  static std::shared_ptr<SharedBufferPool> Create(size_t buffer_size, size_t max_free_buffers);
+  ~SharedBufferPool();
+
+  // Returns a free buffer, allocating a new one if none is available.
+  SharedBufferPtr Acquire();
+
+  size_t BufferSize() const { return buffer_size_; }
+
+  friend void intrusive_ptr_release(SharedBuffer* buffer);
+
+ private:
+  SharedBufferPool(size_t buffer_size, size_t max_free_buffers);
+
+  // Disallow copying and assignment.
+  SharedBufferPool(const SharedBufferPool&);
+  SharedBufferPool& operator=(const SharedBufferPool&);
+
+  // Takes ownership of a buffer whose last reference has been released.
+  void Recycle(SharedBuffer* buffer);
+
+  const size_t buffer_size_, max_free_buffers_;
+  std::mutex mutex_;
+  std::vector<SharedBuffer*> free_buffers_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SHARED_BUFFER_H_
@@ -23,7 +23,8 @@
 
 #include <cstdint>
 #include <cassert>
-#include <deque>
+#include <utility>
+#include <vector>
 
 #include "maidsafe/common/utils.h"
 
@@ -45,22 +46,26 @@ class SlidingWindow {
   static const seq_num_t kMaxSequenceNumber = 0x7fffffff;
 
   // Construct to start with a random sequence number.
-  SlidingWindow() : items_(), maximum_size_(0), begin_(0), end_(0) {
+  SlidingWindow() : items_(kInitialCapacity), mask_(kInitialCapacity - 1), size_(0),
+                    maximum_size_(0), begin_(0), end_(0) {
     Reset(GenerateSequenceNumber());
   }
 
   // Construct to start with a specified sequence number.
   explicit SlidingWindow(seq_num_t initial_sequence_number)
-      : items_(), maximum_size_(0), begin_(0), end_(0) {
+      : items_(kInitialCapacity), mask_(kInitialCapacity - 1), size_(0), maximum_size_(0),
+        begin_(0), end_(0) {
     Reset(initial_sequence_number);
   }
 
-  // Reset to empty starting with the specified sequence number.
+  // Reset to empty starting with the specified sequence number.  The slots allocated so far are
+  // kept for reuse.
   void Reset(seq_num_t initial_sequence_number) {
     assert(initial_sequence_number <= kMaxSequenceNumber);
     maximum_size_ = Parameters::default_window_size;
+    while (size_ != 0)
+      Remove();
     begin_ = end_ = initial_sequence_number;
-    items_.clear();
   }
 
   // Get the sequence number of the first item in window.
@@ -89,29 +94,34 @@ class SlidingWindow {
   }
 
   // Get the current size of the window.
-  size_t Size() const { return items_.size(); }
+  size_t Size() const { return size_; }
 
   // Get whether the window is empty.
-  bool IsEmpty() const { return items_.empty(); }
+  bool IsEmpty() const { return size_ == 0; }
 
   // Get whether the window is full.
-  bool IsFull() const { return items_.size() >= maximum_size_; }
+  bool IsFull() const { return size_ >= maximum_size_; }
 
-  // Add a new item to the end.
+  // Add a new item to the end.  Its slot is reused rather than allocated, and holds the default
+  // value it was given when last removed (or when first allocated).
   // Precondition: !IsFull().
   seq_num_t Append() {
     assert(!IsFull());
-    items_.push_back(T());
+    if (size_ == items_.size())
+      Grow();
     seq_num_t n = end_;
+    ++size_;
     end_ = Next(end_);
     return n;
   }
 
-  // Remove the first item from the window.
+  // Remove the first item from the window.  Its slot is reset to the default value, releasing any
+  // resources the item holds (e.g. a received packet's buffer) and readying it for reuse.
   // Precondition: !IsEmpty().
   void Remove() {
     assert(!IsEmpty());
-    items_.erase(items_.begin());
+    items_[begin_ & mask_] = T();
+    --size_;
     begin_ = Next(begin_);
   }
 
@@ -125,24 +135,30 @@ class SlidingWindow {
 
   // Get the element at the front of the window.
   // Precondition: !IsEmpty().
-  T& Front() { return items_.front(); }
+  T& Front() {
+    assert(!IsEmpty());
+    return items_[begin_ & mask_];
+  }
 
   // Get the element at the front of the window.
   // Precondition: !IsEmpty().
-  const T& Front() const { return items_.front(); }
+  const T& Front() const {
+    assert(!IsEmpty());
+    return items_[begin_ & mask_];
+  }
 
   // Get the element at the back of the window.
   // Precondition: !IsEmpty().
   T& Back() {
     assert(!IsEmpty());
-    return items_.back();
+    return items_[(end_ - 1) & mask_];
   }
 
   // Get the element at the back of the window.
   // Precondition: !IsEmpty().
   const T& Back() const {
     assert(!IsEmpty());
-    return items_.back();
+    return items_[(end_ - 1) & mask_];
   }
 
   // Get the sequence number that follows a given number.
@@ -153,15 +169,24 @@ class SlidingWindow {
   SlidingWindow(const SlidingWindow&);
   SlidingWindow& operator=(const SlidingWindow&);
 
-  // Helper function to convert a sequence number into an index in the window.
+  // The number of slots allocated on construction.  Must be a power of two.
+  static const size_t kInitialCapacity = 16;
+
+  // Helper function to convert a sequence number into an index in items_.  The number of sequence
+  // numbers is a multiple of the (power of two) capacity, so this is unaffected by wraparound.
   size_t SequenceNumberToIndex(seq_num_t n) const {
     assert(Contains(n));
-    if (begin_ <= end_)
-      return n - begin_;
-    else if (n < end_)
-      return kMaxSequenceNumber - begin_ + n + 1;
-    else
-      return n - begin_;
+    return n & mask_;
+  }
+
+  // Double the number of slots, moving each item to its slot in the larger table.
+  void Grow() {
+    std::vector<T> items(items_.size() * 2);
+    size_t mask(items.size() - 1);
+    for (seq_num_t n = begin_; n != end_; n = Next(n))
+      items[n & mask] = std::move(items_[n & mask_]);
+    items_.swap(items);
+    mask_ = mask;
   }
 
   // Helper function to generate an initial sequence number.
@@ -180,8 +205,16 @@ class SlidingWindow {
       return (n < end) || ((n >= begin) && (n <= kMaxSequenceNumber));
   }
 
-  // The items in the window.
-  std::deque<T> items_;
+  // The slots holding the items in the window, indexed by sequence number modulo their number,
+  // which is a power of two.  Grows on demand, up to the first power of two not less than
+  // Parameters::maximum_window_size, and is never shrunk.
+  std::vector<T> items_;
+
+  // items_.size() - 1.
+  size_t mask_;
+
+  // The number of items in the window.
+  size_t size_;
 
   // The maximum number of items allowed in the window.
   size_t maximum_size_;
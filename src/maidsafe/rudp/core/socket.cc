@@ -21,6 +21,7 @@
 #include "maidsafe/rudp/core/socket.h"
 
 #include <algorithm>
+#include <cassert>
 #include <utility>
 #include <limits>
 #include <vector>
@@ -31,6 +32,7 @@
 #include "maidsafe/common/utils.h"
 
 #include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/packets/ack_frequency_packet.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
 #include "maidsafe/rudp/packets/ack_packet.h"
 #include "maidsafe/rudp/packets/data_packet.h"
@@ -62,6 +64,9 @@ Socket::Socket(Multiplexer& multiplexer, NatType& nat_type)  // NOLINT (Fraser)
       waiting_connect_(multiplexer.socket_.get_io_service()),
       waiting_connect_ec_(),
       waiting_write_(multiplexer.socket_.get_io_service()),
+      waiting_write_prefix_(),
+      waiting_write_prefix_size_(0),
+      waiting_write_message_(),
       waiting_write_buffer_(),
       waiting_write_ec_(),
       waiting_write_bytes_transferred_(0),
@@ -178,10 +183,11 @@ void Socket::StartProbe() {
   }
 }
 
-void Socket::StartWrite(const boost::asio::const_buffer& data,
+void Socket::StartWrite(const boost::asio::const_buffer& prefix, const SharedBufferPtr& buffer,
+                        const boost::asio::const_buffer& data,
                         const std::function<void(int)>& message_sent_functor) {  // NOLINT (Fraser)
   // Check for a no-op write.
-  if (boost::asio::buffer_size(data) == 0) {
+  if (boost::asio::buffer_size(prefix) == 0 && boost::asio::buffer_size(data) == 0) {
     waiting_write_ec_.clear();
     waiting_write_.cancel();
     return;
@@ -190,6 +196,10 @@ void Socket::StartWrite(const boost::asio::const_buffer& data,
   // Try processing the write immediately. If there's space in the write buffer then the operation
   // will complete immediately. Otherwise, it will wait until some other event frees up space in the
   // buffer.
+  assert(boost::asio::buffer_size(prefix) <= waiting_write_prefix_.size());
+  waiting_write_prefix_size_ =
+      boost::asio::buffer_copy(boost::asio::buffer(waiting_write_prefix_), prefix);
+  waiting_write_message_ = buffer;
   waiting_write_buffer_ = data;
   waiting_write_bytes_transferred_ = 0;
   ++waiting_write_message_number_;
@@ -198,18 +208,25 @@ void Socket::StartWrite(const boost::asio::const_buffer& data,
 }
 
 void Socket::ProcessWrite() {
-  // There's only a waiting write if the write buffer is non-empty.
-  if (boost::asio::buffer_size(waiting_write_buffer_) == 0)
+  // There's only a waiting write if the prefix or the write buffer is non-empty.
+  if (waiting_write_prefix_size_ == 0 && boost::asio::buffer_size(waiting_write_buffer_) == 0)
     return;
 
-  // Copy whatever data we can into the write buffer.
-  size_t length(sender_.AddData(waiting_write_buffer_, waiting_write_message_number_));
-  waiting_write_buffer_ = waiting_write_buffer_ + length;
+  // Add whatever data we can to the write buffer.  The prefix goes in the first packet, if any.
+  size_t length(sender_.AddData(
+      boost::asio::buffer(waiting_write_prefix_.data(), waiting_write_prefix_size_),
+      waiting_write_message_, waiting_write_buffer_, waiting_write_message_number_));
   waiting_write_bytes_transferred_ += length;
+  if (length != 0) {
+    length -= waiting_write_prefix_size_;
+    waiting_write_prefix_size_ = 0;
+  }
+  waiting_write_buffer_ = waiting_write_buffer_ + length;
   // If we have finished writing all of the data then it's time to trigger the write's completion
   // handler.
-  if (boost::asio::buffer_size(waiting_write_buffer_) == 0) {
+  if (waiting_write_prefix_size_ == 0 && boost::asio::buffer_size(waiting_write_buffer_) == 0) {
     // The write is done. Trigger the write's completion handler.
+    waiting_write_message_.reset();
     waiting_write_ec_.clear();
     waiting_write_.cancel();
   }
@@ -261,42 +278,86 @@ void Socket::ProcessFlush() {
 }
 
 void Socket::HandleReceiveFrom(const boost::asio::const_buffer& data,
-                               const ip::udp::endpoint& endpoint) {
+                               const ip::udp::endpoint& endpoint,
+                               const SharedBufferPtr& buffer) {
   if (endpoint == peer_.PeerEndpoint()) {
-    // TODO(Team): Surely this can be templetised somehow to avoid all the obejct creation
-    DataPacket data_packet;
-    AckPacket ack_packet;
-    AckOfAckPacket ack_of_ack_packet;
-    NegativeAckPacket negative_ack_packet;
-    HandshakePacket handshake_packet;
-    ShutdownPacket shutdown_packet;
-    KeepalivePacket keepalive_packet;
-    if (data_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received DataPacket " << data_packet.PacketSequenceNumber() << ":"
-      //               << data_packet.MessageNumber();
-      HandleData(data_packet);
-    } else if (ack_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received AckPacket";
-      HandleAck(ack_packet);
-    } else if (ack_of_ack_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received AckOfAckPacket";
-      HandleAckOfAck(ack_of_ack_packet);
-    } else if (negative_ack_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received NegativeAckPacket";
-      HandleNegativeAck(negative_ack_packet);
-    } else if (keepalive_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received KeepalivePacket";
-      HandleKeepalive(keepalive_packet);
-    } else if (handshake_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received HandshakePacket InitialPacketSequenceNumber="
-      //               << handshake_packet.InitialPacketSequenceNumber();
-      HandleHandshake(handshake_packet);
-    } else if (shutdown_packet.Decode(data)) {
-      // LOG(kVerbose) << "Received ShutdownPacket";
-      Close();
-    } else {
-      LOG(kWarning) << "Socket " << session_.Id() << " ignoring invalid packet from " << endpoint;
+    // Anything sent in response to this packet (data, acks, acks of acks) goes out as one batch.
+    ScopedTransmitBatch batch(peer_);
+    // Only the packet object for the type named in the header is built and decoded.
+    uint16_t packet_type(0);
+    if (Packet::DecodeType(&packet_type, data)) {
+      switch (packet_type) {
+        case Packet::kDataPacketType: {
+          DataPacket data_packet;
+          if (data_packet.Decode(data, buffer)) {
+            // LOG(kVerbose) << "Received DataPacket " << data_packet.PacketSequenceNumber() << ":"
+            //               << data_packet.MessageNumber();
+            return HandleData(data_packet);
+          }
+          break;
+        }
+        case AckPacket::kPacketType: {
+          AckPacket ack_packet;
+          if (ack_packet.Decode(data)) {
+            // LOG(kVerbose) << "Received AckPacket";
+            return HandleAck(ack_packet);
+          }
+          break;
+        }
+        case AckOfAckPacket::kPacketType: {
+          AckOfAckPacket ack_of_ack_packet;
+          if (ack_of_ack_packet.Decode(data)) {
+            // LOG(kVerbose) << "Received AckOfAckPacket";
+            return HandleAckOfAck(ack_of_ack_packet);
+          }
+          break;
+        }
+        case NegativeAckPacket::kPacketType: {
+          NegativeAckPacket negative_ack_packet;
+          if (negative_ack_packet.Decode(data)) {
+            // LOG(kVerbose) << "Received NegativeAckPacket";
+            return HandleNegativeAck(negative_ack_packet);
+          }
+          break;
+        }
+        case AckFrequencyPacket::kPacketType: {
+          AckFrequencyPacket ack_frequency_packet;
+          if (ack_frequency_packet.Decode(data)) {
+            // LOG(kVerbose) << "Received AckFrequencyPacket";
+            return HandleAckFrequency(ack_frequency_packet);
+          }
+          break;
+        }
+        case KeepalivePacket::kPacketType: {
+          KeepalivePacket keepalive_packet;
+          if (keepalive_packet.Decode(data)) {
+            // LOG(kVerbose) << "Received KeepalivePacket";
+            return HandleKeepalive(keepalive_packet);
+          }
+          break;
+        }
+        case HandshakePacket::kPacketType: {
+          HandshakePacket handshake_packet;
+          if (handshake_packet.Decode(data)) {
+            // LOG(kVerbose) << "Received HandshakePacket InitialPacketSequenceNumber="
+            //               << handshake_packet.InitialPacketSequenceNumber();
+            return HandleHandshake(handshake_packet);
+          }
+          break;
+        }
+        case ShutdownPacket::kPacketType: {
+          ShutdownPacket shutdown_packet;
+          if (shutdown_packet.Decode(data)) {
+            // LOG(kVerbose) << "Received ShutdownPacket";
+            return Close();
+          }
+          break;
+        }
+        default:
+          break;
+      }
     }
+    LOG(kWarning) << "Socket " << session_.Id() << " ignoring invalid packet from " << endpoint;
   } else {
     LOG(kWarning) << "Socket " << session_.Id() << " ignoring spurious packet from " << endpoint;
   }
@@ -390,7 +451,14 @@ void Socket::HandleNegativeAck(const NegativeAckPacket& packet) {
   }
 }
 
+void Socket::HandleAckFrequency(const AckFrequencyPacket& packet) {
+  if (session_.IsConnected()) {
+    receiver_.HandleAckFrequency(packet);
+  }
+}
+
 void Socket::HandleTick() {
+  ScopedTransmitBatch batch(peer_);
   session_.HandleTick();
   if (session_.IsConnected()) {
     sender_.HandleTick();
@@ -21,6 +21,7 @@
 #ifndef MAIDSAFE_RUDP_CORE_SOCKET_H_
 #define MAIDSAFE_RUDP_CORE_SOCKET_H_
 
+#include <array>
 #include <cstdint>
 #include <deque>
 #include <functional>
@@ -41,6 +42,7 @@
 #include "maidsafe/rudp/core/receiver.h"
 #include "maidsafe/rudp/core/sender.h"
 #include "maidsafe/rudp/core/session.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
 #include "maidsafe/rudp/core/tick_timer.h"
 
 #include "maidsafe/rudp/operations/connect_op.h"
@@ -49,6 +51,7 @@
 #include "maidsafe/rudp/operations/read_op.h"
 #include "maidsafe/rudp/operations/tick_op.h"
 #include "maidsafe/rudp/operations/write_op.h"
+#include "maidsafe/rudp/packets/data_packet.h"
 
 #include "maidsafe/rudp/nat_type.h"
 #include "maidsafe/rudp/parameters.h"
@@ -59,6 +62,7 @@ namespace rudp {
 
 namespace detail {
 
+class AckFrequencyPacket;
 class AckPacket;
 class AckOfAckPacket;
 class DataPacket;
@@ -115,6 +119,13 @@ class Socket {
   // Calculate if the transmission speed is too slow
   bool IsSlowTransmission(size_t length) { return congestion_control_.IsSlowTransmission(length); }
 
+  // Set whether this socket reports missing packets to the peer in negative acks, rather than
+  // leaving the peer to resend them on timeout.  Defaults to Parameters::loss_recovery_mode, and
+  // should only be changed before connecting.
+  void SetLossRecoveryMode(Parameters::LossRecoveryMode mode) {
+    receiver_.SetLossRecoveryMode(mode);
+  }
+
   // Asynchronously process one "tick". The internal tick size varies based on
   // the next time-based event that is of interest to the socket.
   template <typename TickHandler>
@@ -146,14 +157,36 @@ class Socket {
   // generally complete immediately unless congestion has caused the internal
   // buffer for unprocessed send data to fill up. when the operation completes, the handler is
   // invoked, but the message_sent_functor is not invoked until the last packet of the message has
-  // been acknowledged by the peer.
+  // been acknowledged by the peer.  data must lie within buffer; the packets carrying it refer to
+  // buffer rather than copying it, so it's kept alive until the last of them has been acknowledged.
+  // data is preceded by prefix, of at most DataPacket::kMaxPrefixSize bytes, which is copied.
   template <typename WriteHandler>
-  void AsyncWrite(const boost::asio::const_buffer& data,
+  void AsyncWrite(const boost::asio::const_buffer& prefix, const SharedBufferPtr& buffer,
+                  const boost::asio::const_buffer& data,
                   const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
                   WriteHandler handler) {
     WriteOp<WriteHandler> op(handler, waiting_write_ec_, waiting_write_bytes_transferred_);
     waiting_write_.async_wait(op);
-    StartWrite(data, message_sent_functor);
+    StartWrite(prefix, buffer, data, message_sent_functor);
+  }
+
+  // As above, without a prefix.
+  template <typename WriteHandler>
+  void AsyncWrite(const SharedBufferPtr& buffer, const boost::asio::const_buffer& data,
+                  const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                  WriteHandler handler) {
+    AsyncWrite(boost::asio::const_buffer(), buffer, data, message_sent_functor, handler);
+  }
+
+  // As above, but copies data into a new shared buffer first.
+  template <typename WriteHandler>
+  void AsyncWrite(const boost::asio::const_buffer& data,
+                  const std::function<void(int)>& message_sent_functor,  // NOLINT (Fraser)
+                  WriteHandler handler) {
+    size_t size(boost::asio::buffer_size(data));
+    SharedBufferPtr buffer(SharedBuffer::Allocate(size));
+    boost::asio::buffer_copy(boost::asio::buffer(buffer->Data(), size), data);
+    AsyncWrite(buffer, boost::asio::buffer(buffer->Data(), size), message_sent_functor, handler);
   }
 
   // Initiate an asynchronous operation to read data.
@@ -209,7 +242,8 @@ class Socket {
                         uint32_t cookie_syn,
                         const Session::OnNatDetectionRequested::slot_type&);
 
-  void StartWrite(const boost::asio::const_buffer& data,
+  void StartWrite(const boost::asio::const_buffer& prefix, const SharedBufferPtr& buffer,
+                  const boost::asio::const_buffer& data,
                   const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
   void ProcessWrite();
   void StartRead(const boost::asio::mutable_buffer& data, size_t transfer_at_least);
@@ -219,9 +253,10 @@ class Socket {
 
   void StartProbe();
 
-  // Called by the Dispatcher when a new packet arrives for the socket.
+  // Called by the Dispatcher when a new packet arrives for the socket.  Data packets keep a
+  // reference to buffer, within which data lies, rather than copying their payload.
   void HandleReceiveFrom(const boost::asio::const_buffer& data,
-                         const Endpoint& endpoint);
+                         const Endpoint& endpoint, const SharedBufferPtr& buffer);
 
   // Called to process a newly received handshake packet.
   void HandleHandshake(const HandshakePacket& packet);
@@ -238,6 +273,9 @@ class Socket {
   // Called to process a newly received negative acknowledgement packet.
   void HandleNegativeAck(const NegativeAckPacket& packet);
 
+  // Called to process a newly received request for an acknowledgement frequency.
+  void HandleAckFrequency(const AckFrequencyPacket& packet);
+
   // Called to process a newly received Keepalive packet.
   void HandleKeepalive(const KeepalivePacket& packet);
 
@@ -278,6 +316,9 @@ class Socket {
   // time. The following data members store the pending write, and the result
   // that is intended for its completion handler.
   boost::asio::deadline_timer waiting_write_;
+  std::array<unsigned char, DataPacket::kMaxPrefixSize> waiting_write_prefix_;
+  size_t waiting_write_prefix_size_;
+  SharedBufferPtr waiting_write_message_;
   boost::asio::const_buffer waiting_write_buffer_;
   boost::system::error_code waiting_write_ec_;
   size_t waiting_write_bytes_transferred_;
@@ -0,0 +1,183 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/socket_index.h"
+
+#include <cassert>
+
+#include "maidsafe/rudp/core/socket.h"
+
+namespace ip = boost::asio::ip;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+// The number of bits of an encoded id holding the slot, and hence the most sockets a table holds.
+const uint32_t kSlotBits = 18;
+const uint32_t kMaxSlots = 1U << kSlotBits;
+
+// Remove the entry mapping key to id from a multimap index.
+template <typename Index>
+void EraseFromIndex(Index& index, const typename Index::key_type& key, uint32_t id) {
+  auto range(index.equal_range(key));
+  for (auto itr(range.first); itr != range.second; ++itr) {
+    if (itr->second == id) {
+      index.erase(itr);
+      return;
+    }
+  }
+}
+
+}  // unnamed namespace
+
+SocketIndex::SocketIndex(uint32_t secret)
+    : secret_(secret),
+      shard_(0),
+      shard_count_(1),
+      generation_mask_(0),
+      encoding_mask_(0),
+      slots_(),
+      free_slots_(),
+      size_(0),
+      by_endpoint_(),
+      by_address_() {
+  SetShard(0, 1);
+}
+
+void SocketIndex::SetShard(uint32_t shard, uint32_t shard_count) {
+  assert(size_ == 0 && shard < shard_count);
+  shard_ = shard;
+  shard_count_ = shard_count;
+  // Use as many bits as remain once the id is multiplied up by the shard count.
+  uint32_t bits(32);
+  while ((uint64_t(1) << bits) * shard_count > (uint64_t(1) << 32))
+    --bits;
+  assert(bits > kSlotBits);
+  encoding_mask_ = static_cast<uint32_t>((uint64_t(1) << bits) - 1);
+  generation_mask_ = encoding_mask_ >> kSlotBits;
+}
+
+uint32_t SocketIndex::Add(Socket* socket, const ip::udp::endpoint& peer_endpoint) {
+  uint32_t slot(0);
+  if (!free_slots_.empty()) {
+    slot = free_slots_.front();
+    free_slots_.pop_front();
+  } else if (slots_.size() < kMaxSlots) {
+    slot = static_cast<uint32_t>(slots_.size());
+    slots_.push_back(Slot());
+  } else {
+    return 0;
+  }
+
+  Slot& entry(slots_[slot]);
+  uint32_t id(Encode(slot, entry.generation));
+  if (id == 0) {  // Reserved for handshakes on new sockets.
+    entry.generation = (entry.generation + 1) & generation_mask_;
+    id = Encode(slot, entry.generation);
+  }
+  entry.socket = socket;
+  entry.peer_endpoint = peer_endpoint;
+  ++size_;
+  Index(id, peer_endpoint);
+  return id;
+}
+
+void SocketIndex::Remove(uint32_t id) {
+  Slot* entry(Decode(id));
+  if (!entry)
+    return;
+  Unindex(id, entry->peer_endpoint);
+  entry->socket = nullptr;
+  entry->generation = (entry->generation + 1) & generation_mask_;
+  free_slots_.push_back(static_cast<uint32_t>(entry - slots_.data()));
+  --size_;
+}
+
+void SocketIndex::UpdatePeerEndpoint(uint32_t id, const ip::udp::endpoint& peer_endpoint) {
+  Slot* entry(Decode(id));
+  if (!entry || entry->peer_endpoint == peer_endpoint)
+    return;
+  Unindex(id, entry->peer_endpoint);
+  entry->peer_endpoint = peer_endpoint;
+  Index(id, peer_endpoint);
+}
+
+Socket* SocketIndex::Find(uint32_t id) const {
+  const Slot* entry(Decode(id));
+  return entry ? entry->socket : nullptr;
+}
+
+uint32_t SocketIndex::FindByEndpoint(const ip::udp::endpoint& peer_endpoint,
+                                     bool unconnected_only) const {
+  auto range(by_endpoint_.equal_range(peer_endpoint));
+  for (auto itr(range.first); itr != range.second; ++itr) {
+    if (!unconnected_only || !Find(itr->second)->IsConnected())
+      return itr->second;
+  }
+  return 0;
+}
+
+uint32_t SocketIndex::FindUnconnectedByAddress(const ip::address& address) const {
+  auto range(by_address_.equal_range(address));
+  for (auto itr(range.first); itr != range.second; ++itr) {
+    if (!Find(itr->second)->IsConnected())
+      return itr->second;
+  }
+  return 0;
+}
+
+uint32_t SocketIndex::Encode(uint32_t slot, uint32_t generation) const {
+  uint32_t encoding(((generation << kSlotBits) | slot) ^ (secret_ & encoding_mask_));
+  return encoding * shard_count_ + shard_;
+}
+
+const SocketIndex::Slot* SocketIndex::Decode(uint32_t id) const {
+  if (id % shard_count_ != shard_)
+    return nullptr;
+  uint32_t encoding((id / shard_count_) ^ (secret_ & encoding_mask_));
+  uint32_t slot(encoding & (kMaxSlots - 1));
+  if (slot >= slots_.size())
+    return nullptr;
+  const Slot& entry(slots_[slot]);
+  return entry.socket && entry.generation == (encoding >> kSlotBits) ? &entry : nullptr;
+}
+
+SocketIndex::Slot* SocketIndex::Decode(uint32_t id) {
+  return const_cast<Slot*>(static_cast<const SocketIndex&>(*this).Decode(id));
+}
+
+void SocketIndex::Index(uint32_t id, const ip::udp::endpoint& peer_endpoint) {
+  by_endpoint_.insert(std::make_pair(peer_endpoint, id));
+  by_address_.insert(std::make_pair(peer_endpoint.address(), id));
+}
+
+void SocketIndex::Unindex(uint32_t id, const ip::udp::endpoint& peer_endpoint) {
+  EraseFromIndex(by_endpoint_, peer_endpoint, id);
+  EraseFromIndex(by_address_, peer_endpoint.address(), id);
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,126 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_SOCKET_INDEX_H_
+#define MAIDSAFE_RUDP_CORE_SOCKET_INDEX_H_
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/asio/ip/address.hpp"
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/rudp/utils.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+class Socket;
+
+// A table of sockets, which allocates their ids, and additionally indexes them by the endpoint (and
+// address) of the peer each is connecting to.
+//
+// Sockets are held in a flat array of slots, and each id encodes a socket's slot together with the
+// slot's generation, which advances whenever a socket leaves it.  Finding the destination of a
+// packet is then an array access, and packets for a closed socket are rejected even once its slot
+// has been reused.  Freed slots are reused oldest first, so generations wrap as slowly as possible.
+// The encoding is masked with a secret, so that ids aren't trivially predictable by peers.  Ids are
+// all congruent to the table's shard modulo the number of shards (see SetShard), since packets are
+// steered to shards by their destination id.
+//
+// Handshakes from new peers carry no destination socket id, so they are routed by their sender's
+// endpoint, which the indexes resolve without scanning every socket.  A socket's connected state
+// isn't tracked, but checked on the few sockets sharing an endpoint or address.
+//
+// Not thread-safe; the owner must serialise access.
+class SocketIndex {
+ public:
+  explicit SocketIndex(uint32_t secret);
+
+  // Set the shard owning this table and the total number of shards.  Must be called before any
+  // sockets are added; by default the table is the only shard.
+  void SetShard(uint32_t shard, uint32_t shard_count);
+
+  size_t Size() const { return size_; }
+  bool Contains(uint32_t id) const { return Find(id) != nullptr; }
+
+  // Add a socket, indexed by the endpoint of its peer.  Returns its new id, or 0 if the table is
+  // full.
+  uint32_t Add(Socket* socket, const boost::asio::ip::udp::endpoint& peer_endpoint);
+  void Remove(uint32_t id);
+  // Re-index a socket whose peer has turned out to be using a different endpoint.
+  void UpdatePeerEndpoint(uint32_t id, const boost::asio::ip::udp::endpoint& peer_endpoint);
+
+  // Returns the socket with the given id, or nullptr.
+  Socket* Find(uint32_t id) const;
+  // Returns the id of a socket whose peer is at peer_endpoint, considering only those not yet
+  // connected if unconnected_only is true, or 0 if there is none.
+  uint32_t FindByEndpoint(const boost::asio::ip::udp::endpoint& peer_endpoint,
+                          bool unconnected_only) const;
+  // Returns the id of a socket not yet connected whose peer is at address, or 0 if there is none.
+  uint32_t FindUnconnectedByAddress(const boost::asio::ip::address& address) const;
+
+ private:
+  // Disallow copying and assignment.
+  SocketIndex(const SocketIndex&);
+  SocketIndex& operator=(const SocketIndex&);
+
+  struct Slot {
+    Slot() : socket(nullptr), peer_endpoint(), generation(0) {}
+    // Null while the slot is free.
+    Socket* socket;
+    // The endpoint the socket is indexed by.
+    boost::asio::ip::udp::endpoint peer_endpoint;
+    uint32_t generation;
+  };
+
+  typedef std::unordered_multimap<boost::asio::ip::udp::endpoint, uint32_t, EndpointHash>
+      EndpointIndex;
+  typedef std::unordered_multimap<boost::asio::ip::address, uint32_t, AddressHash> AddressIndex;
+
+  uint32_t Encode(uint32_t slot, uint32_t generation) const;
+  // Returns the slot holding the socket with the given id, or nullptr.
+  const Slot* Decode(uint32_t id) const;
+  Slot* Decode(uint32_t id);
+
+  void Index(uint32_t id, const boost::asio::ip::udp::endpoint& peer_endpoint);
+  void Unindex(uint32_t id, const boost::asio::ip::udp::endpoint& peer_endpoint);
+
+  const uint32_t secret_;
+  uint32_t shard_, shard_count_;
+  // Masks of the bits holding the encoded slot and generation, and of the whole encoding.
+  uint32_t generation_mask_, encoding_mask_;
+  std::vector<Slot> slots_;
+  std::deque<uint32_t> free_slots_;
+  size_t size_;
+  EndpointIndex by_endpoint_;
+  AddressIndex by_address_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_SOCKET_INDEX_H_
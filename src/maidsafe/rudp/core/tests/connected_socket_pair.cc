@@ -0,0 +1,146 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/tests/connected_socket_pair.h"
+
+#include <functional>
+
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/rudp/return_codes.h"
+#include "maidsafe/rudp/transport.h"
+#include "maidsafe/rudp/utils.h"
+
+namespace ip = boost::asio::ip;
+namespace bs = boost::system;
+namespace args = std::placeholders;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+void DispatchHandler(const bs::error_code& ec, std::shared_ptr<Multiplexer> multiplexer) {
+  if (!ec)
+    multiplexer->AsyncDispatch(std::bind(&DispatchHandler, args::_1, multiplexer));
+}
+
+void TickHandler(const bs::error_code& ec, Socket* socket) {
+  if (!ec)
+    socket->AsyncTick(std::bind(&TickHandler, args::_1, socket));
+}
+
+void StoreError(const bs::error_code& ec, bs::error_code* out_ec) { *out_ec = ec; }
+
+}  // unnamed namespace
+
+void RunUntilComplete(boost::asio::io_service& io_service, const bs::error_code& server_ec,
+                      const bs::error_code& client_ec) {
+  do {
+    io_service.run_one();
+  } while (server_ec == boost::asio::error::would_block ||
+           client_ec == boost::asio::error::would_block);
+}
+
+ConnectedSocketPair::ConnectedSocketPair(boost::asio::io_service& io_service)
+    : io_service_(io_service),
+      server_node_id_(RandomString(NodeId::kSize)),
+      client_node_id_(RandomString(NodeId::kSize)),
+      server_public_key_(std::make_shared<asymm::PublicKey>(asymm::GenerateKeyPair().public_key)),
+      client_public_key_(std::make_shared<asymm::PublicKey>(asymm::GenerateKeyPair().public_key)),
+      server_multiplexer_(std::make_shared<Multiplexer>(io_service)),
+      client_multiplexer_(std::make_shared<Multiplexer>(io_service)),
+      server_connection_manager_(std::shared_ptr<Transport>(),
+                                 boost::asio::io_service::strand(io_service), server_multiplexer_,
+                                 server_node_id_, std::shared_ptr<asymm::PublicKey>()),
+      client_connection_manager_(std::shared_ptr<Transport>(),
+                                 boost::asio::io_service::strand(io_service), client_multiplexer_,
+                                 client_node_id_, std::shared_ptr<asymm::PublicKey>()),
+      server_nat_type_(NatType::kUnknown),
+      client_nat_type_(NatType::kUnknown),
+      server_socket_(*server_multiplexer_, server_nat_type_),
+      client_socket_(*client_multiplexer_, client_nat_type_) {}
+
+ConnectedSocketPair::~ConnectedSocketPair() {
+  server_multiplexer_->Close();
+  client_multiplexer_->Close();
+}
+
+testing::AssertionResult ConnectedSocketPair::Connect() {
+  using Endpoint = ip::udp::endpoint;
+  if (server_multiplexer_->Open(Endpoint(AsioToBoostAsio(GetLocalIp()), 0)) != kSuccess)
+    return testing::AssertionFailure() << "Failed to open the server multiplexer";
+  if (client_multiplexer_->Open(Endpoint(AsioToBoostAsio(GetLocalIp()), 0)) != kSuccess)
+    return testing::AssertionFailure() << "Failed to open the client multiplexer";
+  server_multiplexer_->AsyncDispatch(std::bind(&DispatchHandler, args::_1, server_multiplexer_));
+  client_multiplexer_->AsyncDispatch(std::bind(&DispatchHandler, args::_1, client_multiplexer_));
+
+  auto on_nat_detection_requested_slot([](
+      const Endpoint & /*this_local_endpoint*/, const NodeId & /*peer_id*/,
+      const Endpoint & /*peer_endpoint*/,
+      uint16_t & /*another_external_port*/) {});
+  bs::error_code server_ec(boost::asio::error::would_block);
+  bs::error_code client_ec(boost::asio::error::would_block);
+  client_socket_.AsyncConnect(client_node_id_, client_public_key_,
+                              server_multiplexer_->local_endpoint(), server_node_id_,
+                              std::bind(&StoreError, args::_1, &client_ec), Session::kNormal, 0,
+                              on_nat_detection_requested_slot);
+  server_socket_.AsyncConnect(server_node_id_, server_public_key_,
+                              client_multiplexer_->local_endpoint(), client_node_id_,
+                              std::bind(&StoreError, args::_1, &server_ec), Session::kNormal, 0,
+                              on_nat_detection_requested_slot);
+  RunUntilComplete(io_service_, server_ec, client_ec);
+  if (server_ec || !server_socket_.IsOpen())
+    return testing::AssertionFailure() << "Server socket failed to connect: "
+                                       << server_ec.message();
+  if (client_ec || !client_socket_.IsOpen())
+    return testing::AssertionFailure() << "Client socket failed to connect: "
+                                       << client_ec.message();
+  return testing::AssertionSuccess();
+}
+
+void ConnectedSocketPair::StartTicking() {
+  server_socket_.AsyncTick(std::bind(&TickHandler, args::_1, &server_socket_));
+  client_socket_.AsyncTick(std::bind(&TickHandler, args::_1, &client_socket_));
+}
+
+testing::AssertionResult ConnectedSocketPair::Flush() {
+  bs::error_code server_ec(boost::asio::error::would_block);
+  bs::error_code client_ec(boost::asio::error::would_block);
+  server_socket_.AsyncFlush(std::bind(&StoreError, args::_1, &server_ec));
+  client_socket_.AsyncFlush(std::bind(&StoreError, args::_1, &client_ec));
+  RunUntilComplete(io_service_, server_ec, client_ec);
+  if (server_ec)
+    return testing::AssertionFailure() << "Server socket failed to flush: " << server_ec.message();
+  if (client_ec)
+    return testing::AssertionFailure() << "Client socket failed to flush: " << client_ec.message();
+  return testing::AssertionSuccess();
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,89 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_TESTS_CONNECTED_SOCKET_PAIR_H_
+#define MAIDSAFE_RUDP_CORE_TESTS_CONNECTED_SOCKET_PAIR_H_
+
+#include <memory>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "maidsafe/common/node_id.h"
+#include "maidsafe/common/rsa.h"
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/connection_manager.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/socket.h"
+#include "maidsafe/rudp/nat_type.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+// Runs io_service one handler at a time until neither error code is still would_block.
+void RunUntilComplete(boost::asio::io_service& io_service,
+                      const boost::system::error_code& server_ec,
+                      const boost::system::error_code& client_ec);
+
+// Two sockets, each on its own multiplexer bound to the local address, connected to each other.
+class ConnectedSocketPair {
+ public:
+  explicit ConnectedSocketPair(boost::asio::io_service& io_service);
+  ~ConnectedSocketPair();
+
+  // Opens both multiplexers and performs the handshake between the two sockets.
+  testing::AssertionResult Connect();
+  // Keeps both sockets ticking until they're closed.
+  void StartTicking();
+  // Flushes both sockets' outstanding sends.
+  testing::AssertionResult Flush();
+
+  Multiplexer& server_multiplexer() { return *server_multiplexer_; }
+  Multiplexer& client_multiplexer() { return *client_multiplexer_; }
+  Socket& server_socket() { return server_socket_; }
+  Socket& client_socket() { return client_socket_; }
+
+ private:
+  // Disallow copying and assignment.
+  ConnectedSocketPair(const ConnectedSocketPair&);
+  ConnectedSocketPair& operator=(const ConnectedSocketPair&);
+
+  boost::asio::io_service& io_service_;
+  NodeId server_node_id_, client_node_id_;
+  std::shared_ptr<asymm::PublicKey> server_public_key_, client_public_key_;
+  std::shared_ptr<Multiplexer> server_multiplexer_, client_multiplexer_;
+  ConnectionManager server_connection_manager_, client_connection_manager_;
+  NatType server_nat_type_, client_nat_type_;
+  Socket server_socket_, client_socket_;
+};
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_TESTS_CONNECTED_SOCKET_PAIR_H_
@@ -0,0 +1,311 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "boost/asio/error.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/fabric_backend.h"
+#include "maidsafe/rudp/return_codes.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+// The number of datagrams a port queues (kQueueCapacity in fabric_backend.cc).
+const size_t kQueueCapacity(512);
+
+// The fabric is shared by the whole process, so each test binds addresses of its own.
+ip::udp::endpoint Endpoint(const std::string& address, uint16_t port) {
+  return ip::udp::endpoint(ip::address::from_string(address), port);
+}
+
+typedef std::vector<std::pair<ip::udp::endpoint, uint32_t>> Datagrams;
+
+class FabricBackendTest : public testing::Test {
+ protected:
+  FabricBackendTest() : io_service_(), socket_(io_service_) {}
+
+  std::unique_ptr<FabricBackend> Bind(const ip::udp::endpoint& endpoint) {
+    std::unique_ptr<FabricBackend> backend(new FabricBackend(socket_));
+    EXPECT_EQ(kSuccess, backend->Bind(endpoint));
+    return backend;
+  }
+
+  static void Send(FabricBackend& backend, const ip::udp::endpoint& endpoint, uint32_t value) {
+    std::vector<asio::mutable_buffer> buffers(1, asio::buffer(&value, sizeof(value)));
+    bs::error_code ec;
+    backend.SendTo(buffers, endpoint, ec);
+    EXPECT_FALSE(ec);
+  }
+
+  // Receive until the port's queue is empty, appending each datagram's sender and value.
+  static void ReceiveAll(FabricBackend& backend, Datagrams& datagrams) {
+    bs::error_code ec;
+    do {
+      backend.Receive([&datagrams](const asio::const_buffer& data,
+                                   const ip::udp::endpoint& sender, const SharedBufferPtr&) {
+                        EXPECT_EQ(sizeof(uint32_t), asio::buffer_size(data));
+                        uint32_t value(0);
+                        std::memcpy(&value, asio::buffer_cast<const void*>(data), sizeof(value));
+                        datagrams.push_back(std::make_pair(sender, value));
+                      }, ec);
+    } while (!ec);
+    EXPECT_EQ(asio::error::would_block, ec);
+  }
+
+  asio::io_service io_service_;
+  ip::udp::socket socket_;
+};
+
+TEST_F(FabricBackendTest, BEH_DeliveryOrder) {
+  const ip::udp::endpoint kSender(Endpoint("10.0.1.1", 1000));
+  const ip::udp::endpoint kReceiver(Endpoint("10.0.1.2", 1000));
+  std::unique_ptr<FabricBackend> sender(Bind(kSender)), receiver(Bind(kReceiver));
+  EXPECT_FALSE(sender->UsesSocket());
+  EXPECT_TRUE(receiver->IsOpen());
+
+  // The wait only completes once something has been queued.
+  bool waited(false);
+  bs::error_code wait_ec(asio::error::timed_out);
+  receiver->AsyncWait([&](const bs::error_code& ec) {
+    waited = true;
+    wait_ec = ec;
+  });
+  io_service_.poll();
+  EXPECT_FALSE(waited);
+
+  // More than a single Receive passes on.
+  const uint32_t kCount(200);
+  for (uint32_t i(0); i < kCount; ++i)
+    Send(*sender, kReceiver, i);
+  io_service_.reset();
+  io_service_.poll();
+  EXPECT_TRUE(waited);
+  EXPECT_FALSE(wait_ec);
+
+  Datagrams datagrams;
+  ReceiveAll(*receiver, datagrams);
+  ASSERT_EQ(kCount, datagrams.size());
+  for (uint32_t i(0); i < kCount; ++i) {
+    EXPECT_EQ(kSender, datagrams[i].first);
+    EXPECT_EQ(i, datagrams[i].second);
+  }
+
+  // Datagrams to an unbound endpoint vanish, as they would with UDP.
+  Send(*sender, Endpoint("10.0.1.3", 1000), kCount);
+  ReceiveAll(*receiver, datagrams);
+  EXPECT_EQ(kCount, datagrams.size());
+}
+
+TEST_F(FabricBackendTest, BEH_FullQueueDrops) {
+  const ip::udp::endpoint kSender(Endpoint("10.0.2.1", 1000));
+  const ip::udp::endpoint kReceiver(Endpoint("10.0.2.2", 1000));
+  std::unique_ptr<FabricBackend> sender(Bind(kSender)), receiver(Bind(kReceiver));
+
+  const uint32_t kCount(kQueueCapacity + 100);
+  for (uint32_t i(0); i < kCount; ++i)
+    Send(*sender, kReceiver, i);
+
+  // Those which didn't fit are dropped, and the rest are intact.
+  Datagrams datagrams;
+  ReceiveAll(*receiver, datagrams);
+  ASSERT_EQ(kQueueCapacity, datagrams.size());
+  for (uint32_t i(0); i < kQueueCapacity; ++i)
+    EXPECT_EQ(i, datagrams[i].second);
+
+  // Once drained, the queue accepts datagrams again.
+  Send(*sender, kReceiver, kCount);
+  datagrams.clear();
+  ReceiveAll(*receiver, datagrams);
+  ASSERT_EQ(1U, datagrams.size());
+  EXPECT_EQ(kCount, datagrams[0].second);
+}
+
+TEST_F(FabricBackendTest, BEH_CloseAbortsWait) {
+  const ip::udp::endpoint kSender(Endpoint("10.0.3.1", 1000));
+  const ip::udp::endpoint kReceiver(Endpoint("10.0.3.2", 1000));
+  std::unique_ptr<FabricBackend> sender(Bind(kSender)), receiver(Bind(kReceiver));
+
+  int wait_count(0);
+  bs::error_code wait_ec;
+  auto handler([&](const bs::error_code& ec) {
+    ++wait_count;
+    wait_ec = ec;
+  });
+  receiver->AsyncWait(handler);
+  io_service_.poll();
+  EXPECT_EQ(0, wait_count);
+
+  receiver->Close();
+  io_service_.reset();
+  io_service_.poll();
+  EXPECT_EQ(1, wait_count);
+  EXPECT_EQ(asio::error::operation_aborted, wait_ec);
+  EXPECT_FALSE(receiver->IsOpen());
+
+  // A closed port can't be waited on, received from or sent from, and is no longer routed to.
+  receiver->AsyncWait(handler);
+  io_service_.reset();
+  io_service_.poll();
+  EXPECT_EQ(2, wait_count);
+  EXPECT_EQ(asio::error::operation_aborted, wait_ec);
+  bs::error_code ec;
+  receiver->Receive([](const asio::const_buffer&, const ip::udp::endpoint&,
+                       const SharedBufferPtr&) { ADD_FAILURE() << "Received after closing."; }, ec);
+  EXPECT_EQ(asio::error::bad_descriptor, ec);
+  uint32_t value(0);
+  std::vector<asio::mutable_buffer> buffers(1, asio::buffer(&value, sizeof(value)));
+  receiver->SendTo(buffers, kSender, ec);
+  EXPECT_EQ(asio::error::bad_descriptor, ec);
+  Send(*sender, kReceiver, value);
+
+  // Its endpoint is free to bind again.
+  std::unique_ptr<FabricBackend> rebound(Bind(kReceiver));
+  Send(*sender, kReceiver, value);
+  Datagrams datagrams;
+  ReceiveAll(*rebound, datagrams);
+  EXPECT_EQ(1U, datagrams.size());
+}
+
+TEST_F(FabricBackendTest, BEH_DynamicPorts) {
+  const ip::udp::endpoint kAny(Endpoint("10.0.4.1", 0));
+  std::unique_ptr<FabricBackend> first(Bind(kAny)), second(Bind(kAny));
+  bs::error_code ec;
+  ip::udp::endpoint first_endpoint(first->LocalEndpoint(ec));
+  EXPECT_FALSE(ec);
+  ip::udp::endpoint second_endpoint(second->LocalEndpoint(ec));
+  EXPECT_FALSE(ec);
+  EXPECT_EQ(kAny.address(), first_endpoint.address());
+  EXPECT_GE(first_endpoint.port(), 49152);
+  EXPECT_GE(second_endpoint.port(), 49152);
+  EXPECT_NE(first_endpoint.port(), second_endpoint.port());
+
+  // A dynamically chosen port collides with an explicit bind like any other.
+  FabricBackend collision(socket_);
+  EXPECT_EQ(kBindError, collision.Bind(first_endpoint));
+  EXPECT_FALSE(collision.IsOpen());
+  collision.LocalEndpoint(ec);
+  EXPECT_EQ(asio::error::bad_descriptor, ec);
+
+  // Dynamic ports skip those already taken, and the same port on another address is distinct.
+  std::set<uint16_t> ports;
+  ports.insert(first_endpoint.port());
+  ports.insert(second_endpoint.port());
+  std::vector<std::unique_ptr<FabricBackend>> backends;
+  for (int i(0); i < 100; ++i) {
+    backends.push_back(Bind(kAny));
+    EXPECT_TRUE(ports.insert(backends.back()->LocalEndpoint(ec).port()).second);
+  }
+  std::unique_ptr<FabricBackend> other_address(
+      Bind(Endpoint("10.0.4.2", first_endpoint.port())));
+
+  first->Close();
+  EXPECT_EQ(kSuccess, collision.Bind(first_endpoint));
+  EXPECT_EQ(first_endpoint, collision.LocalEndpoint(ec));
+}
+
+TEST_F(FabricBackendTest, BEH_ConcurrentSenders) {
+  const ip::udp::endpoint kReceiver(Endpoint("10.0.5.1", 1000));
+  std::unique_ptr<FabricBackend> receiver(Bind(kReceiver));
+  const uint32_t kSenderCount(4);
+  std::vector<std::unique_ptr<FabricBackend>> senders;
+  for (uint32_t i(0); i < kSenderCount; ++i)
+    senders.push_back(Bind(Endpoint("10.0.5.2", static_cast<uint16_t>(1000 + i))));
+
+  // Each datagram carries its sender's index and its own sequence number.  While the receiver
+  // drains the queue as they send, some may be dropped, but each sender's must stay in order.
+  auto run_senders([&](uint32_t count, std::atomic<bool>& sending) {
+    std::atomic<uint32_t> ready(0);
+    std::vector<std::thread> threads;
+    for (uint32_t i(0); i < kSenderCount; ++i) {
+      threads.push_back(std::thread([&, i] {
+        ++ready;
+        while (ready < kSenderCount) {}
+        for (uint32_t n(0); n < count; ++n)
+          Send(*senders[i], kReceiver, (i << 16) | n);
+      }));
+    }
+    for (auto& thread : threads)
+      thread.join();
+    sending = false;
+  });
+  auto check([&](const Datagrams& datagrams, uint32_t count) {
+    std::vector<uint32_t> next(kSenderCount, 0);
+    for (const auto& datagram : datagrams) {
+      uint32_t i(datagram.second >> 16), n(datagram.second & 0xffff);
+      ASSERT_LT(i, kSenderCount);
+      EXPECT_EQ(Endpoint("10.0.5.2", static_cast<uint16_t>(1000 + i)), datagram.first);
+      EXPECT_GE(n, next[i]);
+      EXPECT_LT(n, count);
+      next[i] = n + 1;
+    }
+  });
+
+  // A full queue's worth, so none may be dropped.
+  const uint32_t kFitting(kQueueCapacity / kSenderCount);
+  std::atomic<bool> sending(true);
+  run_senders(kFitting, sending);
+  Datagrams datagrams;
+  ReceiveAll(*receiver, datagrams);
+  EXPECT_EQ(kQueueCapacity, datagrams.size());
+  check(datagrams, kFitting);
+
+  // Many times the queue's capacity, received concurrently.
+  const uint32_t kMany(20 * kQueueCapacity);
+  sending = true;
+  std::thread sending_thread([&] { run_senders(kMany, sending); });
+  datagrams.clear();
+  while (sending)
+    ReceiveAll(*receiver, datagrams);
+  sending_thread.join();
+  ReceiveAll(*receiver, datagrams);
+  EXPECT_LE(datagrams.size(), kSenderCount * kMany);
+  EXPECT_GE(datagrams.size(), kQueueCapacity);
+  check(datagrams, kMany);
+}
+
+}  // unnamed namespace
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
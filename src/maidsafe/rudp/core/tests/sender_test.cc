@@ -0,0 +1,223 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/common/test.h"
+
+#include "maidsafe/rudp/core/congestion_control.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/peer.h"
+#include "maidsafe/rudp/core/sender.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
+#include "maidsafe/rudp/core/tick_timer.h"
+#include "maidsafe/rudp/packets/ack_packet.h"
+#include "maidsafe/rudp/packets/data_packet.h"
+#include "maidsafe/rudp/packets/negative_ack_packet.h"
+#include "maidsafe/rudp/parameters.h"
+#include "maidsafe/rudp/return_codes.h"
+
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+// Drives a Sender whose peer is a plain UDP socket, from which the data packets it sends are read
+// back.  Only one packet is sent per send pass (Parameters::default_burst_send_size), so each call
+// to Tick sends at most one more.
+class SenderTest : public testing::Test {
+ protected:
+  SenderTest()
+      : io_service_(),
+        multiplexer_(io_service_),
+        peer_(multiplexer_),
+        tick_timer_(io_service_),
+        congestion_control_(),
+        sender_(peer_, tick_timer_, congestion_control_),
+        peer_socket_(io_service_),
+        first_(sender_.GetNextPacketSequenceNumber()),
+        data_(),
+        completed_message_numbers_() {}
+
+  void SetUp() {
+    ASSERT_EQ(1U, Parameters::default_burst_send_size);
+    ASSERT_EQ(kSuccess, multiplexer_.Open(ip::udp::endpoint(ip::address_v4::loopback(), 0)));
+    peer_socket_.open(ip::udp::v4());
+    peer_socket_.bind(ip::udp::endpoint(ip::address_v4::loopback(), 0));
+    peer_socket_.non_blocking(true);
+    peer_.SetPeerEndpoint(peer_socket_.local_endpoint());
+    peer_.SetSocketId(1);
+    congestion_control_.OnOpen(first_, 0);
+  }
+
+  void TearDown() { multiplexer_.Close(); }
+
+  // Queue enough data for packet_count packets, sending the first of them.
+  void AddPackets(size_t packet_count) {
+    size_t size(packet_count * congestion_control_.SendDataSize());
+    data_ = SharedBuffer::Allocate(size);
+    ASSERT_EQ(size, sender_.AddData(data_, asio::buffer(data_->Data(), size), 1));
+  }
+
+  void Tick(size_t count) {
+    for (size_t i(0); i != count; ++i)
+      sender_.HandleTick();
+  }
+
+  // Acknowledge the packets first_ + first to first_ + last, reporting room at the peer for
+  // peer_room more packets.
+  void Ack(uint32_t first, uint32_t last, uint32_t peer_room) {
+    AckPacket ack;
+    ack.SetDestinationSocketId(1);
+    ack.SetAckSequenceNumber(first_ + last);
+    ack.AddSequenceNumbers(first_ + first, first_ + last);
+    ack.SetHasOptionalFields(true);
+    ack.SetRoundTripTime(1000);
+    ack.SetAvailableBufferSize(peer_room * Parameters::max_data_size);
+    sender_.HandleAck(ack, completed_message_numbers_);
+  }
+
+  void NegativeAck(uint32_t first, uint32_t last) {
+    NegativeAckPacket negative_ack;
+    negative_ack.SetDestinationSocketId(1);
+    negative_ack.AddSequenceNumbers(first_ + first, first_ + last);
+    sender_.HandleNegativeAck(negative_ack);
+  }
+
+  // Returns the data packets sent since the last call, as offsets from first_.
+  std::vector<uint32_t> SentPackets() {
+    std::vector<uint32_t> sent;
+    std::vector<unsigned char> buffer(Parameters::max_size);
+    bs::error_code ec;
+    for (;;) {
+      size_t length(peer_socket_.receive(asio::buffer(buffer), 0, ec));
+      if (ec)
+        break;
+      DataPacket packet;
+      if (packet.Decode(asio::buffer(buffer.data(), length)))
+        sent.push_back(packet.PacketSequenceNumber() - first_);
+    }
+    EXPECT_EQ(asio::error::would_block, ec);
+    return sent;
+  }
+
+  // Wait until every send made so far has timed out.
+  void WaitForSendTimeout() {
+    std::this_thread::sleep_for(std::chrono::microseconds(
+        2 * congestion_control_.SendTimeout().total_microseconds()));
+  }
+
+  asio::io_service io_service_;
+  Multiplexer multiplexer_;
+  Peer peer_;
+  TickTimer tick_timer_;
+  CongestionControl congestion_control_;
+  Sender sender_;
+  ip::udp::socket peer_socket_;
+  const uint32_t first_;
+  SharedBufferPtr data_;
+  std::vector<uint32_t> completed_message_numbers_;
+};
+
+typedef std::vector<uint32_t> Packets;
+
+}  // unnamed namespace
+
+TEST_F(SenderTest, BEH_LostPacketsResentFirst) {
+  AddPackets(8);
+  Tick(3);
+  EXPECT_EQ(Packets({0, 1, 2, 3}), SentPackets());
+
+  // The negative ack resends the first lost packet straight away, and the next new packet waits
+  // until the other has been resent.
+  NegativeAck(1, 2);
+  Tick(3);
+  EXPECT_EQ(Packets({1, 2, 4, 5}), SentPackets());
+
+  // Packets which haven't been sent yet can't be lost, so a negative ack for them changes nothing.
+  NegativeAck(7, 7);
+  Tick(2);
+  EXPECT_EQ(Packets({6, 7}), SentPackets());
+}
+
+TEST_F(SenderTest, BEH_AckedEndAdvances) {
+  AddPackets(10);
+  EXPECT_EQ(Packets({0}), SentPackets());
+
+  // The peer's room is counted from just after the latest packet it has acknowledged.
+  Ack(0, 0, 2);
+  Tick(3);
+  EXPECT_EQ(Packets({1, 2}), SentPackets());
+
+  // That holds even when an earlier packet is still missing.
+  Ack(2, 2, 2);
+  Tick(3);
+  EXPECT_EQ(Packets({3, 4}), SentPackets());
+
+  // Filling the hole doesn't move it back, so no room is made.
+  Ack(1, 1, 2);
+  Tick(3);
+  EXPECT_TRUE(SentPackets().empty());
+
+  Ack(3, 4, 3);
+  Tick(4);
+  EXPECT_EQ(Packets({5, 6, 7}), SentPackets());
+}
+
+TEST_F(SenderTest, BEH_ExpiredPacketsResentOnce) {
+  AddPackets(3);
+  Tick(2);
+  EXPECT_EQ(Packets({0, 1, 2}), SentPackets());
+
+  // Resending the first packet leaves two of its sends waiting to time out.
+  NegativeAck(0, 0);
+  EXPECT_EQ(Packets({0}), SentPackets());
+
+  // The expired sends put each packet on the loss list once, so each is resent once.
+  WaitForSendTimeout();
+  Tick(5);
+  EXPECT_EQ(Packets({0, 1, 2}), SentPackets());
+
+  // Acknowledged packets don't expire.
+  Ack(0, 1, 10);
+  WaitForSendTimeout();
+  Tick(5);
+  EXPECT_EQ(Packets({2}), SentPackets());
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
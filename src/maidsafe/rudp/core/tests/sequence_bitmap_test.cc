@@ -0,0 +1,150 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/rudp/core/sequence_bitmap.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+typedef std::vector<std::pair<uint32_t, uint32_t>> Ranges;
+
+Ranges GetRanges(const SequenceBitmap& bitmap) {
+  Ranges ranges;
+  bitmap.ForEachRange([&ranges](uint32_t first, uint32_t last) {
+    ranges.push_back(std::make_pair(first, last));
+  });
+  return ranges;
+}
+
+// Builds the ranges the bitmap should report from the offsets of the sequence numbers it holds.
+Ranges ExpectedRanges(const std::set<uint32_t>& offsets, uint32_t base) {
+  const uint32_t kMax(SequenceBitmap::kMaxSequenceNumber);
+  Ranges ranges;
+  for (auto itr(offsets.begin()); itr != offsets.end();) {
+    uint32_t first(*itr), last(*itr);
+    while (++itr != offsets.end() && *itr == last + 1)
+      ++last;
+    ranges.push_back(std::make_pair((base + first) & kMax, (base + last) & kMax));
+  }
+  return ranges;
+}
+
+void TestAgainstSet(uint32_t base) {
+  const uint32_t kMax(SequenceBitmap::kMaxSequenceNumber);
+  const uint32_t kSpan(4096);
+  SequenceBitmap bitmap;
+  std::set<uint32_t> offsets;
+
+  for (int i = 0; i != 20000; ++i) {
+    uint32_t offset(RandomUint32() % kSpan);
+    if (RandomUint32() % 4 != 0) {
+      EXPECT_EQ(offsets.insert(offset).second, bitmap.Insert((base + offset) & kMax));
+    } else {
+      uint32_t last(std::min(offset + RandomUint32() % 200, kSpan - 1));
+      offsets.erase(offsets.lower_bound(offset), offsets.upper_bound(last));
+      bitmap.Erase((base + offset) & kMax, (base + last) & kMax);
+    }
+    ASSERT_EQ(offsets.size(), bitmap.Size());
+    uint32_t probe(RandomUint32() % kSpan);
+    ASSERT_EQ(offsets.count(probe) != 0, bitmap.Contains((base + probe) & kMax));
+  }
+  ASSERT_EQ(ExpectedRanges(offsets, base), GetRanges(bitmap));
+
+  bitmap.Erase(base, (base + kSpan - 1) & kMax);
+  EXPECT_TRUE(bitmap.IsEmpty());
+  EXPECT_TRUE(GetRanges(bitmap).empty());
+}
+
+}  // unnamed namespace
+
+TEST(SequenceBitmapTest, BEH_Ranges) {
+  SequenceBitmap bitmap;
+  EXPECT_TRUE(bitmap.IsEmpty());
+  for (uint32_t n : {1000, 1001, 1002, 1005, 1063, 1064, 1065, 1200, 990})
+    EXPECT_TRUE(bitmap.Insert(n));
+  EXPECT_FALSE(bitmap.Insert(1064));
+  EXPECT_EQ(9U, bitmap.Size());
+  EXPECT_TRUE(bitmap.Contains(990));
+  EXPECT_FALSE(bitmap.Contains(1003));
+
+  Ranges expected;
+  expected.push_back(std::make_pair(990U, 990U));
+  expected.push_back(std::make_pair(1000U, 1002U));
+  expected.push_back(std::make_pair(1005U, 1005U));
+  expected.push_back(std::make_pair(1063U, 1065U));
+  expected.push_back(std::make_pair(1200U, 1200U));
+  EXPECT_EQ(expected, GetRanges(bitmap));
+
+  // Erasing a range which is only partly held leaves the rest.
+  bitmap.Erase(900, 1063);
+  EXPECT_EQ(3U, bitmap.Size());
+  expected.erase(expected.begin(), expected.begin() + 4);
+  expected.insert(expected.begin(), std::make_pair(1064U, 1065U));
+  EXPECT_EQ(expected, GetRanges(bitmap));
+  EXPECT_FALSE(bitmap.Contains(1000));
+
+  bitmap.Clear();
+  EXPECT_TRUE(bitmap.IsEmpty());
+  EXPECT_FALSE(bitmap.Contains(1064));
+}
+
+TEST(SequenceBitmapTest, BEH_Wraparound) {
+  const uint32_t kMax(SequenceBitmap::kMaxSequenceNumber);
+  SequenceBitmap bitmap;
+  for (uint32_t n = kMax - 2; n != 3; n = (n + 1) & kMax)
+    EXPECT_TRUE(bitmap.Insert(n));
+  EXPECT_TRUE(bitmap.Insert(kMax - 10));
+
+  Ranges expected;
+  expected.push_back(std::make_pair(kMax - 10, kMax - 10));
+  expected.push_back(std::make_pair(kMax - 2, 2U));
+  EXPECT_EQ(expected, GetRanges(bitmap));
+
+  bitmap.Erase(kMax - 10, 0);
+  expected.clear();
+  expected.push_back(std::make_pair(1U, 2U));
+  EXPECT_EQ(expected, GetRanges(bitmap));
+}
+
+TEST(SequenceBitmapTest, BEH_AgainstSet) {
+  TestAgainstSet(123456);
+  TestAgainstSet(SequenceBitmap::kMaxSequenceNumber - 2000);
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -61,6 +61,28 @@ TEST(SlidingWindowTest, BEH_Wraparound) {
   TestWindowRange(SlidingWindow<uint32_t>::kMaxSequenceNumber - kTestPacketCount / 2);
 }
 
+TEST(SlidingWindowTest, BEH_GrowAcrossWraparound) {
+  // Start just short of the wrap, so that the window's slots are reallocated while it spans it.
+  SlidingWindow<uint32_t> window(SlidingWindow<uint32_t>::kMaxSequenceNumber - 10);
+  window.SetMaximumSize(Parameters::maximum_window_size);
+  ASSERT_EQ(Parameters::maximum_window_size, window.MaximumSize());
+
+  while (!window.IsFull()) {
+    uint32_t n = window.Append();
+    window[n] = n;
+    ASSERT_EQ(n, window.Back());
+  }
+  ASSERT_EQ(window.MaximumSize(), window.Size());
+
+  for (uint32_t n = window.Begin(); n != window.End(); n = window.Next(n))
+    ASSERT_EQ(n, window[n]);
+
+  while (!window.IsEmpty()) {
+    ASSERT_EQ(window.Begin(), window.Front());
+    window.Remove();
+  }
+}
+
 }  // namespace test
 
 }  // namespace detail
@@ -0,0 +1,271 @@
+/*  Copyright 2012 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/socket.h"
+#include "maidsafe/rudp/core/socket_index.h"
+#include "maidsafe/rudp/core/tests/connected_socket_pair.h"
+#include "maidsafe/rudp/nat_type.h"
+
+namespace ip = boost::asio::ip;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace test {
+
+namespace {
+
+// The most sockets a table holds (kMaxSlots in socket_index.cc).
+const uint32_t kMaxSlots(1U << 18);
+
+ip::udp::endpoint Endpoint(const std::string& address, uint16_t port) {
+  return ip::udp::endpoint(ip::address::from_string(address), port);
+}
+
+// Provides sockets which are never connected, on a multiplexer which is never opened.
+class SocketIndexTest : public testing::Test {
+ protected:
+  SocketIndexTest()
+      : io_service_(),
+        multiplexer_(io_service_),
+        nat_type_(NatType::kUnknown),
+        socket0_(multiplexer_, nat_type_),
+        socket1_(multiplexer_, nat_type_),
+        socket2_(multiplexer_, nat_type_) {}
+
+  boost::asio::io_service io_service_;
+  Multiplexer multiplexer_;
+  NatType nat_type_;
+  Socket socket0_, socket1_, socket2_;
+};
+
+}  // unnamed namespace
+
+TEST_F(SocketIndexTest, BEH_FindByEndpoint) {
+  SocketIndex index(RandomUint32());
+  const uint32_t id0(index.Add(&socket0_, Endpoint("10.0.0.1", 5000)));
+  const uint32_t id1(index.Add(&socket1_, Endpoint("10.0.0.1", 5001)));
+  const uint32_t id2(index.Add(&socket2_, Endpoint("10.0.0.2", 5000)));
+  ASSERT_NE(0U, id0);
+  ASSERT_NE(0U, id1);
+  ASSERT_NE(0U, id2);
+  EXPECT_EQ(3U, index.Size());
+  EXPECT_EQ(&socket0_, index.Find(id0));
+  EXPECT_EQ(&socket1_, index.Find(id1));
+  EXPECT_EQ(&socket2_, index.Find(id2));
+
+  // Both the address and the port have to match.
+  EXPECT_EQ(id0, index.FindByEndpoint(Endpoint("10.0.0.1", 5000), false));
+  EXPECT_EQ(id1, index.FindByEndpoint(Endpoint("10.0.0.1", 5001), false));
+  EXPECT_EQ(id2, index.FindByEndpoint(Endpoint("10.0.0.2", 5000), true));
+  EXPECT_EQ(0U, index.FindByEndpoint(Endpoint("10.0.0.2", 5001), false));
+  EXPECT_EQ(0U, index.FindByEndpoint(Endpoint("10.0.0.3", 5000), false));
+
+  // Re-indexing moves a socket to its new endpoint, and its address along with it.
+  index.UpdatePeerEndpoint(id2, Endpoint("10.0.0.3", 6000));
+  EXPECT_EQ(0U, index.FindByEndpoint(Endpoint("10.0.0.2", 5000), false));
+  EXPECT_EQ(id2, index.FindByEndpoint(Endpoint("10.0.0.3", 6000), false));
+  EXPECT_EQ(0U, index.FindUnconnectedByAddress(ip::address::from_string("10.0.0.2")));
+  EXPECT_EQ(id2, index.FindUnconnectedByAddress(ip::address::from_string("10.0.0.3")));
+}
+
+TEST_F(SocketIndexTest, BEH_FindUnconnectedByAddress) {
+  SocketIndex index(RandomUint32());
+  const uint32_t id0(index.Add(&socket0_, Endpoint("10.0.1.1", 5000)));
+  const uint32_t id1(index.Add(&socket1_, Endpoint("10.0.1.2", 5000)));
+  ASSERT_NE(0U, id0);
+  ASSERT_NE(0U, id1);
+
+  // Any port at the address matches.
+  EXPECT_EQ(id0, index.FindUnconnectedByAddress(ip::address::from_string("10.0.1.1")));
+  EXPECT_EQ(id1, index.FindUnconnectedByAddress(ip::address::from_string("10.0.1.2")));
+  EXPECT_EQ(0U, index.FindUnconnectedByAddress(ip::address::from_string("10.0.1.3")));
+
+  // A second socket at the same address is found once the first has gone.
+  const uint32_t id2(index.Add(&socket2_, Endpoint("10.0.1.1", 5001)));
+  ASSERT_NE(0U, id2);
+  index.Remove(id0);
+  EXPECT_EQ(id2, index.FindUnconnectedByAddress(ip::address::from_string("10.0.1.1")));
+}
+
+TEST_F(SocketIndexTest, BEH_ConnectedSocketsSkipped) {
+  ConnectedSocketPair sockets(io_service_);
+  ASSERT_TRUE(sockets.Connect());
+  Socket& connected_socket(sockets.client_socket());
+  ASSERT_TRUE(connected_socket.IsConnected());
+  ASSERT_FALSE(socket0_.IsConnected());
+
+  // The connected socket and an unconnected one share the peer's endpoint.
+  const ip::udp::endpoint peer_endpoint(connected_socket.PeerEndpoint());
+  SocketIndex index(RandomUint32());
+  const uint32_t connected_id(index.Add(&connected_socket, peer_endpoint));
+  ASSERT_NE(0U, connected_id);
+  EXPECT_EQ(connected_id, index.FindByEndpoint(peer_endpoint, false));
+  EXPECT_EQ(0U, index.FindByEndpoint(peer_endpoint, true));
+  EXPECT_EQ(0U, index.FindUnconnectedByAddress(peer_endpoint.address()));
+
+  const uint32_t unconnected_id(index.Add(&socket0_, peer_endpoint));
+  ASSERT_NE(0U, unconnected_id);
+  EXPECT_EQ(unconnected_id, index.FindByEndpoint(peer_endpoint, true));
+  EXPECT_EQ(unconnected_id, index.FindUnconnectedByAddress(peer_endpoint.address()));
+  const uint32_t any_id(index.FindByEndpoint(peer_endpoint, false));
+  EXPECT_TRUE(any_id == connected_id || any_id == unconnected_id);
+
+  index.Remove(unconnected_id);
+  EXPECT_EQ(connected_id, index.FindByEndpoint(peer_endpoint, false));
+  EXPECT_EQ(0U, index.FindByEndpoint(peer_endpoint, true));
+  EXPECT_EQ(0U, index.FindUnconnectedByAddress(peer_endpoint.address()));
+}
+
+TEST_F(SocketIndexTest, BEH_RemovedSocketStopsMatching) {
+  SocketIndex index(RandomUint32());
+  const ip::udp::endpoint peer_endpoint(Endpoint("10.0.2.1", 5000));
+  const uint32_t id0(index.Add(&socket0_, peer_endpoint));
+  const uint32_t id1(index.Add(&socket1_, Endpoint("10.0.2.2", 5000)));
+  ASSERT_NE(0U, id0);
+  ASSERT_NE(0U, id1);
+
+  index.Remove(id0);
+  EXPECT_EQ(1U, index.Size());
+  EXPECT_FALSE(index.Contains(id0));
+  EXPECT_EQ(nullptr, index.Find(id0));
+  EXPECT_EQ(0U, index.FindByEndpoint(peer_endpoint, false));
+  EXPECT_EQ(0U, index.FindByEndpoint(peer_endpoint, true));
+  EXPECT_EQ(0U, index.FindUnconnectedByAddress(peer_endpoint.address()));
+
+  // Removing it again, or re-indexing it, is harmless.
+  index.Remove(id0);
+  index.UpdatePeerEndpoint(id0, peer_endpoint);
+  EXPECT_EQ(1U, index.Size());
+  EXPECT_EQ(0U, index.FindByEndpoint(peer_endpoint, false));
+  EXPECT_EQ(&socket1_, index.Find(id1));
+  EXPECT_EQ(id1, index.FindByEndpoint(Endpoint("10.0.2.2", 5000), false));
+}
+
+TEST_F(SocketIndexTest, BEH_StaleIdRejected) {
+  SocketIndex index(RandomUint32());
+  const ip::udp::endpoint peer_endpoint(Endpoint("10.0.3.1", 5000));
+  const uint32_t old_id(index.Add(&socket0_, peer_endpoint));
+  ASSERT_NE(0U, old_id);
+  index.Remove(old_id);
+
+  // With no other slots free, the next socket reuses the same slot in its next generation.
+  const uint32_t new_id(index.Add(&socket1_, peer_endpoint));
+  ASSERT_NE(0U, new_id);
+  EXPECT_NE(old_id, new_id);
+  EXPECT_FALSE(index.Contains(old_id));
+  EXPECT_EQ(nullptr, index.Find(old_id));
+  EXPECT_EQ(&socket1_, index.Find(new_id));
+
+  // Neither removing nor re-indexing by the old id touches the slot's new socket.
+  index.Remove(old_id);
+  index.UpdatePeerEndpoint(old_id, Endpoint("10.0.3.2", 5000));
+  EXPECT_EQ(1U, index.Size());
+  EXPECT_EQ(&socket1_, index.Find(new_id));
+  EXPECT_EQ(new_id, index.FindByEndpoint(peer_endpoint, false));
+}
+
+TEST_F(SocketIndexTest, BEH_IdZeroNeverIssued) {
+  // With no secret, the first generation of the first slot encodes to 0, which is reserved for
+  // handshakes on new sockets.  Reusing the slot runs its generation through a full wrap.
+  for (uint32_t shard_count(1); shard_count != 4; ++shard_count) {
+    SocketIndex index(0);
+    index.SetShard(0, shard_count);
+    std::set<uint32_t> ids;
+    for (int i(0); i != 40000; ++i) {
+      const uint32_t id(index.Add(&socket0_, Endpoint("10.0.4.1", 5000)));
+      ASSERT_NE(0U, id) << "Add " << i << " with " << shard_count << " shards";
+      ids.insert(id);
+      index.Remove(id);
+    }
+    // The generation wrapped, reissuing earlier ids.
+    EXPECT_LT(ids.size(), 40000U);
+  }
+}
+
+TEST_F(SocketIndexTest, BEH_IdsOwnedByShard) {
+  const uint32_t secret(RandomUint32());
+  for (uint32_t shard_count(1); shard_count != 9; ++shard_count) {
+    std::vector<std::unique_ptr<SocketIndex>> shards;
+    for (uint32_t shard(0); shard != shard_count; ++shard) {
+      shards.emplace_back(new SocketIndex(secret));
+      shards.back()->SetShard(shard, shard_count);
+    }
+    for (uint32_t shard(0); shard != shard_count; ++shard) {
+      for (uint16_t port(1); port != 100; ++port) {
+        const uint32_t id(shards[shard]->Add(&socket0_, Endpoint("10.0.5.1", port)));
+        ASSERT_NE(0U, id);
+        EXPECT_EQ(shard, id % shard_count) << id << " with " << shard_count << " shards";
+        // The shards share a secret, so only the owning shard's shard number stops the others
+        // decoding the id into a slot of their own.
+        for (uint32_t other(0); other != shard_count; ++other)
+          EXPECT_EQ(other == shard, shards[other]->Contains(id));
+      }
+    }
+  }
+}
+
+TEST_F(SocketIndexTest, BEH_FullTable) {
+  SocketIndex index(RandomUint32());
+  std::vector<uint32_t> ids;
+  ids.reserve(kMaxSlots);
+  for (uint32_t i(0); i != kMaxSlots; ++i) {
+    ids.push_back(index.Add(&socket0_, ip::udp::endpoint(ip::address_v4(0x0a060000 + i), 5000)));
+    ASSERT_NE(0U, ids.back());
+  }
+  EXPECT_EQ(kMaxSlots, index.Size());
+
+  // A full table refuses the socket without indexing it, and is otherwise unchanged.
+  const ip::udp::endpoint peer_endpoint(Endpoint("10.0.7.1", 5000));
+  EXPECT_EQ(0U, index.Add(&socket1_, peer_endpoint));
+  EXPECT_EQ(kMaxSlots, index.Size());
+  EXPECT_EQ(0U, index.FindByEndpoint(peer_endpoint, false));
+  EXPECT_EQ(0U, index.FindUnconnectedByAddress(peer_endpoint.address()));
+  EXPECT_EQ(&socket0_, index.Find(ids.front()));
+  EXPECT_EQ(&socket0_, index.Find(ids.back()));
+
+  // Freeing a slot makes room again.
+  index.Remove(ids.front());
+  const uint32_t id(index.Add(&socket1_, peer_endpoint));
+  ASSERT_NE(0U, id);
+  EXPECT_EQ(&socket1_, index.Find(id));
+  EXPECT_EQ(id, index.FindByEndpoint(peer_endpoint, false));
+}
+
+}  // namespace test
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -28,7 +28,9 @@
 
 #include "maidsafe/rudp/core/multiplexer.h"
 #include "maidsafe/rudp/core/socket.h"
+#include "maidsafe/rudp/core/tests/connected_socket_pair.h"
 #include "maidsafe/rudp/connection_manager.h"
+#include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/transport.h"
 #include "maidsafe/rudp/utils.h"
 #include "maidsafe/rudp/tests/test_utils.h"
@@ -160,6 +162,73 @@ TEST(SocketTest, BEH_Socket) {
   ASSERT_TRUE(!client_ec);
 }
 
+// Streams more than a full window at a time over a lossy link, so that the sender's loss list and
+// retransmission timeouts (or the receiver's negative acks) are both exercised heavily.
+void StreamUnderLoss(Parameters::LossRecoveryMode loss_recovery_mode) {
+  const uint32_t kWindowSize(1024);
+  const size_t kLossyBufferSize(3 * kWindowSize * Parameters::max_data_size / 2);
+  const size_t kLossyIterations(2);
+  // The debug loss rate applies to each 1500 byte fragment of a datagram, so this drops about 5% of
+  // full data packets, but never a control packet, since those all fit in one fragment.
+  const double kFragmentLossRate(0.01);
+
+  // Put everything back however the test ends.
+  struct RestoreParameters {
+    ~RestoreParameters() {
+      Multiplexer::SetDebugPacketLossRate(0.0, 0.0);
+      Parameters::default_window_size = default_window_size;
+      Parameters::maximum_window_size = maximum_window_size;
+      Parameters::maximum_receive_buffer_size = maximum_receive_buffer_size;
+    }
+    uint32_t default_window_size, maximum_window_size, maximum_receive_buffer_size;
+  } restore_parameters = {Parameters::default_window_size, Parameters::maximum_window_size,
+                          Parameters::maximum_receive_buffer_size};
+  Parameters::default_window_size = kWindowSize;
+  Parameters::maximum_window_size = kWindowSize;
+  Parameters::maximum_receive_buffer_size = kWindowSize * Parameters::max_size;
+
+  boost::asio::io_service io_service;
+  ConnectedSocketPair sockets(io_service);
+  ASSERT_TRUE(sockets.Connect());
+  Socket& server_socket(sockets.server_socket());
+  Socket& client_socket(sockets.client_socket());
+  server_socket.SetLossRecoveryMode(loss_recovery_mode);
+  client_socket.SetLossRecoveryMode(loss_recovery_mode);
+
+  // Only drop data once connected, so the handshake can't time out.
+  Multiplexer::SetDebugPacketLossRate(kFragmentLossRate, 0.0);
+  sockets.StartTicking();
+  bs::error_code server_ec;
+  bs::error_code client_ec;
+
+  for (size_t i = 0; i < kLossyIterations; ++i) {
+    std::vector<unsigned char> server_buffer(kLossyBufferSize);
+    server_ec = boost::asio::error::would_block;
+    server_socket.AsyncRead(boost::asio::buffer(server_buffer), kLossyBufferSize,
+                            std::bind(&handler1, args::_1, &server_ec));
+
+    std::vector<unsigned char> client_buffer(kLossyBufferSize);
+    for (size_t j = 0; j < kLossyBufferSize; ++j)
+      client_buffer[j] = static_cast<unsigned char>((i + j) % 251);
+    client_ec = boost::asio::error::would_block;
+    client_socket.AsyncWrite(boost::asio::buffer(client_buffer), [](int) {},  // NOLINT (Fraser)
+                             std::bind(&handler1, args::_1, &client_ec));
+
+    RunUntilComplete(io_service, server_ec, client_ec);
+    ASSERT_TRUE(!server_ec);
+    ASSERT_TRUE(!client_ec);
+    ASSERT_TRUE(client_buffer == server_buffer);
+  }
+
+  ASSERT_TRUE(sockets.Flush());
+}
+
+TEST(SocketTest, FUNC_SocketUnderLoss) { StreamUnderLoss(Parameters::kSenderTimeout); }
+
+TEST(SocketTest, FUNC_SocketUnderLossWithNegativeAcks) {
+  StreamUnderLoss(Parameters::kReceiverNegativeAck);
+}
+
 TEST(SocketTest, BEH_AsyncProbe) {
   using Endpoint = ip::udp::endpoint;
 
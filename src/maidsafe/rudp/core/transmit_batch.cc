@@ -0,0 +1,324 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/transmit_batch.h"
+
+#ifdef __linux__
+#  include <netinet/in.h>
+#  include <netinet/udp.h>
+#endif
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include "maidsafe/rudp/parameters.h"
+
+namespace asio = boost::asio;
+namespace ip = boost::asio::ip;
+namespace bs = boost::system;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+#ifdef __linux__
+#  ifndef SOL_UDP
+#    define SOL_UDP 17
+#  endif
+#  ifndef UDP_SEGMENT
+#    define UDP_SEGMENT 103
+#  endif
+
+#  ifndef MSG_ZEROCOPY
+#    define MSG_ZEROCOPY 0x4000000
+#  endif
+
+// The kernel's limit on the number of segments in a single offloaded send.
+const size_t kMaxSegments = 64;
+
+const size_t kControlSpace = CMSG_SPACE(sizeof(uint16_t));
+#endif
+
+// The largest header which is copied aside for a zero-copy send.
+const size_t kMaxZeroCopyHeaderSize = 64;
+
+}  // unnamed namespace
+
+TransmitBatch::TransmitBatch(size_t capacity)
+    : capacity_(capacity),
+      size_(0),
+      storage_(),
+      header_pool_(),
+#ifdef __linux__
+      entries_(capacity),
+      gather_(),
+      iovecs_(capacity * 2),
+      headers_(capacity),
+      control_(capacity * kControlSpace),
+      message_entries_(capacity),
+      message_segment_sizes_(capacity),
+      message_zero_copy_(capacity) {}
+#else
+      entries_(capacity),
+      gather_() {}
+#endif
+
+asio::mutable_buffer TransmitBatch::NextBuffer() {
+  assert(!IsFull());
+  if (storage_.empty())
+    storage_.resize(capacity_ * Parameters::max_size);
+  return asio::buffer(&storage_[size_ * Parameters::max_size], Parameters::max_size);
+}
+
+void TransmitBatch::Push(const std::vector<asio::mutable_buffer>& buffers,
+                         const ip::udp::endpoint& endpoint) {
+  Push(buffers, endpoint, SharedBufferPtr());
+}
+
+void TransmitBatch::Push(const std::vector<asio::mutable_buffer>& buffers,
+                         const ip::udp::endpoint& endpoint, const SharedBufferPtr& payload_buffer) {
+  assert(!IsFull());
+  assert(!buffers.empty() && buffers.size() <= 2);
+  Entry& entry = entries_[size_++];
+  entry.buffer_count = buffers.size();
+  for (size_t i = 0; i < buffers.size(); ++i)
+    entry.buffers[i] = buffers[i];
+  entry.length = asio::buffer_size(buffers);
+  entry.endpoint = endpoint;
+  if (payload_buffer && buffers.size() == 2 &&
+      asio::buffer_size(buffers[0]) <= kMaxZeroCopyHeaderSize) {
+    if (!header_pool_)
+      header_pool_ = SharedBufferPool::Create(kMaxZeroCopyHeaderSize, capacity_);
+    entry.header = header_pool_->Acquire();
+    size_t header_size = asio::buffer_copy(
+        asio::buffer(entry.header->Data(), kMaxZeroCopyHeaderSize), buffers[0]);
+    entry.buffers[0] = asio::buffer(entry.header->Data(), header_size);
+    entry.payload = payload_buffer;
+  }
+}
+
+void TransmitBatch::Clear() {
+  for (size_t i = 0; i < size_; ++i) {
+    entries_[i].header.reset();
+    entries_[i].payload.reset();
+  }
+  size_ = 0;
+}
+
+#ifdef __linux__
+bool TransmitBatch::SegmentationSupported(ip::udp::socket& socket) {
+  int segment_size = 0;
+  socklen_t length = sizeof(segment_size);
+  return ::getsockopt(socket.native_handle(), SOL_UDP, UDP_SEGMENT, &segment_size, &length) == 0;
+}
+
+size_t TransmitBatch::SegmentRun(size_t first, size_t segment_limit) const {
+  const Entry& head = entries_[first];
+  if (head.length > segment_limit)
+    return 1;
+  size_t run = 1, total = head.length;
+  while (first + run < size_ && run < kMaxSegments) {
+    const Entry& next = entries_[first + run];
+    if (next.endpoint != head.endpoint || next.length > head.length ||
+        total + next.length > Parameters::kUDPPayload || !next.payload != !head.payload) {
+      break;
+    }
+    total += next.length;
+    ++run;
+    // Only the final segment may be shorter than the others.
+    if (next.length < head.length)
+      break;
+  }
+  return run;
+}
+#else
+bool TransmitBatch::SegmentationSupported(ip::udp::socket& /*socket*/) { return false; }
+
+size_t TransmitBatch::SegmentRun(size_t /*first*/, size_t /*segment_limit*/) const { return 1; }
+#endif
+
+#ifdef __linux__
+void TransmitBatch::PinMessage(size_t message, size_t first_entry,
+                               ZeroCopyTracker& zero_copy) const {
+  for (size_t i = first_entry; i < first_entry + message_entries_[message]; ++i) {
+    zero_copy.Pin(entries_[i].header);
+    zero_copy.Pin(entries_[i].payload);
+  }
+  zero_copy.Sent();
+}
+
+size_t TransmitBatch::Send(ip::udp::socket& socket, size_t& segment_limit,
+                           ZeroCopyTracker* zero_copy, bs::error_code& ec) {
+  int descriptor(socket.native_handle());
+  return Send([descriptor](mmsghdr* messages, unsigned int count, int flags) {
+                return ::sendmmsg(descriptor, messages, count, flags);
+              }, segment_limit, zero_copy, ec);
+}
+
+size_t TransmitBatch::Send(const MessageSender& send_messages, size_t& segment_limit,
+                           ZeroCopyTracker* zero_copy, bs::error_code& ec) {
+  ec.clear();
+  if (zero_copy && !zero_copy->IsEnabled())
+    zero_copy = nullptr;
+
+  // Lay out one message per entry, or per run of entries which can be segmented by the kernel.
+  size_t message_count = 0, iovec_count = 0;
+  for (size_t first = 0; first < size_; ++message_count) {
+    size_t run = SegmentRun(first, segment_limit);
+    msghdr& header = headers_[message_count].msg_hdr;
+    headers_[message_count] = mmsghdr();
+    header.msg_name = entries_[first].endpoint.data();
+    header.msg_namelen = static_cast<socklen_t>(entries_[first].endpoint.size());
+    header.msg_iov = &iovecs_[iovec_count];
+    for (size_t i = first; i < first + run; ++i) {
+      for (size_t j = 0; j < entries_[i].buffer_count; ++j) {
+        iovecs_[iovec_count].iov_base =
+            const_cast<void*>(asio::buffer_cast<const void*>(entries_[i].buffers[j]));
+        iovecs_[iovec_count].iov_len = asio::buffer_size(entries_[i].buffers[j]);
+        ++iovec_count;
+      }
+    }
+    header.msg_iovlen = &iovecs_[iovec_count] - header.msg_iov;
+    message_entries_[message_count] = run;
+    message_segment_sizes_[message_count] = run > 1 ? entries_[first].length : 0;
+    message_zero_copy_[message_count] = zero_copy && entries_[first].payload;
+    if (run > 1) {
+      header.msg_control = &control_[message_count * kControlSpace];
+      header.msg_controllen = kControlSpace;
+      cmsghdr* control_message = CMSG_FIRSTHDR(&header);
+      control_message->cmsg_level = SOL_UDP;
+      control_message->cmsg_type = UDP_SEGMENT;
+      control_message->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      uint16_t segment_size = static_cast<uint16_t>(entries_[first].length);
+      std::memcpy(CMSG_DATA(control_message), &segment_size, sizeof(segment_size));
+    }
+    first += run;
+  }
+
+  // sendmmsg may accept only part of the batch, so keep going until it's all sent or it fails.  Its
+  // flags apply to every message, so zero-copy messages are sent by separate calls to the others.
+  size_t sent_messages = 0, sent = 0;
+  while (sent_messages < message_count) {
+    bool is_zero_copy = message_zero_copy_[sent_messages];
+    size_t group_end = sent_messages + 1;
+    while (group_end < message_count && message_zero_copy_[group_end] == is_zero_copy)
+      ++group_end;
+    int count, error;
+    if (is_zero_copy) {
+      std::lock_guard<std::mutex> lock(zero_copy->mutex());
+      count = send_messages(&headers_[sent_messages],
+                            static_cast<unsigned int>(group_end - sent_messages), MSG_ZEROCOPY);
+      error = errno;
+      for (size_t i = 0, first = sent; static_cast<int>(i) < count; ++i) {
+        PinMessage(sent_messages + i, first, *zero_copy);
+        first += message_entries_[sent_messages + i];
+      }
+    } else {
+      count = send_messages(&headers_[sent_messages],
+                            static_cast<unsigned int>(group_end - sent_messages), 0);
+      error = errno;
+    }
+    if (count > 0) {
+      for (int i = 0; i < count; ++i)
+        sent += message_entries_[sent_messages++];
+      continue;
+    }
+
+    if (count == 0)
+      error = EAGAIN;
+    if (is_zero_copy && error == ENOBUFS) {
+      // The kernel won't track any more outstanding zero-copy sends, so copy this message instead.
+      message_zero_copy_[sent_messages] = false;
+      continue;
+    }
+    size_t segment_size = message_segment_sizes_[sent_messages];
+    if (segment_size == 0 || (error != EINVAL && error != EIO)) {
+      ec = bs::error_code(error, asio::error::get_system_category());
+      break;
+    }
+
+    // The kernel or device can't segment datagrams this large (e.g. they exceed the path MTU).
+    // Don't try again at this size and send this run's datagrams individually instead.
+    segment_limit = segment_size - 1;
+    msghdr& header = headers_[sent_messages].msg_hdr;
+    iovec* iov = header.msg_iov;
+    size_t first = sent, run = message_entries_[sent_messages];
+    header.msg_control = nullptr;
+    header.msg_controllen = 0;
+    message_entries_[sent_messages] = 1;
+    for (size_t i = first; i < first + run && !ec; ++i) {
+      header.msg_iov = iov;
+      header.msg_iovlen = entries_[i].buffer_count;
+      iov += entries_[i].buffer_count;
+      if (is_zero_copy) {
+        std::lock_guard<std::mutex> lock(zero_copy->mutex());
+        if (send_messages(&headers_[sent_messages], 1, MSG_ZEROCOPY) == 1) {
+          PinMessage(sent_messages, i, *zero_copy);
+          ++sent;
+          continue;
+        }
+        if (errno != ENOBUFS) {
+          ec = bs::error_code(errno, asio::error::get_system_category());
+          continue;
+        }
+      }
+      if (send_messages(&headers_[sent_messages], 1, 0) != 1)
+        ec = bs::error_code(errno, asio::error::get_system_category());
+      else
+        ++sent;
+    }
+    if (ec)
+      break;
+    ++sent_messages;
+  }
+  Clear();
+  return sent;
+}
+#else
+size_t TransmitBatch::Send(ip::udp::socket& socket, size_t& /*segment_limit*/,
+                           ZeroCopyTracker* /*zero_copy*/, bs::error_code& ec) {
+  return Send([&socket](const std::vector<asio::const_buffer>& buffers,
+                        const ip::udp::endpoint& endpoint, bs::error_code& send_ec) {
+                socket.send_to(buffers, endpoint, 0, send_ec);
+              }, ec);
+}
+#endif
+
+size_t TransmitBatch::Send(const DatagramSender& send_datagram, bs::error_code& ec) {
+  ec.clear();
+  size_t sent = 0;
+  for (; sent < size_; ++sent) {
+    Entry& entry = entries_[sent];
+    gather_.assign(entry.buffers.begin(), entry.buffers.begin() + entry.buffer_count);
+    send_datagram(gather_, entry.endpoint, ec);
+    if (ec)
+      break;
+  }
+  Clear();
+  return sent;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
@@ -0,0 +1,161 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_TRANSMIT_BATCH_H_
+#define MAIDSAFE_RUDP_CORE_TRANSMIT_BATCH_H_
+
+#ifdef __linux__
+#  include <sys/socket.h>
+#endif
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/ip/udp.hpp"
+#include "boost/system/error_code.hpp"
+
+#include "maidsafe/rudp/core/shared_buffer.h"
+#include "maidsafe/rudp/core/zero_copy_tracker.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// A queue of encoded datagrams which are transmitted together.  Where sendmmsg is available, Send
+// hands the whole queue to the kernel in a single system call.  Elsewhere it falls back to sending
+// the datagrams one at a time.
+//
+// Where UDP generic segmentation offload (GSO) is available, runs of consecutive equal-sized
+// datagrams to the same endpoint are additionally coalesced into a single message which the kernel
+// splits back into the original datagrams.
+//
+// Datagrams whose gather buffer is held by a SharedBuffer may be sent using MSG_ZEROCOPY, in which
+// case the kernel reads them straight from that buffer (and a copy of their header) after Send has
+// returned.  A ZeroCopyTracker keeps those buffers alive until the kernel has finished with them.
+class TransmitBatch {
+ public:
+  explicit TransmitBatch(size_t capacity);
+
+  // Whether the socket supports UDP generic segmentation offload.
+  static bool SegmentationSupported(boost::asio::ip::udp::socket& socket);
+
+  size_t Capacity() const { return capacity_; }
+  size_t Size() const { return size_; }
+  bool IsEmpty() const { return size_ == 0; }
+  bool IsFull() const { return size_ == capacity_; }
+  // Discard all queued datagrams.
+  void Clear();
+
+  // Get the buffer into which the next datagram should be encoded.
+  // Precondition: !IsFull().
+  boost::asio::mutable_buffer NextBuffer();
+
+  // Queue the next datagram.  buffers must start with (part of) the buffer returned by NextBuffer
+  // and may be followed by a single gather buffer, which must remain valid until Send is called.
+  // Precondition: !IsFull().
+  void Push(const std::vector<boost::asio::mutable_buffer>& buffers,
+            const boost::asio::ip::udp::endpoint& endpoint);
+  // As above, but the gather buffer lies within payload_buffer and the datagram is sent using
+  // MSG_ZEROCOPY if enabled.
+  void Push(const std::vector<boost::asio::mutable_buffer>& buffers,
+            const boost::asio::ip::udp::endpoint& endpoint, const SharedBufferPtr& payload_buffer);
+
+  // Send all queued datagrams and empty the queue.  Returns the number of datagrams accepted by the
+  // kernel.  If fewer than Size() were accepted, ec holds the error which stopped transmission.
+  // Runs of datagrams no larger than segment_limit are sent using segmentation offload; 0 disables
+  // it.  If the kernel rejects a segmented send, segment_limit is lowered so that datagrams of that
+  // size aren't coalesced again, and the run is resent unsegmented.  Datagrams pushed with a
+  // payload buffer are sent using MSG_ZEROCOPY if zero_copy is non-null and enabled.
+  size_t Send(boost::asio::ip::udp::socket& socket, size_t& segment_limit,
+              ZeroCopyTracker* zero_copy, boost::system::error_code& ec);
+
+#ifdef __linux__
+  // Transmits count messages as sendmmsg does, with the given flags.  Returns the number of
+  // messages accepted, or -1 with errno set if none were.
+  typedef std::function<int(mmsghdr* messages, unsigned int count, int flags)> MessageSender;
+
+  // As above, but the laid out messages are handed to send_messages rather than sendmmsg (e.g. to
+  // submit them to an io_uring).
+  size_t Send(const MessageSender& send_messages, size_t& segment_limit,
+              ZeroCopyTracker* zero_copy, boost::system::error_code& ec);
+#endif
+
+  // Transmits a single datagram gathered from buffers, setting ec on failure.
+  typedef std::function<void(const std::vector<boost::asio::const_buffer>& buffers,
+                             const boost::asio::ip::udp::endpoint& endpoint,
+                             boost::system::error_code& ec)> DatagramSender;
+
+  // As above, but each queued datagram is handed to send_datagram in turn, without segmentation
+  // or MSG_ZEROCOPY (e.g. to transmit it in memory rather than through a socket).
+  size_t Send(const DatagramSender& send_datagram, boost::system::error_code& ec);
+
+ private:
+  // Disallow copying and assignment.
+  TransmitBatch(const TransmitBatch&);
+  TransmitBatch& operator=(const TransmitBatch&);
+
+  struct Entry {
+    Entry() : buffers(), buffer_count(0), length(0), endpoint(), header(), payload() {}
+    std::array<boost::asio::const_buffer, 2> buffers;
+    size_t buffer_count;
+    size_t length;
+    boost::asio::ip::udp::endpoint endpoint;
+    // For zero-copy entries, the buffers which buffers[0] and buffers[1] lie within.
+    SharedBufferPtr header, payload;
+  };
+
+  // Returns the number of entries starting at first which can be sent as one segmented message.
+  size_t SegmentRun(size_t first, size_t segment_limit) const;
+
+  // Record the entries of a message accepted by a zero-copy send.
+  void PinMessage(size_t message, size_t first_entry, ZeroCopyTracker& zero_copy) const;
+
+  const size_t capacity_;
+  size_t size_;
+  // Allocated on first use, since many sockets never send enough to need it.
+  std::vector<unsigned char> storage_;
+  // Headers of zero-copy entries are copied to these buffers, since they may still be read by the
+  // kernel after storage_ has been reused.  Allocated on first use.
+  std::shared_ptr<SharedBufferPool> header_pool_;
+  std::vector<Entry> entries_;
+  // The buffers of the datagram being passed to a DatagramSender.
+  std::vector<boost::asio::const_buffer> gather_;
+#ifdef __linux__
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> headers_;
+  // Ancillary data holding the segment size of each coalesced message.
+  std::vector<char> control_;
+  // For each message, the number of entries it carries, its segment size (0 if unsegmented) and
+  // whether it is sent using MSG_ZEROCOPY.
+  std::vector<size_t> message_entries_, message_segment_sizes_;
+  std::vector<bool> message_zero_copy_;
+#endif
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_TRANSMIT_BATCH_H_
@@ -0,0 +1,130 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/core/zero_copy_tracker.h"
+
+#ifdef __linux__
+#  include <linux/errqueue.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#endif
+#include <cstring>
+
+namespace ip = boost::asio::ip;
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+namespace {
+
+#ifdef __linux__
+#  ifndef SO_ZEROCOPY
+#    define SO_ZEROCOPY 60
+#  endif
+#  ifndef SO_EE_ORIGIN_ZEROCOPY
+#    define SO_EE_ORIGIN_ZEROCOPY 5
+#  endif
+#  ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#    define SO_EE_CODE_ZEROCOPY_COPIED 1
+#  endif
+
+// Room for an extended error and the offending address which the kernel appends to it.
+const size_t kControlSpace = CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6));
+#endif
+
+}  // unnamed namespace
+
+ZeroCopyTracker::ZeroCopyTracker()
+    : mutex_(), enabled_(false), next_id_(0), pinned_(), completed_(0), copied_(0) {}
+
+#ifdef __linux__
+bool ZeroCopyTracker::Enable(ip::udp::socket& socket) {
+  int enable = 1;
+  if (::setsockopt(socket.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) != 0)
+    return false;
+  next_id_ = 0;
+  enabled_ = true;
+  return true;
+}
+
+void ZeroCopyTracker::Reap(ip::udp::socket& socket) {
+  char control[kControlSpace];
+  for (;;) {
+    msghdr header = msghdr();
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+    // Fails with EAGAIN once the error queue is empty.
+    if (::recvmsg(socket.native_handle(), &header, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+      return;
+    for (cmsghdr* control_message = CMSG_FIRSTHDR(&header); control_message;
+         control_message = CMSG_NXTHDR(&header, control_message)) {
+      if (!(control_message->cmsg_level == SOL_IP && control_message->cmsg_type == IP_RECVERR) &&
+          !(control_message->cmsg_level == SOL_IPV6 &&
+            control_message->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      sock_extended_err error;
+      std::memcpy(&error, CMSG_DATA(control_message), sizeof(error));
+      if (error.ee_origin == SO_EE_ORIGIN_ZEROCOPY && error.ee_errno == 0) {
+        Complete(error.ee_info, error.ee_data,
+                 (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0);
+      }
+    }
+  }
+}
+#else
+bool ZeroCopyTracker::Enable(ip::udp::socket& /*socket*/) { return false; }
+
+void ZeroCopyTracker::Reap(ip::udp::socket& /*socket*/) {}
+#endif
+
+void ZeroCopyTracker::Reset() {
+  enabled_ = false;
+  next_id_ = 0;
+  pinned_.clear();
+}
+
+void ZeroCopyTracker::Pin(const SharedBufferPtr& buffer) { pinned_.emplace_back(next_id_, buffer); }
+
+void ZeroCopyTracker::Complete(uint32_t first, uint32_t last, bool copied) {
+  // Send numbers wrap, so compare them relative to first.
+  uint32_t count = last - first + 1;
+  completed_ += count;
+  if (copied)
+    copied_ += count;
+  for (auto& pinned : pinned_) {
+    uint32_t offset = pinned.id - first;
+    if (offset < count)
+      pinned.completed = true;
+    else if (offset < 0x80000000u)
+      break;  // Sent after last.
+  }
+  // Completions usually arrive in order, but a buffer is only released once every send before it
+  // has completed too.
+  while (!pinned_.empty() && pinned_.front().completed)
+    pinned_.pop_front();
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
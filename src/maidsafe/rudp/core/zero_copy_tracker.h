@@ -0,0 +1,105 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_CORE_ZERO_COPY_TRACKER_H_
+#define MAIDSAFE_RUDP_CORE_ZERO_COPY_TRACKER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "boost/asio/ip/udp.hpp"
+
+#include "maidsafe/rudp/core/shared_buffer.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Tracks datagrams sent using MSG_ZEROCOPY.  The kernel transmits these straight from the memory
+// they were gathered from, so the buffers holding them are pinned here until the kernel reports,
+// via the socket's error queue, that it has finished with them.
+//
+// The kernel numbers a socket's zero-copy sends consecutively, so each send and the pinning of its
+// buffers must be serialised.  Other than IsEnabled, all functions must be called with mutex()
+// locked.
+class ZeroCopyTracker {
+ public:
+  ZeroCopyTracker();
+
+  // Enable zero-copy sends on socket.  Returns false if the socket doesn't support them.
+  bool Enable(boost::asio::ip::udp::socket& socket);
+  bool IsEnabled() const { return enabled_; }
+
+  // Disable zero-copy sends and release all pinned buffers.  Only to be called once the socket has
+  // been closed, as any datagrams still queued by the kernel may then be sent corrupted.
+  void Reset();
+
+  std::mutex& mutex() { return mutex_; }
+
+  // Record a zero-copy send accepted by the kernel.  Pin is called for each buffer the send
+  // gathered from, keeping it alive until the kernel completes the send, followed by Sent.
+  void Pin(const SharedBufferPtr& buffer);
+  void Sent() { ++next_id_; }
+
+  bool HasPinned() const { return !pinned_.empty(); }
+
+  // Process any completion notifications queued on socket, releasing the buffers of completed
+  // sends.
+  void Reap(boost::asio::ip::udp::socket& socket);
+
+  // The number of zero-copy sends completed so far, and how many of those the kernel copied anyway
+  // (e.g. because the destination is local or the device can't gather from user memory).
+  uint64_t Completed() const { return completed_; }
+  uint64_t Copied() const { return copied_; }
+
+ private:
+  // Disallow copying and assignment.
+  ZeroCopyTracker(const ZeroCopyTracker&);
+  ZeroCopyTracker& operator=(const ZeroCopyTracker&);
+
+  struct Pinned {
+    Pinned(uint32_t id_in, SharedBufferPtr buffer_in)
+        : id(id_in), completed(false), buffer(std::move(buffer_in)) {}
+    uint32_t id;
+    bool completed;
+    SharedBufferPtr buffer;
+  };
+
+  // Mark the sends numbered first to last inclusive as completed.
+  void Complete(uint32_t first, uint32_t last, bool copied);
+
+  std::mutex mutex_;
+  std::atomic<bool> enabled_;
+  // The number the kernel will give the next zero-copy send.
+  uint32_t next_id_;
+  // Buffers in the order they were pinned, and hence in increasing order of send number.
+  std::deque<Pinned> pinned_;
+  uint64_t completed_, copied_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_CORE_ZERO_COPY_TRACKER_H_
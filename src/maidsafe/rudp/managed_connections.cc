@@ -21,7 +21,7 @@
 #include <algorithm>
 #include <functional>
 #include <iterator>
-#include <map>
+#include <utility>
 
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/utils.h"
@@ -47,6 +47,10 @@ void SetDebugPacketLossRate(double constant, double bursty) {
   detail::Multiplexer::SetDebugPacketLossRate(constant, bursty);
 }
 
+size_t ManagedConnections::NodeIdHash::operator()(const NodeId& node_id) const {
+  return detail::NodeIdHash()(node_id);
+}
+
 namespace {
 
 typedef std::vector<std::pair<NodeId, Endpoint>> NodeIdEndpointPairs;
@@ -101,6 +105,7 @@ ManagedConnections::ManagedConnections()
       private_key_(),
       public_key_(),
       connections_(),
+      connections_snapshot_(std::make_shared<ConnectionMap>()),
       pendings_(),
       idle_transports_(),
       mutex_(),
@@ -113,6 +118,7 @@ ManagedConnections::~ManagedConnections() {
     for (auto connection_details : connections_)
       connection_details.second->Close();
     connections_.clear();
+    PublishConnections();
     for (auto& pending : pendings_)
       pending->pending_transport->Close();
     pendings_.clear();
@@ -175,6 +181,7 @@ void ManagedConnections::ClearConnectionsAndIdleTransports() {
       }
     }
     connections_.clear();
+    PublishConnections();
   }
   pendings_.clear();
   for (auto idle_transport : idle_transports_)
@@ -420,6 +427,7 @@ bool ManagedConnections::ExistingConnection(const NodeId& peer_id, EndpointPair&
     LOG(kError) << "Internal ManagedConnections error: mismatch between connections_ and "
                 << "actual connections.";
     connections_.erase(peer_id);
+    PublishConnections();
     return false;
   }
 
@@ -662,12 +670,14 @@ void ManagedConnections::Send(NodeId peer_id, std::string message,
     return;
   }
 
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto itr(connections_.find(peer_id));
-  if (itr != connections_.end()) {
-    if ((*itr).second->Send(peer_id, message, message_sent_functor))
+  std::shared_ptr<const ConnectionMap> connections(std::atomic_load(&connections_snapshot_));
+  auto itr(connections->find(peer_id));
+  if (itr != connections->end()) {
+    if ((*itr).second->Send(peer_id, std::move(message), message_sent_functor))
       return;
   }
+
+  std::lock_guard<std::mutex> lock(mutex_);
   LOG(kError) << "Can't send from " << DebugId(this_node_id_) << " to " << DebugId(peer_id)
               << " - not in map.";
   if (message_sent_functor) {
@@ -683,11 +693,10 @@ void ManagedConnections::Send(NodeId peer_id, std::string message,
   }
 }
 
-void ManagedConnections::OnMessageSlot(const std::string& message) {
+void ManagedConnections::OnMessageSlot(std::shared_ptr<const std::string> message) {
   LOG(kVerbose) << "\n^^^^^^^^^^^^ OnMessageSlot ^^^^^^^^^^^^\n" + DebugString();
 
   try {
-    auto copied_message(std::make_shared<std::string>(message));
     MessageReceivedFunctor local_callback;
     {
       std::lock_guard<std::mutex> guard(callback_mutex_);
@@ -695,7 +704,7 @@ void ManagedConnections::OnMessageSlot(const std::string& message) {
     }
 
     if (local_callback) {
-      asio_service_.service().post([=] { local_callback(*copied_message); });
+      asio_service_.service().post([=] { local_callback(*message); });
     }
   }
   catch (const std::exception& e) {
@@ -724,6 +733,7 @@ void ManagedConnections::OnConnectionAddedSlot(const NodeId& peer_id, TransportP
     is_duplicate_normal_connection = !inserted;
 
     if (inserted) {
+      PublishConnections();
       idle_transports_.erase(transport);
     } else {
       UpdateIdleTransports(transport);
@@ -787,6 +797,7 @@ void ManagedConnections::OnConnectionLostSlot(const NodeId& peer_id, TransportPt
     }
 
     connections_.erase(itr);
+    PublishConnections();
 
     if (peer_id == chosen_bootstrap_node_id_) {
       chosen_bootstrap_node_id_ = NodeId();
@@ -829,6 +840,11 @@ void ManagedConnections::OnNatDetectionRequestedSlot(const Endpoint& this_local_
   (*itr).second->Ping(peer_id, peer_endpoint, [](int) {});  // NOLINT (Fraser)
 }
 
+void ManagedConnections::PublishConnections() {
+  std::shared_ptr<const ConnectionMap> snapshot(std::make_shared<ConnectionMap>(connections_));
+  std::atomic_store(&connections_snapshot_, snapshot);
+}
+
 std::string ManagedConnections::DebugString() const {
   std::lock_guard<std::mutex> lock(mutex_);
   // Not interested in the log once accumulated enough connections
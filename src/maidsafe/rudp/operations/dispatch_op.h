@@ -21,12 +21,13 @@
 #ifndef MAIDSAFE_RUDP_OPERATIONS_DISPATCH_OP_H_
 #define MAIDSAFE_RUDP_OPERATIONS_DISPATCH_OP_H_
 
+#include <functional>
+#include <memory>
 #include <mutex>
-#include "boost/asio/buffer.hpp"
-#include "boost/asio/handler_alloc_hook.hpp"
 #include "boost/asio/handler_invoke_hook.hpp"
 #include "boost/system/error_code.hpp"
 #include "maidsafe/rudp/core/dispatcher.h"
+#include "maidsafe/rudp/core/multiplexer_backend.h"
 
 namespace maidsafe {
 
@@ -34,66 +35,54 @@ namespace rudp {
 
 namespace detail {
 
-// Helper class to perform an asynchronous dispatch operation.
+// Helper class to perform an asynchronous dispatch operation.  Once the backend's wait completes,
+// every datagram it has received is dispatched, and then the handler is called.
 template <typename DispatchHandler>
 class DispatchOp {
  public:
-  DispatchOp(DispatchHandler handler, boost::asio::ip::udp::socket& socket,
-             boost::asio::mutable_buffer buffer, boost::asio::ip::udp::endpoint& sender_endpoint,
-             Dispatcher& dispatcher)
+  DispatchOp(DispatchHandler handler, MultiplexerBackend& backend, Dispatcher& dispatcher)
       : handler_(std::move(handler)),
-        socket_(socket),
-        buffer_(std::move(buffer)),
+        backend_(backend),
         mutex_(std::make_shared<std::mutex>()),
-        sender_endpoint_(sender_endpoint),
         dispatcher_(dispatcher) {}
 
   DispatchOp(const DispatchOp& other)
       : handler_(other.handler_),
-        socket_(other.socket_),
-        buffer_(other.buffer_),
+        backend_(other.backend_),
         mutex_(other.mutex_),
-        sender_endpoint_(other.sender_endpoint_),
         dispatcher_(other.dispatcher_) {}
 
-  void operator()(const boost::system::error_code& ec, size_t bytes_transferred) {
-    boost::system::error_code local_ec = ec;
-    while (!local_ec) {
-      std::lock_guard<std::mutex> lock(*mutex_);
-      dispatcher_.HandleReceiveFrom(boost::asio::buffer(buffer_, bytes_transferred),
-                                    sender_endpoint_);
-      bytes_transferred =
-          socket_.receive_from(boost::asio::buffer(buffer_), sender_endpoint_, 0, local_ec);
-    }
-
-    handler_(ec);
-  }
-
-  friend void* asio_handler_allocate(size_t n, DispatchOp* op) {
-    using boost::asio::asio_handler_allocate;
-    return asio_handler_allocate(n, &op->handler_);
-  }
-
-  friend void asio_handler_deallocate(void* p, size_t n, DispatchOp* op) {
-    using boost::asio::asio_handler_deallocate;
-    asio_handler_deallocate(p, n, &op->handler_);
-  }
-
-  template <typename Function>
-  friend void asio_handler_invoke(Function f, DispatchOp* op) {
+  void operator()(const boost::system::error_code& ec) {
+    // The backend's wait may complete outside the handler's context (e.g. its strand), so the
+    // datagrams are dispatched via the handler's invocation hook.
     using boost::asio::asio_handler_invoke;
-    asio_handler_invoke(f, &op->handler_);
+    asio_handler_invoke(std::bind(&DispatchOp::Dispatch, *this, ec), &handler_);
   }
 
  private:
   // Disallow assignment.
   DispatchOp& operator=(const DispatchOp&);
 
+  void Dispatch(const boost::system::error_code& ec) {
+    boost::system::error_code local_ec = ec;
+    {
+      std::lock_guard<std::mutex> lock(*mutex_);
+      Dispatcher& dispatcher(dispatcher_);
+      MultiplexerBackend::ReceiveHandler dispatch(
+          [&dispatcher](const boost::asio::const_buffer& data,
+                        const boost::asio::ip::udp::endpoint& sender_endpoint,
+                        const SharedBufferPtr& buffer) {
+            dispatcher.HandleReceiveFrom(data, sender_endpoint, buffer);
+          });
+      while (!local_ec)
+        backend_.Receive(dispatch, local_ec);
+    }
+    handler_(ec);
+  }
+
   DispatchHandler handler_;
-  boost::asio::ip::udp::socket& socket_;
-  boost::asio::mutable_buffer buffer_;
+  MultiplexerBackend& backend_;
   std::shared_ptr<std::mutex> mutex_;
-  boost::asio::ip::udp::endpoint& sender_endpoint_;
   Dispatcher& dispatcher_;
 };
 
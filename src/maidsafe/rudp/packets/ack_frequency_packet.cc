@@ -0,0 +1,83 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/rudp/packets/ack_frequency_packet.h"
+
+#include <vector>
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+AckFrequencyPacket::AckFrequencyPacket() : ack_interval_(0), ack_delay_(0) {
+  SetType(kPacketType);
+}
+
+uint32_t AckFrequencyPacket::RequestSequenceNumber() const { return AdditionalInfo(); }
+
+void AckFrequencyPacket::SetRequestSequenceNumber(uint32_t n) { SetAdditionalInfo(n); }
+
+uint32_t AckFrequencyPacket::AckInterval() const { return ack_interval_; }
+
+void AckFrequencyPacket::SetAckInterval(uint32_t packets) { ack_interval_ = packets; }
+
+uint32_t AckFrequencyPacket::AckDelay() const { return ack_delay_; }
+
+void AckFrequencyPacket::SetAckDelay(uint32_t microseconds) { ack_delay_ = microseconds; }
+
+bool AckFrequencyPacket::IsValid(const boost::asio::const_buffer& buffer) {
+  return (IsValidBase(buffer, kPacketType) && (boost::asio::buffer_size(buffer) == kPacketSize));
+}
+
+bool AckFrequencyPacket::Decode(const boost::asio::const_buffer& buffer) {
+  // Refuse to decode if the input buffer is not valid.
+  if (!IsValid(buffer))
+    return false;
+
+  // Decode the common parts of the control packet.
+  if (!DecodeBase(buffer, kPacketType))
+    return false;
+
+  const unsigned char* p = boost::asio::buffer_cast<const unsigned char*>(buffer) + kHeaderSize;
+  DecodeUint32(&ack_interval_, p);
+  DecodeUint32(&ack_delay_, p + 4);
+  return true;
+}
+
+size_t AckFrequencyPacket::Encode(std::vector<boost::asio::mutable_buffer>& buffers) const {
+  // Refuse to encode if the output buffer is not big enough.
+  if (boost::asio::buffer_size(buffers[0]) < kPacketSize)
+    return 0;
+
+  // Encode the common parts of the control packet.
+  if (EncodeBase(buffers) == 0)
+    return 0;
+
+  unsigned char* p = boost::asio::buffer_cast<unsigned char*>(buffers[0]) + kHeaderSize;
+  EncodeUint32(ack_interval_, p);
+  EncodeUint32(ack_delay_, p + 4);
+  return kPacketSize;
+}
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
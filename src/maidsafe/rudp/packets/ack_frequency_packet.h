@@ -0,0 +1,73 @@
+/*  Copyright 2014 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_RUDP_PACKETS_ACK_FREQUENCY_PACKET_H_
+#define MAIDSAFE_RUDP_PACKETS_ACK_FREQUENCY_PACKET_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "boost/asio/buffer.hpp"
+#include "maidsafe/rudp/packets/control_packet.h"
+
+namespace maidsafe {
+
+namespace rudp {
+
+namespace detail {
+
+// Sent by a sender to ask its peer to acknowledge data packets at a given frequency: after at most
+// AckInterval packets, or AckDelay microseconds after the first unacknowledged one arrived.
+// Requests are numbered so that one which arrives out of order can be ignored.
+class AckFrequencyPacket : public ControlPacket {
+ public:
+  enum {
+    kPacketSize = ControlPacket::kHeaderSize + 8
+  };
+  enum {
+    kPacketType = 7
+  };
+
+  AckFrequencyPacket();
+  virtual ~AckFrequencyPacket() {}
+
+  uint32_t RequestSequenceNumber() const;
+  void SetRequestSequenceNumber(uint32_t n);
+
+  uint32_t AckInterval() const;
+  void SetAckInterval(uint32_t packets);
+
+  uint32_t AckDelay() const;
+  void SetAckDelay(uint32_t microseconds);
+
+  static bool IsValid(const boost::asio::const_buffer& buffer);
+  bool Decode(const boost::asio::const_buffer& buffer);
+  size_t Encode(std::vector<boost::asio::mutable_buffer>& buffers) const;
+
+ private:
+  uint32_t ack_interval_;
+  uint32_t ack_delay_;
+};
+
+}  // namespace detail
+
+}  // namespace rudp
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_RUDP_PACKETS_ACK_FREQUENCY_PACKET_H_
@@ -40,7 +40,11 @@ DataPacket::DataPacket()
       message_number_(0),
       time_stamp_(0),
       destination_socket_id_(0),
-      data_() {}
+      data_(),
+      buffer_(),
+      payload_(),
+      prefix_(),
+      prefix_size_(0) {}
 
 uint32_t DataPacket::PacketSequenceNumber() const { return packet_sequence_number_; }
 
@@ -76,9 +80,38 @@ uint32_t DataPacket::DestinationSocketId() const { return destination_socket_id_
 
 void DataPacket::SetDestinationSocketId(uint32_t n) { destination_socket_id_ = n; }
 
-const std::string& DataPacket::Data() const { return data_; }
+std::string DataPacket::Data() const {
+  boost::asio::const_buffer payload(Payload());
+  const char* begin = boost::asio::buffer_cast<const char*>(payload);
+  std::string data(prefix_.begin(), prefix_.begin() + prefix_size_);
+  data.append(begin, begin + boost::asio::buffer_size(payload));
+  return data;
+}
+
+boost::asio::const_buffer DataPacket::Payload() const {
+  return buffer_ ? payload_ : boost::asio::const_buffer(data_.data(), data_.size());
+}
+
+void DataPacket::SetData(const std::string& data) {
+  data_ = data;
+  buffer_.reset();
+  prefix_size_ = 0;
+}
 
-void DataPacket::SetData(const std::string& data) { data_ = data; }
+void DataPacket::SetData(const SharedBufferPtr& buffer, const boost::asio::const_buffer& payload) {
+  assert(buffer);
+  data_.clear();
+  buffer_ = buffer;
+  payload_ = payload;
+  prefix_size_ = 0;
+}
+
+void DataPacket::SetData(const boost::asio::const_buffer& prefix, const SharedBufferPtr& buffer,
+                         const boost::asio::const_buffer& payload) {
+  assert(boost::asio::buffer_size(prefix) <= kMaxPrefixSize);
+  SetData(buffer, payload);
+  prefix_size_ = boost::asio::buffer_copy(boost::asio::buffer(prefix_), prefix);
+}
 
 bool DataPacket::IsValid(const boost::asio::const_buffer& buffer) {
   return ((boost::asio::buffer_size(buffer) >= 16) &&
@@ -86,6 +119,11 @@ bool DataPacket::IsValid(const boost::asio::const_buffer& buffer) {
 }
 
 bool DataPacket::Decode(const boost::asio::const_buffer& buffer) {
+  return Decode(buffer, SharedBufferPtr());
+}
+
+bool DataPacket::Decode(const boost::asio::const_buffer& buffer,
+                        const SharedBufferPtr& received_buffer) {
   // Refuse to decode if the input buffer is not valid.
   if (!IsValid(buffer))
     return false;
@@ -106,14 +144,19 @@ bool DataPacket::Decode(const boost::asio::const_buffer& buffer) {
   message_number_ = ((message_number_ << 8) | p[7]);
   DecodeUint32(&time_stamp_, p + 8);
   DecodeUint32(&destination_socket_id_, p + 12);
-  data_.assign(p + 16, p + length);
+  if (received_buffer)
+    SetData(received_buffer, boost::asio::const_buffer(p + kHeaderSize, length - kHeaderSize));
+  else
+    SetData(p + kHeaderSize, p + length);
 
   return true;
 }
 
 size_t DataPacket::Encode(std::vector<boost::asio::mutable_buffer>& buffers) const {
   // Refuse to encode if the output buffer is not big enough.
-  if (boost::asio::buffer_size(buffers[0]) < kHeaderSize + data_.size())
+  boost::asio::const_buffer payload(Payload());
+  size_t payload_size(boost::asio::buffer_size(payload));
+  if (boost::asio::buffer_size(buffers[0]) < kHeaderSize + prefix_size_ + payload_size)
     return 0;
 
   unsigned char* p = boost::asio::buffer_cast<unsigned char*>(buffers[0]);
@@ -131,20 +174,22 @@ size_t DataPacket::Encode(std::vector<boost::asio::mutable_buffer>& buffers) con
   p[7] = (message_number_ & 0xff);
   EncodeUint32(time_stamp_, p + 8);
   EncodeUint32(destination_socket_id_, p + 12);
+  // The prefix is small enough to travel with the header.
+  std::memcpy(p + kHeaderSize, prefix_.data(), prefix_size_);
   // std::memcpy(p + kHeaderSize, data_.data(), data_.size());
   // 2014-8-25 ned: Split into a gather op
   buffers.pop_back();
-  buffers.push_back(boost::asio::mutable_buffer(p, kHeaderSize));
+  buffers.push_back(boost::asio::mutable_buffer(p, kHeaderSize + prefix_size_));
   // Actually const safe as buffer is only used for sending
   buffers.push_back(boost::asio::mutable_buffer(
-    reinterpret_cast<unsigned char *>(const_cast<char *>(data_.data())),
-    data_.size()));
+    const_cast<unsigned char *>(boost::asio::buffer_cast<const unsigned char *>(payload)),
+    payload_size));
 
   // LOG(kVerbose) << "Sending DataPacket to " << DestinationSocketId()
   //               << " pkt seq " << packet_sequence_number_ << " msg no "
   //               << message_number_ << " length "
-  //               << (kHeaderSize + data_.size());
-  return kHeaderSize + data_.size();
+  //               << (kHeaderSize + prefix_size_ + payload_size);
+  return kHeaderSize + prefix_size_ + payload_size;
 }
 
 }  // namespace detail
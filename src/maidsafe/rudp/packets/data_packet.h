@@ -21,6 +21,7 @@
 #ifndef MAIDSAFE_RUDP_PACKETS_DATA_PACKET_H_
 #define MAIDSAFE_RUDP_PACKETS_DATA_PACKET_H_
 
+#include <array>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -28,6 +29,7 @@
 #include "boost/asio/buffer.hpp"
 #include "boost/system/error_code.hpp"
 
+#include "maidsafe/rudp/core/shared_buffer.h"
 #include "maidsafe/rudp/packets/packet.h"
 
 namespace maidsafe {
@@ -39,7 +41,8 @@ namespace detail {
 class DataPacket : public Packet {
  public:
   enum {
-    kHeaderSize = 16
+    kHeaderSize = 16,
+    kMaxPrefixSize = 8
   };
 
   DataPacket();
@@ -65,16 +68,35 @@ class DataPacket : public Packet {
   uint32_t DestinationSocketId() const;
   void SetDestinationSocketId(uint32_t n);
 
-  const std::string& Data() const;
+  // A copy of the payload.  Payload() gives access to it without copying, apart from any prefix
+  // (see SetData), which it excludes.
+  std::string Data() const;
+  boost::asio::const_buffer Payload() const;
+  // The buffer within which Payload() lies, or null if the packet holds a copy of its payload.
+  const SharedBufferPtr& Buffer() const { return buffer_; }
+
   void SetData(const std::string& data);
 
   template <typename Iterator>
   void SetData(Iterator begin, Iterator end) {
     data_.assign(begin, end);
+    buffer_.reset();
+    prefix_size_ = 0;
   }
 
+  // Refer to payload, which lies within buffer, rather than copying it.  buffer is kept alive until
+  // the packet is destroyed or its payload is replaced.
+  void SetData(const SharedBufferPtr& buffer, const boost::asio::const_buffer& payload);
+  // As above, but the payload starts with prefix, of at most kMaxPrefixSize bytes, which is copied.
+  // This lets e.g. a message's size precede it without copying the message itself.
+  void SetData(const boost::asio::const_buffer& prefix, const SharedBufferPtr& buffer,
+               const boost::asio::const_buffer& payload);
+
   static bool IsValid(const boost::asio::const_buffer& buffer);
   bool Decode(const boost::asio::const_buffer& buffer);
+  // Decode from buffer, which lies within received_buffer.  If received_buffer is non-null, the
+  // payload refers to it rather than being copied (see SetData).
+  bool Decode(const boost::asio::const_buffer& buffer, const SharedBufferPtr& received_buffer);
   size_t Encode(std::vector<boost::asio::mutable_buffer>& buffer) const;
 
  private:
@@ -85,7 +107,13 @@ class DataPacket : public Packet {
   uint32_t message_number_;
   uint32_t time_stamp_;
   uint32_t destination_socket_id_;
+  // The payload is held by data_ unless buffer_ is non-null, in which case it is payload_, which
+  // lies within buffer_.  Either way, it's preceded by the first prefix_size_ bytes of prefix_.
   std::string data_;
+  SharedBufferPtr buffer_;
+  boost::asio::const_buffer payload_;
+  std::array<unsigned char, kMaxPrefixSize> prefix_;
+  size_t prefix_size_;
 };
 
 }  // namespace detail
@@ -28,11 +28,14 @@ namespace rudp {
 
 namespace detail {
 
-NegativeAckPacket::NegativeAckPacket() : sequence_numbers_() { SetType(kPacketType); }
+NegativeAckPacket::NegativeAckPacket() : sequence_numbers_(), ranges_() {
+  SetType(kPacketType);
+}
 
 void NegativeAckPacket::AddSequenceNumber(uint32_t n) {
   assert(n <= 0x7fffffff);
   sequence_numbers_.push_back(n);
+  ranges_.push_back(std::make_pair(n, n));
 }
 
 void NegativeAckPacket::AddSequenceNumbers(uint32_t first, uint32_t last) {
@@ -40,6 +43,17 @@ void NegativeAckPacket::AddSequenceNumbers(uint32_t first, uint32_t last) {
   assert(last <= 0x7fffffff);
   sequence_numbers_.push_back(first | 0x80000000);
   sequence_numbers_.push_back(last);
+  AddRange(first, last);
+}
+
+void NegativeAckPacket::AddRange(uint32_t first, uint32_t last) {
+  if (first <= last) {
+    ranges_.push_back(std::make_pair(first, last));
+  } else {
+    // The range wraps around past the maximum sequence number.
+    ranges_.push_back(std::make_pair(first, 0x7fffffff));
+    ranges_.push_back(std::make_pair(0, last));
+  }
 }
 
 bool NegativeAckPacket::IsValid(const boost::asio::const_buffer& buffer) {
@@ -49,30 +63,19 @@ bool NegativeAckPacket::IsValid(const boost::asio::const_buffer& buffer) {
 
 bool NegativeAckPacket::ContainsSequenceNumber(uint32_t n) const {
   assert(n <= 0x7fffffff);
-  for (size_t i = 0; i < sequence_numbers_.size(); ++i) {
-    if (((sequence_numbers_[i] & 0x80000000) != 0) && (i + 1 < sequence_numbers_.size())) {
-      // This is a range.
-      uint32_t first = (sequence_numbers_[i] & 0x7fffffff);
-      uint32_t last = (sequence_numbers_[i + 1] & 0x7fffffff);
-      if (first <= last) {
-        if ((first <= n) && (n <= last))
-          return true;
-      } else {
-        // The range wraps around past the maximum sequence number.
-        if (((first <= n) && (n <= 0x7fffffff)) || (n <= last))
-          return true;
-      }
-    } else {
-      // This is a single sequence number.
-      if ((sequence_numbers_[i] & 0x7fffffff) == n)
-        return true;
-    }
+  for (const auto& range : ranges_) {
+    if ((range.first <= n) && (n <= range.second))
+      return true;
   }
   return false;
 }
 
 bool NegativeAckPacket::HasSequenceNumbers() const { return !sequence_numbers_.empty(); }
 
+const std::vector<std::pair<uint32_t, uint32_t>>& NegativeAckPacket::GetSequenceRanges() const {
+  return ranges_;
+}
+
 bool NegativeAckPacket::Decode(const boost::asio::const_buffer& buffer) {
   // Refuse to decode if the input buffer is not valid.
   if (!IsValid(buffer))
@@ -87,12 +90,24 @@ bool NegativeAckPacket::Decode(const boost::asio::const_buffer& buffer) {
   p += kHeaderSize;
 
   sequence_numbers_.clear();
+  sequence_numbers_.reserve(length / 4);
   for (size_t i = 0; i < length; i += 4) {
     uint32_t value = 0;
     DecodeUint32(&value, p + i);
     sequence_numbers_.push_back(value);
   }
 
+  ranges_.clear();
+  for (size_t i = 0; i < sequence_numbers_.size(); ++i) {
+    if (((sequence_numbers_[i] & 0x80000000) != 0) && (i + 1 < sequence_numbers_.size())) {
+      AddRange(sequence_numbers_[i] & 0x7fffffff, sequence_numbers_[i + 1] & 0x7fffffff);
+      ++i;
+    } else {
+      uint32_t n = (sequence_numbers_[i] & 0x7fffffff);
+      ranges_.push_back(std::make_pair(n, n));
+    }
+  }
+
   return true;
 }
 
@@ -21,6 +21,7 @@
 #ifndef MAIDSAFE_RUDP_PACKETS_NEGATIVE_ACK_PACKET_H_
 #define MAIDSAFE_RUDP_PACKETS_NEGATIVE_ACK_PACKET_H_
 
+#include <utility>
 #include <vector>
 
 #include "boost/asio/buffer.hpp"
@@ -45,13 +46,22 @@ class NegativeAckPacket : public ControlPacket {
   void AddSequenceNumbers(uint32_t first, uint32_t last);
   bool ContainsSequenceNumber(uint32_t n) const;
   bool HasSequenceNumbers() const;
+  // The sequence numbers as inclusive ranges, none of which wraps around past the maximum sequence
+  // number.  Ranges may overlap.
+  const std::vector<std::pair<uint32_t, uint32_t>>& GetSequenceRanges() const;
 
   static bool IsValid(const boost::asio::const_buffer& buffer);
   bool Decode(const boost::asio::const_buffer& buffer);
   size_t Encode(std::vector<boost::asio::mutable_buffer>& buffers) const;
 
  private:
+  // Adds the range to ranges_, splitting it in two if it wraps around.
+  void AddRange(uint32_t first, uint32_t last);
+
+  // The encoded form, in which a value with its top bit set starts a range ending at the next.
   std::vector<uint32_t> sequence_numbers_;
+  // The same sequence numbers decoded into ranges.
+  std::vector<std::pair<uint32_t, uint32_t>> ranges_;
 };
 
 }  // namespace detail
@@ -37,6 +37,19 @@ bool Packet::DecodeDestinationSocketId(uint32_t* id, const boost::asio::const_bu
   return true;
 }
 
+bool Packet::DecodeType(uint16_t* type, const boost::asio::const_buffer& data) {
+  // Data and control packet headers are both 16 bytes.
+  if (boost::asio::buffer_size(data) < 16)
+    return false;
+
+  const unsigned char* p = boost::asio::buffer_cast<const unsigned char*>(data);
+  if ((p[0] & 0x80) == 0)
+    *type = kDataPacketType;
+  else
+    *type = static_cast<uint16_t>(((p[0] & 0x7f) << 8) | p[1]);
+  return true;
+}
+
 void Packet::DecodeUint32(uint32_t* n, const unsigned char* p) {
   *n = p[0];
   *n = ((*n << 8) | p[1]);
@@ -33,9 +33,19 @@ namespace detail {
 
 class Packet {
  public:
+  // Control packet types are 15 bits, so this never clashes with one.
+  enum {
+    kDataPacketType = 0x8000
+  };
+
   // Get the destination socket id from an encoded packet.
   static bool DecodeDestinationSocketId(uint32_t* id, const boost::asio::const_buffer& data);
 
+  // Get the type of an encoded packet from its first two bytes: kDataPacketType for a data packet,
+  // otherwise the control packet's type.  Only the header's length is checked, so the packet may
+  // still fail to decode as that type.
+  static bool DecodeType(uint16_t* type, const boost::asio::const_buffer& data);
+
  protected:
   // Prevent deletion through this type.
   virtual ~Packet();
@@ -27,6 +27,7 @@
 #include "maidsafe/rudp/packets/handshake_packet.h"
 #include "maidsafe/rudp/packets/keepalive_packet.h"
 #include "maidsafe/rudp/packets/shutdown_packet.h"
+#include "maidsafe/rudp/packets/ack_frequency_packet.h"
 #include "maidsafe/rudp/packets/ack_of_ack_packet.h"
 #include "maidsafe/rudp/packets/negative_ack_packet.h"
 #include "maidsafe/rudp/parameters.h"
@@ -59,6 +60,38 @@ TEST(PacketTest, BEH_DecodeDestinationSocketId) {
   }
 }
 
+TEST(PacketTest, BEH_DecodeType) {
+  uint16_t type(0);
+  {
+    // Try to decode with an invalid buffer
+    char char_array[15] = {0};
+    EXPECT_FALSE(Packet::DecodeType(&type, boost::asio::buffer(char_array)));
+  }
+  {
+    // A data packet
+    char char_array[16] = {0};
+    char_array[0] = 0x7f;
+    char_array[1] = 0x06;
+    EXPECT_TRUE(Packet::DecodeType(&type, boost::asio::buffer(char_array)));
+    EXPECT_EQ(Packet::kDataPacketType, type);
+  }
+  {
+    // Control packets
+    char char_array[AckPacket::kPacketSize] = {0};
+    std::vector<boost::asio::mutable_buffer> dbuffers;
+    dbuffers.push_back(boost::asio::buffer(char_array));
+    AckPacket ack_packet;
+    EXPECT_EQ(static_cast<size_t>(AckPacket::kPacketSize), ack_packet.Encode(dbuffers));
+    EXPECT_TRUE(Packet::DecodeType(&type, dbuffers[0]));
+    EXPECT_EQ(AckPacket::kPacketType, type);
+
+    char_array[0] = static_cast<char>(0x81);
+    char_array[1] = 0x02;
+    EXPECT_TRUE(Packet::DecodeType(&type, boost::asio::buffer(char_array)));
+    EXPECT_EQ(0x0102, type);
+  }
+}
+
 class DataPacketTest : public testing::Test {
  public:
   DataPacketTest() : data_packet_() {}
@@ -227,6 +260,73 @@ TEST_F(DataPacketTest, BEH_EncodeDecode) {
   }
 }
 
+TEST_F(DataPacketTest, BEH_DecodeFromReceiveBuffer) {
+  std::string data("Receive Buffer Test");
+  data_packet_.SetData(data);
+  data_packet_.SetPacketSequenceNumber(123);
+  auto pool(SharedBufferPool::Create(Parameters::max_size, 1));
+  SharedBufferPtr buffer(pool->Acquire());
+  std::vector<boost::asio::mutable_buffer> buffers;
+  buffers.push_back(boost::asio::buffer(buffer->Data(), buffer->Capacity()));
+  size_t length(data_packet_.Encode(buffers));
+  ASSERT_EQ(DataPacket::kHeaderSize + data.size(), length);
+  memcpy(buffer->Data() + DataPacket::kHeaderSize, data.data(), data.size());
+  const unsigned char* received_data(buffer->Data());
+
+  {
+    // The decoded payload refers to the received buffer rather than being copied.
+    DataPacket packet;
+    EXPECT_TRUE(packet.Decode(boost::asio::buffer(buffer->Data(), length), buffer));
+    EXPECT_FALSE(buffer->IsUnique());
+    EXPECT_EQ(received_data + DataPacket::kHeaderSize,
+              boost::asio::buffer_cast<const unsigned char*>(packet.Payload()));
+    EXPECT_EQ(data, packet.Data());
+    EXPECT_EQ(123U, packet.PacketSequenceNumber());
+    DataPacket copy(packet);
+    packet.SetData("Replaced");
+    EXPECT_EQ(data, copy.Data());
+  }
+  EXPECT_TRUE(buffer->IsUnique());
+
+  // Once released, the buffer is reused.
+  buffer.reset();
+  EXPECT_EQ(received_data, pool->Acquire()->Data());
+}
+
+TEST_F(DataPacketTest, BEH_EncodeWithPrefix) {
+  // The message is long enough not to be held inside the string, so it's adopted without copying.
+  const std::string kPrefix("size"), kData(100, 'd');
+  std::string message(kData);
+  const char* message_data(message.data());
+  SharedBufferPtr buffer(SharedBuffer::Adopt(std::move(message)));
+  ASSERT_EQ(kData.size(), buffer->Capacity());
+  EXPECT_EQ(message_data, reinterpret_cast<const char*>(buffer->Data()));
+
+  data_packet_.SetData(boost::asio::buffer(kPrefix), buffer,
+                       boost::asio::buffer(buffer->Data(), buffer->Capacity()));
+  EXPECT_EQ(kPrefix + kData, data_packet_.Data());
+  EXPECT_EQ(buffer->Data(), boost::asio::buffer_cast<const unsigned char*>(data_packet_.Payload()));
+
+  // The prefix travels with the header, while the payload is gathered from the shared buffer.
+  char char_array[Parameters::kUDPPayload] = {0};
+  std::vector<boost::asio::mutable_buffer> buffers;
+  buffers.push_back(boost::asio::buffer(char_array));
+  size_t length(data_packet_.Encode(buffers));
+  ASSERT_EQ(DataPacket::kHeaderSize + kPrefix.size() + kData.size(), length);
+  ASSERT_EQ(2U, buffers.size());
+  EXPECT_EQ(DataPacket::kHeaderSize + kPrefix.size(), boost::asio::buffer_size(buffers[0]));
+  EXPECT_EQ(buffer->Data(), boost::asio::buffer_cast<const unsigned char*>(buffers[1]));
+  memcpy(char_array + boost::asio::buffer_size(buffers[0]), buffer->Data(), buffer->Capacity());
+
+  DataPacket packet;
+  EXPECT_TRUE(packet.Decode(boost::asio::buffer(char_array, length)));
+  EXPECT_EQ(kPrefix + kData, packet.Data());
+
+  // Replacing the payload drops the prefix.
+  data_packet_.SetData("Replaced");
+  EXPECT_EQ("Replaced", data_packet_.Data());
+}
+
 class ControlPacketTest : public testing::Test {
  public:
   ControlPacketTest() : control_packet_() {}
@@ -678,6 +778,43 @@ TEST(AckOfAckPacketTest, BEH_All) {
   }
 }
 
+TEST(AckFrequencyPacketTest, BEH_All) {
+  AckFrequencyPacket ack_frequency_packet;
+  {
+    // Buffer length wrong
+    char char_array[AckFrequencyPacket::kPacketSize - 1] = {0};
+    char_array[0] = static_cast<unsigned char>(0x80);
+    char_array[1] = AckFrequencyPacket::kPacketType;
+    EXPECT_FALSE(ack_frequency_packet.Decode(boost::asio::buffer(char_array)));
+  }
+  char char_array[AckFrequencyPacket::kPacketSize] = {0};
+  char_array[0] = static_cast<unsigned char>(0x80);
+  {
+    // Packet type wrong
+    char_array[1] = AckOfAckPacket::kPacketType;
+    EXPECT_FALSE(ack_frequency_packet.Decode(boost::asio::buffer(char_array)));
+  }
+  {
+    // Encode then Decode
+    ack_frequency_packet.SetRequestSequenceNumber(0xfffffffe);
+    ack_frequency_packet.SetAckInterval(32);
+    ack_frequency_packet.SetAckDelay(25000);
+    std::vector<boost::asio::mutable_buffer> dbuffers;
+    dbuffers.push_back(boost::asio::buffer(char_array));
+    EXPECT_EQ(AckFrequencyPacket::kPacketSize, ack_frequency_packet.Encode(dbuffers));
+
+    AckFrequencyPacket decoded_packet;
+    EXPECT_TRUE(decoded_packet.Decode(dbuffers[0]));
+    EXPECT_EQ(0xfffffffe, decoded_packet.RequestSequenceNumber());
+    EXPECT_EQ(32U, decoded_packet.AckInterval());
+    EXPECT_EQ(25000U, decoded_packet.AckDelay());
+
+    uint16_t type(0);
+    EXPECT_TRUE(Packet::DecodeType(&type, dbuffers[0]));
+    EXPECT_EQ(AckFrequencyPacket::kPacketType, type);
+  }
+}
+
 class NegativeAckPacketTest : public testing::Test {
  public:
   NegativeAckPacketTest() : negative_ack_packet_() {}
@@ -800,6 +937,13 @@ TEST_F(NegativeAckPacketTest, BEH_EncodeDecode) {
 #ifdef NDEBUG
     EXPECT_FALSE(negative_ack_packet_.ContainsSequenceNumber(0x80000000));
 #endif
+
+    // The wrapped range is split at the maximum sequence number.
+    std::vector<std::pair<uint32_t, uint32_t>> ranges(negative_ack_packet_.GetSequenceRanges());
+    ASSERT_EQ(3U, ranges.size());
+    EXPECT_EQ(std::make_pair(0x8U, 0x8U), ranges[0]);
+    EXPECT_EQ(std::make_pair(0x7fffffffU, 0x7fffffffU), ranges[1]);
+    EXPECT_EQ(std::make_pair(0x0U, 0x5U), ranges[2]);
   }
 }
 
@@ -25,10 +25,12 @@ namespace maidsafe {
 namespace rudp {
 
 uint32_t Parameters::thread_count(1);
+uint32_t Parameters::multiplexer_shards(1);
 int Parameters::max_transports(10);
 const uint32_t Parameters::maximum_segment_size(16);
 uint32_t Parameters::default_window_size(4*Parameters::maximum_segment_size);
 uint32_t Parameters::maximum_window_size(32*Parameters::maximum_segment_size);
+uint32_t Parameters::maximum_receive_buffer_size(4 * 1024 * 1024);
 uint32_t Parameters::default_burst_send_size(1);
 uint32_t Parameters::default_size(1480);
 
@@ -42,12 +44,22 @@ uint32_t Parameters::max_size(8192);
 uint32_t Parameters::max_data_size(8162);
 // #endif
 uint32_t Parameters::default_data_size(1450);
+uint32_t Parameters::receive_batch_size(32);
+uint32_t Parameters::transmit_batch_size(16);
+bool Parameters::udp_segmentation_offload(false);
+bool Parameters::udp_receive_offload(false);
+bool Parameters::zero_copy_send(false);
+uint32_t Parameters::zero_copy_threshold(4096);
+Parameters::MultiplexerBackendType Parameters::multiplexer_backend(Parameters::kAsioBackend);
 Timeout Parameters::default_send_timeout(bptime::milliseconds(300));
 Timeout Parameters::default_receive_timeout(bptime::milliseconds(500));
+Parameters::LossRecoveryMode Parameters::loss_recovery_mode(Parameters::kSenderTimeout);
 Timeout Parameters::default_send_delay(bptime::milliseconds(10));
 Timeout Parameters::default_receive_delay(bptime::milliseconds(100));
 Timeout Parameters::default_ack_timeout(bptime::seconds(1));
 Timeout Parameters::ack_interval(bptime::milliseconds(100));
+uint32_t Parameters::maximum_ack_interval(64);
+Timeout Parameters::maximum_ack_delay(bptime::milliseconds(25));
 Timeout Parameters::speed_calculate_inverval(bptime::seconds(10));
 uint32_t Parameters::slow_speed_threshold(1024);
 Timeout Parameters::rendezvous_connect_timeout(bptime::seconds(15));
@@ -16,28 +16,784 @@
     See the Licences for the specific language governing permissions and limitations relating to
     use of the MaidSafe Software.                                                                 */
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <fstream>
 
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/udp.hpp"
+
 #include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
 
 #include "maidsafe/rudp/managed_connections.h"
+#include "maidsafe/rudp/parameters.h"
 #include "maidsafe/rudp/return_codes.h"
+#include "maidsafe/rudp/core/io_uring_backend.h"
+#include "maidsafe/rudp/core/multiplexer.h"
+#include "maidsafe/rudp/core/multiplexer_backend.h"
+#include "maidsafe/rudp/core/peer.h"
+#include "maidsafe/rudp/core/receive_batch.h"
+#include "maidsafe/rudp/core/shared_buffer.h"
+#include "maidsafe/rudp/core/sliding_window.h"
+#include "maidsafe/rudp/core/socket.h"
+#include "maidsafe/rudp/core/socket_index.h"
+#include "maidsafe/rudp/core/transmit_batch.h"
+#include "maidsafe/rudp/core/zero_copy_tracker.h"
+#include "maidsafe/rudp/packets/data_packet.h"
 #include "maidsafe/rudp/tests/test_utils.h"
 
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+
 namespace {
 
+// The most datagrams a benchmark sender keeps in flight to a fabric backend, half of what a port's
+// queue holds.
+const int kFabricWindow(256);
+
+// Blast packet_count equal-sized datagrams over loopback (using segmentation offload if available)
+// and drain them using a receive batch, with or without receive coalescing.  As in the asio
+// backend, coalesced datagrams are copied out into buffers of their own.  Returns the number of
+// datagrams received per second, or -1 if coalescing is unsupported.
+double MeasureReceiveRate(int packet_count, bool coalesce, int& received) {
+  const size_t kDatagramSize(1400);
+  asio::io_service io_service;
+  ip::udp::socket sender(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  ip::udp::socket receiver(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  receiver.set_option(asio::socket_base::receive_buffer_size(8 * 1024 * 1024));
+  ip::udp::endpoint receiver_endpoint(receiver.local_endpoint());
+
+  maidsafe::rudp::detail::ReceiveBatch receive_batch(
+      std::max(maidsafe::rudp::Parameters::receive_batch_size, 1U));
+  if (coalesce && !receive_batch.EnableCoalescing(receiver))
+    return -1;
+  auto copy_pool(maidsafe::rudp::detail::SharedBufferPool::Create(
+      maidsafe::rudp::Parameters::max_size, 64));
+
+  std::atomic<bool> sent(false);
+  std::thread sending([&] {
+    maidsafe::rudp::detail::TransmitBatch transmit_batch(64);
+    size_t segment_limit(maidsafe::rudp::detail::TransmitBatch::SegmentationSupported(sender)
+                             ? maidsafe::rudp::Parameters::kUDPPayload : 0);
+    std::vector<asio::mutable_buffer> buffers(1);
+    boost::system::error_code ec;
+    for (int i(0); i != packet_count; ++i) {
+      if (transmit_batch.IsFull())
+        transmit_batch.Send(sender, segment_limit, nullptr, ec);
+      buffers[0] = asio::buffer(transmit_batch.NextBuffer(), kDatagramSize);
+      transmit_batch.Push(buffers, receiver_endpoint);
+    }
+    transmit_batch.Send(sender, segment_limit, nullptr, ec);
+    sent = true;
+  });
+
+  received = 0;
+  auto start_point(std::chrono::steady_clock::now());
+  auto last_receipt(start_point);
+  boost::system::error_code ec;
+  while (received < packet_count) {
+    size_t count(receive_batch.Receive(receiver, ec));
+    if (count == 0) {
+      // Anything not received shortly after the sender finishes was dropped by the kernel.
+      if (sent && std::chrono::steady_clock::now() - last_receipt > std::chrono::milliseconds(200))
+        break;
+      continue;
+    }
+    last_receipt = std::chrono::steady_clock::now();
+    for (size_t i(0); i != count; ++i) {
+      if (!coalesce) {
+        ++received;
+        continue;
+      }
+      const unsigned char* data(asio::buffer_cast<const unsigned char*>(receive_batch.Data(i)));
+      size_t length(asio::buffer_size(receive_batch.Data(i)));
+      size_t segment_size(receive_batch.SegmentSize(i) ? receive_batch.SegmentSize(i) : length);
+      for (size_t offset(0); offset < length; offset += segment_size, ++received) {
+        maidsafe::rudp::detail::SharedBufferPtr copy(copy_pool->Acquire());
+        asio::buffer_copy(asio::buffer(copy->Data(), copy->Capacity()),
+                          asio::buffer(data + offset, std::min(segment_size, length - offset)));
+      }
+    }
+  }
+  sending.join();
+
+  auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(last_receipt - start_point));
+  return elapsed.count() ? received * 1000000.0 / elapsed.count() : 0;
+}
+
+int RunReceiveOffloadBenchmark(int packet_count) {
+  TLOG(kDefaultColour) << "Receiving " << packet_count << " datagrams over loopback.\n";
+  for (bool coalesce : {false, true}) {
+    int received(0);
+    double rate(MeasureReceiveRate(packet_count, coalesce, received));
+    if (rate < 0) {
+      TLOG(kDefaultColour) << "UDP receive offload is not supported.\n";
+      continue;
+    }
+    TLOG(kDefaultColour) << "GRO " << (coalesce ? "on: " : "off:") << " received " << received
+                         << " datagrams at " << static_cast<intmax_t>(rate) << " packets/sec.\n";
+  }
+  return 0;
+}
+
+// Have thread_count threads, each with its own peer, send packet_count data packets apiece through
+// a single multiplexer to a loopback sink.  Returns the total number of packets sent per second.
+double MeasureSendRate(int thread_count, int packet_count) {
+  asio::io_service io_service;
+  ip::udp::socket sink(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  maidsafe::rudp::detail::Multiplexer multiplexer(io_service);
+  if (multiplexer.Open(ip::udp::endpoint(ip::address_v4::loopback(), 0)) !=
+      maidsafe::rudp::kSuccess) {
+    return -1;
+  }
+
+  maidsafe::rudp::detail::DataPacket packet;
+  packet.SetData(std::string(1400, 'x'));
+  std::atomic<int> ready(0);
+  std::vector<std::thread> senders;
+  for (int i(0); i != thread_count; ++i) {
+    senders.emplace_back([&] {
+      maidsafe::rudp::detail::Peer peer(multiplexer);
+      peer.SetPeerEndpoint(sink.local_endpoint());
+      ++ready;
+      while (ready != thread_count) {}
+      for (int j(0); j != packet_count; ++j)
+        peer.Send(packet);
+    });
+  }
+  while (ready != thread_count) {}
+  auto start_point(std::chrono::steady_clock::now());
+  for (auto& sender : senders)
+    sender.join();
+  auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_point));
+  multiplexer.Close();
+  return elapsed.count() ? thread_count * packet_count * 1000000.0 / elapsed.count() : 0;
+}
+
+int RunSendContentionBenchmark(int packet_count) {
+  TLOG(kDefaultColour) << "Sending " << packet_count << " packets per thread through one "
+                       << "multiplexer.\n";
+  double single_thread_rate(0);
+  for (int thread_count : {1, 2, 4, 8}) {
+    double rate(MeasureSendRate(thread_count, packet_count));
+    if (rate < 0) {
+      TLOG(kDefaultColour) << "Failed to open multiplexer.\n";
+      return -1;
+    }
+    if (thread_count == 1)
+      single_thread_rate = rate;
+    TLOG(kDefaultColour) << thread_count << " thread(s): " << static_cast<intmax_t>(rate)
+                         << " packets/sec (x" << rate / single_thread_rate << ").\n";
+  }
+  return 0;
+}
+
+// Send message_count messages of message_size bytes to sink as maximum sized data packets, batched
+// as a socket's sender would, and with or without MSG_ZEROCOPY.  As in Sender::AddData, each
+// payload is a slice of the adopted message rather than a copy, and a zero-copy send keeps the
+// message alive until the kernel has finished with it.  The same message is sent each time, so only
+// the send path is measured.  Returns the send rate in bytes per second, or -1 if zero-copy sends
+// are unsupported, and sets cpu_time to the process CPU time taken and copied to the number of
+// zero-copy sends which the kernel copied anyway.
+double MeasureZeroCopySendRate(const ip::udp::endpoint& sink, int message_size, int message_count,
+                               bool zero_copy, double& cpu_time, uint64_t& copied) {
+  using maidsafe::rudp::detail::DataPacket;
+  using maidsafe::rudp::detail::SharedBuffer;
+  using maidsafe::rudp::detail::SharedBufferPtr;
+  asio::io_service io_service;
+  ip::udp::socket sender(io_service, ip::udp::endpoint(sink.protocol(), 0));
+  maidsafe::rudp::detail::ZeroCopyTracker tracker;
+  if (zero_copy && !tracker.Enable(sender))
+    return -1;
+
+  maidsafe::rudp::detail::TransmitBatch batch(maidsafe::rudp::Parameters::transmit_batch_size);
+  size_t segment_limit(0);
+  SharedBufferPtr message(SharedBuffer::Adopt(std::string(message_size, 'x')));
+  const size_t kPayloadSize(maidsafe::rudp::Parameters::max_data_size);
+  std::vector<asio::mutable_buffer> buffers;
+  boost::system::error_code ec;
+  auto flush([&] {
+    if (zero_copy) {
+      std::lock_guard<std::mutex> lock(tracker.mutex());
+      tracker.Reap(sender);
+    }
+    batch.Send(sender, segment_limit, &tracker, ec);
+  });
+
+  std::clock_t start_cpu(std::clock());
+  auto start_point(std::chrono::steady_clock::now());
+  DataPacket packet;
+  for (int i(0); i != message_count; ++i) {
+    for (size_t offset(0); offset < message->Capacity(); offset += kPayloadSize) {
+      size_t length(std::min(kPayloadSize, message->Capacity() - offset));
+      packet.SetData(message, asio::buffer(message->Data() + offset, length));
+      if (batch.IsFull())
+        flush();
+      buffers.assign(1, batch.NextBuffer());
+      packet.Encode(buffers);
+      batch.Push(buffers, sink, zero_copy ? message : SharedBufferPtr());
+    }
+  }
+  flush();
+  // Wait for the kernel to finish with the zero-copy sends, as a sender must before reusing them.
+  while (zero_copy) {
+    std::lock_guard<std::mutex> lock(tracker.mutex());
+    tracker.Reap(sender);
+    if (!tracker.HasPinned())
+      break;
+  }
+  auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_point));
+  cpu_time = static_cast<double>(std::clock() - start_cpu) / CLOCKS_PER_SEC;
+  copied = tracker.Copied();
+  return elapsed.count() ? message_size * 1000000.0 * message_count / elapsed.count() : 0;
+}
+
+int RunZeroCopyBenchmark(const ip::udp::endpoint& sink_endpoint) {
+  // Without a sink endpoint, send to an undrained socket over loopback.  The kernel must then copy
+  // zero-copy sends anyway, so this only shows their overhead; use a remote sink to see any gain.
+  asio::io_service io_service;
+  ip::udp::socket local_sink(io_service);
+  ip::udp::endpoint sink(sink_endpoint);
+  if (sink.port() == 0) {
+    local_sink.open(ip::udp::v4());
+    local_sink.bind(ip::udp::endpoint(ip::address_v4::loopback(), 0));
+    sink = local_sink.local_endpoint();
+  }
+  TLOG(kDefaultColour) << "Sending 256 MB of messages to " << sink << " in each mode.\n";
+  for (int message_size : {256 * 1024, 512 * 1024, 1024 * 1024, 2048 * 1024}) {
+    for (bool zero_copy : {false, true}) {
+      double cpu_time(0);
+      uint64_t copied(0);
+      int message_count(256 * 1024 * 1024 / message_size);
+      double rate(MeasureZeroCopySendRate(sink, message_size, message_count, zero_copy, cpu_time,
+                                          copied));
+      if (rate < 0) {
+        TLOG(kDefaultColour) << "Zero-copy sends are not supported.\n";
+        return 0;
+      }
+      TLOG(kDefaultColour) << message_size / 1024 << " kB messages, zero-copy "
+                           << (zero_copy ? "on: " : "off:") << " "
+                           << maidsafe::BytesToDecimalSiUnits(static_cast<uint64_t>(rate))
+                           << "/sec using " << static_cast<intmax_t>(cpu_time * 1000)
+                           << " ms of CPU.\n";
+      if (copied != 0) {
+        TLOG(kDefaultColour) << "  " << copied << " zero-copy sends were copied by the kernel "
+                             << "anyway.\n";
+      }
+    }
+  }
+  return 0;
+}
+
+// Send packet_count datagrams over loopback from one socket to another, each driven by a backend of
+// the given type: the sender in batches as a multiplexer flushes them, and the receiver by a
+// dispatch loop on its own thread.  Returns the number of datagrams received per second, or -1 if
+// the backend is unavailable, and sets send_rate to the number sent per second.  Backends which
+// don't use sockets bind their own loopback endpoints instead.
+double MeasureBackendRate(maidsafe::rudp::Parameters::MultiplexerBackendType type,
+                          int packet_count, double& send_rate, int& received) {
+  using maidsafe::rudp::detail::MultiplexerBackend;
+  typedef std::chrono::steady_clock::duration Duration;
+#ifndef MAIDSAFE_RUDP_IO_URING_BACKEND
+  // Otherwise Create would silently measure an AsioBackend instead.
+  if (type == maidsafe::rudp::Parameters::kIoUringBackend)
+    return -1;
+#endif
+  const size_t kDatagramSize(1400);
+  asio::io_service io_service;
+  ip::udp::socket sender(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  ip::udp::socket receiver(io_service, ip::udp::endpoint(ip::address_v4::loopback(), 0));
+  receiver.set_option(asio::socket_base::receive_buffer_size(8 * 1024 * 1024));
+  sender.non_blocking(true);
+  receiver.non_blocking(true);
+  std::unique_ptr<MultiplexerBackend> sending_backend(MultiplexerBackend::Create(type, sender));
+  std::unique_ptr<MultiplexerBackend> receiving_backend(MultiplexerBackend::Create(type, receiver));
+  if (!receiving_backend->UsesSocket()) {
+    ip::udp::endpoint loopback(ip::address_v4::loopback(), 0);
+    if (sending_backend->Bind(loopback) != maidsafe::rudp::kSuccess ||
+        receiving_backend->Bind(loopback) != maidsafe::rudp::kSuccess)
+      return -1;
+  } else if (!sending_backend->Open() || !receiving_backend->Open()) {
+    return -1;
+  }
+  boost::system::error_code endpoint_ec;
+  ip::udp::endpoint receiver_endpoint(receiving_backend->LocalEndpoint(endpoint_ec));
+
+  auto start_point(std::chrono::steady_clock::now());
+  std::atomic<int> received_count(0);
+  std::atomic<Duration::rep> last_receipt(0);
+  MultiplexerBackend::ReceiveHandler count([&](const asio::const_buffer&, const ip::udp::endpoint&,
+                                               const maidsafe::rudp::detail::SharedBufferPtr&) {
+    ++received_count;
+  });
+  std::function<void(const boost::system::error_code&)> dispatch;
+  dispatch = [&](const boost::system::error_code& ec) {
+    if (ec)
+      return;
+    boost::system::error_code receive_ec;
+    while (!receive_ec)
+      receiving_backend->Receive(count, receive_ec);
+    last_receipt = (std::chrono::steady_clock::now() - start_point).count();
+    receiving_backend->AsyncWait(dispatch);
+  };
+  receiving_backend->AsyncWait(dispatch);
+  std::thread receiving([&] { io_service.run(); });
+
+  maidsafe::rudp::detail::TransmitBatch batch(32);
+  size_t segment_limit(0);
+  std::vector<asio::mutable_buffer> buffers(1);
+  boost::system::error_code ec;
+  start_point = std::chrono::steady_clock::now();
+  // Without socket buffers to absorb bursts, the sender must keep pace with the receiver rather
+  // than overflow its queue.
+  const int kWindow(receiving_backend->UsesSocket() ? packet_count : kFabricWindow);
+  for (int i(0); i != packet_count; ++i) {
+    if (batch.IsFull()) {
+      sending_backend->Send(batch, segment_limit, nullptr, ec);
+      while (i - received_count > kWindow)
+        std::this_thread::yield();
+    }
+    buffers[0] = asio::buffer(batch.NextBuffer(), kDatagramSize);
+    batch.Push(buffers, receiver_endpoint);
+  }
+  sending_backend->Send(batch, segment_limit, nullptr, ec);
+  auto send_elapsed(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_point));
+
+  // Anything not received shortly after the sender finishes was dropped by the kernel.
+  for (int previous(-1); received_count != packet_count && received_count != previous;) {
+    previous = received_count;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  receiving_backend->Close();
+  io_service.stop();
+  receiving.join();
+  sending_backend->Close();
+
+  received = received_count;
+  send_rate = send_elapsed.count() ? packet_count * 1000000.0 / send_elapsed.count() : 0;
+  auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(Duration(last_receipt)));
+  return elapsed.count() ? received * 1000000.0 / elapsed.count() : 0;
+}
+
+int RunBackendBenchmark(int packet_count) {
+  TLOG(kDefaultColour) << "Sending " << packet_count << " datagrams over loopback through each "
+                       << "multiplexer backend.\n";
+  for (auto type : {maidsafe::rudp::Parameters::kAsioBackend,
+                    maidsafe::rudp::Parameters::kIoUringBackend,
+                    maidsafe::rudp::Parameters::kFabricBackend}) {
+    const char* name(type == maidsafe::rudp::Parameters::kAsioBackend ? "asio:    " :
+                     type == maidsafe::rudp::Parameters::kIoUringBackend ? "io_uring:" :
+                                                                           "fabric:  ");
+    double send_rate(0);
+    int received(0);
+    double rate(MeasureBackendRate(type, packet_count, send_rate, received));
+    if (rate < 0) {
+      TLOG(kDefaultColour) << name << " not supported.\n";
+      continue;
+    }
+    TLOG(kDefaultColour) << name << " sent at " << static_cast<intmax_t>(send_rate)
+                         << " packets/sec, received " << received << " at "
+                         << static_cast<intmax_t>(rate) << " packets/sec.\n";
+  }
+  return 0;
+}
+
+// Bind node_count fabric backends to endpoints on distinct addresses, as a simulated network of
+// that many nodes would, and have each send packets_per_node datagrams to the next in a ring.  All
+// the hardware's threads send, and as many again dispatch.  Returns the number of datagrams
+// received per second across all nodes, or -1 if the nodes couldn't be bound.
+double MeasureFabricRate(int node_count, int packets_per_node, int& received) {
+  using maidsafe::rudp::detail::MultiplexerBackend;
+  typedef std::chrono::steady_clock::duration Duration;
+  const size_t kDatagramSize(1400), kBatchSize(32);
+  const int kThreadCount(static_cast<int>(std::max(std::thread::hardware_concurrency(), 1U)));
+  asio::io_service io_service;
+  // Fabric backends only use the socket to find the io_service.
+  ip::udp::socket unused_socket(io_service);
+  std::vector<std::unique_ptr<MultiplexerBackend>> backends;
+  std::vector<ip::udp::endpoint> endpoints;
+  for (int i(0); i != node_count; ++i) {
+    endpoints.push_back(ip::udp::endpoint(ip::address_v4(0x0A000001 + i), 5483));
+    backends.emplace_back(MultiplexerBackend::Create(maidsafe::rudp::Parameters::kFabricBackend,
+                                                     unused_socket));
+    if (backends.back()->Bind(endpoints.back()) != maidsafe::rudp::kSuccess)
+      return -1;
+  }
+
+  // Each node's count is only written by its own dispatch loop, so isn't contended.
+  auto start_point(std::chrono::steady_clock::now());
+  std::atomic<Duration::rep> last_receipt(0);
+  std::unique_ptr<std::atomic<int>[]> counts(new std::atomic<int>[node_count]);
+  std::vector<MultiplexerBackend::ReceiveHandler> count_handlers;
+  std::vector<MultiplexerBackend::WaitHandler> dispatches(node_count);
+  for (int i(0); i != node_count; ++i) {
+    std::atomic<int>* count(&counts[i]);
+    *count = 0;
+    count_handlers.push_back([count](const asio::const_buffer&, const ip::udp::endpoint&,
+                                     const maidsafe::rudp::detail::SharedBufferPtr&) {
+      count->fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+  for (int i(0); i != node_count; ++i) {
+    MultiplexerBackend* backend(backends[i].get());
+    const MultiplexerBackend::ReceiveHandler* count(&count_handlers[i]);
+    MultiplexerBackend::WaitHandler* dispatch(&dispatches[i]);
+    *dispatch = [&, backend, count, dispatch](const boost::system::error_code& ec) {
+      if (ec)
+        return;
+      boost::system::error_code receive_ec;
+      while (!receive_ec)
+        backend->Receive(*count, receive_ec);
+      last_receipt = (std::chrono::steady_clock::now() - start_point).count();
+      backend->AsyncWait(*dispatch);
+    };
+    backend->AsyncWait(*dispatch);
+  }
+  std::vector<std::thread> dispatching;
+  for (int i(0); i != kThreadCount; ++i)
+    dispatching.emplace_back([&] { io_service.run(); });
+
+  start_point = std::chrono::steady_clock::now();
+  std::vector<std::thread> sending;
+  for (int thread(0); thread != kThreadCount; ++thread) {
+    sending.emplace_back([&, thread] {
+      maidsafe::rudp::detail::TransmitBatch batch(kBatchSize);
+      std::vector<asio::mutable_buffer> buffers(1);
+      size_t segment_limit(0);
+      boost::system::error_code ec;
+      for (int sent(0); sent < packets_per_node; sent += static_cast<int>(kBatchSize)) {
+        int batch_count(std::min(static_cast<int>(kBatchSize), packets_per_node - sent));
+        for (int i(thread); i < node_count; i += kThreadCount) {
+          int next((i + 1) % node_count);
+          while (sent - counts[next] > kFabricWindow)
+            std::this_thread::yield();
+          for (int j(0); j != batch_count; ++j) {
+            buffers[0] = asio::buffer(batch.NextBuffer(), kDatagramSize);
+            batch.Push(buffers, endpoints[next]);
+          }
+          backends[i]->Send(batch, segment_limit, nullptr, ec);
+        }
+      }
+    });
+  }
+  for (auto& thread : sending)
+    thread.join();
+
+  // Anything not received shortly after the senders finish was dropped.
+  auto total([&counts, node_count] {
+    int sum(0);
+    for (int i(0); i != node_count; ++i)
+      sum += counts[i];
+    return sum;
+  });
+  const int packet_count(node_count * packets_per_node);
+  for (int previous(-1), current(total()); current != packet_count && current != previous;
+       current = total()) {
+    previous = current;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  for (auto& backend : backends)
+    backend->Close();
+  io_service.stop();
+  for (auto& thread : dispatching)
+    thread.join();
+
+  received = total();
+  auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(Duration(last_receipt)));
+  return elapsed.count() ? received * 1000000.0 / elapsed.count() : 0;
+}
+
+int RunFabricBenchmark(int node_count, int packets_per_node) {
+  TLOG(kDefaultColour) << "Sending " << packets_per_node << " datagrams from each of "
+                       << node_count << " nodes over the in-process fabric.\n";
+  int received(0);
+  double rate(MeasureFabricRate(node_count, packets_per_node, received));
+  if (rate < 0) {
+    TLOG(kDefaultColour) << "Failed to bind " << node_count << " fabric endpoints.\n";
+    return -1;
+  }
+  TLOG(kDefaultColour) << "Received " << received << " of " << node_count * packets_per_node
+                       << " at " << static_cast<intmax_t>(rate) << " packets/sec.\n";
+  return 0;
+}
+
+// Route lookup_count handshakes on socket id 0, each from the peer of a random one of socket_count
+// unconnected sockets, both by scanning every socket for the sender's endpoint and through a
+// SocketIndex.  Then route as many packets for random socket ids, both through a hash map and the
+// SocketIndex.  Sets the number of lookups per second by each.
+void MeasureSocketLookup(int socket_count, int lookup_count, double& scan_rate, double& index_rate,
+                         double& map_rate, double& table_rate) {
+  using maidsafe::rudp::detail::Socket;
+  asio::io_service io_service;
+  maidsafe::rudp::detail::Multiplexer multiplexer(io_service);
+  maidsafe::rudp::NatType nat_type(maidsafe::rudp::NatType::kUnknown);
+  std::vector<std::unique_ptr<Socket>> sockets;
+  std::vector<std::pair<ip::udp::endpoint, Socket*>> scanned;
+  maidsafe::rudp::detail::SocketIndex index(maidsafe::RandomUint32());
+  std::unordered_map<uint32_t, Socket*> mapped;
+  std::vector<uint32_t> ids;
+  for (int i(0); i != socket_count; ++i) {
+    ip::udp::endpoint peer_endpoint(ip::address_v4(0x64000001 + i), 5483);
+    sockets.emplace_back(new Socket(multiplexer, nat_type));
+    scanned.push_back(std::make_pair(peer_endpoint, sockets.back().get()));
+    ids.push_back(index.Add(sockets.back().get(), peer_endpoint));
+    mapped.insert(std::make_pair(ids.back(), sockets.back().get()));
+  }
+  std::vector<ip::udp::endpoint> senders;
+  std::vector<uint32_t> destinations;
+  for (int i(0); i != lookup_count; ++i) {
+    senders.push_back(scanned[maidsafe::RandomUint32() % socket_count].first);
+    destinations.push_back(ids[maidsafe::RandomUint32() % socket_count]);
+  }
+
+  auto rate([lookup_count](std::chrono::steady_clock::time_point start_point) {
+    auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_point));
+    return elapsed.count() ? lookup_count * 1000000.0 / elapsed.count() : 0;
+  });
+  int found(0);
+  auto start_point(std::chrono::steady_clock::now());
+  for (const auto& sender : senders) {
+    auto itr(std::find_if(scanned.begin(), scanned.end(),
+                          [&sender](const std::pair<ip::udp::endpoint, Socket*>& entry) {
+      return entry.first == sender && !entry.second->IsConnected();
+    }));
+    found += (itr != scanned.end());
+  }
+  scan_rate = rate(start_point);
+  start_point = std::chrono::steady_clock::now();
+  for (const auto& sender : senders)
+    found += (index.FindByEndpoint(sender, true) != 0);
+  index_rate = rate(start_point);
+  start_point = std::chrono::steady_clock::now();
+  for (uint32_t id : destinations)
+    found += (mapped.find(id) != mapped.end());
+  map_rate = rate(start_point);
+  start_point = std::chrono::steady_clock::now();
+  for (uint32_t id : destinations)
+    found += (index.Find(id) != nullptr);
+  table_rate = rate(start_point);
+  if (found != 4 * lookup_count)
+    TLOG(kDefaultColour) << "Only found " << found << " of " << 4 * lookup_count << " sockets.\n";
+}
+
+int RunSocketLookupBenchmark(int max_socket_count) {
+  TLOG(kDefaultColour) << "Routing handshakes to unconnected sockets by scanning and by index, "
+                       << "and packets to socket ids by hash map and by slot table.\n";
+  const int kLookupCount(10000);
+  for (int socket_count(10); socket_count <= max_socket_count; socket_count *= 10) {
+    double scan_rate(0), index_rate(0), map_rate(0), table_rate(0);
+    MeasureSocketLookup(socket_count, kLookupCount, scan_rate, index_rate, map_rate, table_rate);
+    TLOG(kDefaultColour) << socket_count << " sockets: handshakes/sec scanned "
+                         << static_cast<intmax_t>(scan_rate) << ", indexed "
+                         << static_cast<intmax_t>(index_rate) << "; packets/sec mapped "
+                         << static_cast<intmax_t>(map_rate) << ", tabled "
+                         << static_cast<intmax_t>(table_rate) << ".\n";
+  }
+  return 0;
+}
+
+// SlidingWindow as it was before it became a ring buffer, kept only for comparison.
+template <typename T>
+class DequeWindow {
+ public:
+  typedef uint32_t seq_num_t;
+  static const seq_num_t kMaxSequenceNumber = 0x7fffffff;
+
+  explicit DequeWindow(seq_num_t initial_sequence_number)
+      : items_(), begin_(initial_sequence_number), end_(initial_sequence_number) {}
+
+  seq_num_t Begin() const { return begin_; }
+  size_t Size() const { return items_.size(); }
+
+  seq_num_t Append() {
+    items_.push_back(T());
+    seq_num_t n = end_;
+    end_ = Next(end_);
+    return n;
+  }
+
+  void Remove() {
+    items_.erase(items_.begin());
+    begin_ = Next(begin_);
+  }
+
+  T& operator[](seq_num_t n) {
+    if (begin_ <= end_)
+      return items_[n - begin_];
+    else if (n < end_)
+      return items_[kMaxSequenceNumber - begin_ + n + 1];
+    else
+      return items_[n - begin_];
+  }
+
+  static seq_num_t Next(seq_num_t n) { return (n == kMaxSequenceNumber) ? 0 : n + 1; }
+
+ private:
+  std::deque<T> items_;
+  seq_num_t begin_, end_;
+};
+
+// What the sender keeps for each packet in its window.
+struct WindowedPacket {
+  WindowedPacket() : packet(), lost(false) {}
+  maidsafe::rudp::detail::DataPacket packet;
+  bool lost;
+};
+
+// Fill window with window_size packets, then slide it op_count times, each time retiring the
+// oldest packet, appending a new one and touching one at random.  Returns slides per second.
+template <typename Window>
+double MeasureWindowRate(Window& window, size_t window_size, int op_count) {
+  for (size_t i(0); i != window_size; ++i)
+    window[window.Append()].packet.SetMessageNumber(1);
+  std::vector<uint32_t> offsets;
+  for (int i(0); i != 4096; ++i)
+    offsets.push_back(maidsafe::RandomUint32() % window_size);
+
+  uint32_t sum(0);
+  auto start_point(std::chrono::steady_clock::now());
+  for (int i(0); i != op_count; ++i) {
+    sum += window[window.Begin()].packet.MessageNumber();
+    window.Remove();
+    window[window.Append()].packet.SetMessageNumber(1);
+    uint32_t n((window.Begin() + offsets[i & 4095]) % (Window::kMaxSequenceNumber + 1));
+    window[n].lost = !window[n].lost;
+  }
+  auto elapsed(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start_point));
+  if (sum != static_cast<uint32_t>(op_count))
+    TLOG(kDefaultColour) << "Window held the wrong packets.\n";
+  return elapsed.count() ? op_count * 1000000.0 / elapsed.count() : 0;
+}
+
+int RunSlidingWindowBenchmark(int op_count) {
+  TLOG(kDefaultColour) << "Sliding packet windows backed by a deque and by a ring buffer.\n";
+  // Start near the wrap so that both windows cross it.
+  const uint32_t kInitialSequenceNumber(0x7fffffff - static_cast<uint32_t>(op_count / 2));
+  for (size_t window_size : {size_t(16), size_t(maidsafe::rudp::Parameters::default_window_size),
+                             size_t(maidsafe::rudp::Parameters::maximum_window_size)}) {
+    DequeWindow<WindowedPacket> deque_window(kInitialSequenceNumber);
+    maidsafe::rudp::detail::SlidingWindow<WindowedPacket> ring_window(kInitialSequenceNumber);
+    ring_window.SetMaximumSize(window_size);
+    double deque_rate(MeasureWindowRate(deque_window, window_size, op_count));
+    double ring_rate(MeasureWindowRate(ring_window, window_size, op_count));
+    TLOG(kDefaultColour) << window_size << " packets: slides/sec deque "
+                         << static_cast<intmax_t>(deque_rate) << ", ring buffer "
+                         << static_cast<intmax_t>(ring_rate) << ".\n";
+  }
+  return 0;
+}
+
+// Set up two connected nodes whose sockets recover lost packets in the given mode, then drop
+// packet_loss of all packets while sending message_count messages of message_size bytes from one
+// to the other, each once the last has been acknowledged.  Fills latencies with the milliseconds
+// each message took to be acknowledged, in ascending order.  Returns false if the nodes couldn't be
+// connected or a message couldn't be sent.
+bool MeasureLossRecovery(maidsafe::rudp::Parameters::LossRecoveryMode mode, int message_count,
+                         int message_size, double packet_loss, std::vector<double>& latencies) {
+  maidsafe::rudp::Parameters::loss_recovery_mode = mode;
+  std::vector<maidsafe::rudp::test::NodePtr> nodes;
+  std::vector<maidsafe::rudp::Endpoint> bootstrap_endpoints;
+  if (!maidsafe::rudp::test::SetupNetwork(nodes, bootstrap_endpoints, 2))
+    return false;
+
+  // Only drop packets once connected, so the handshakes can't time out.
+  maidsafe::rudp::SetDebugPacketLossRate(packet_loss, 0);
+  std::string message(maidsafe::RandomAlphaNumericString(message_size));
+  std::mutex mutex;
+  std::condition_variable cond_var;
+  int result_of_send(maidsafe::rudp::kSuccess);
+  bool sent(false);
+  maidsafe::rudp::MessageSentFunctor message_sent_functor([&](int result_in) {
+    std::lock_guard<std::mutex> lock(mutex);
+    result_of_send = result_in;
+    sent = true;
+    cond_var.notify_one();
+  });
+  latencies.clear();
+  for (int i(0); i != message_count && result_of_send == maidsafe::rudp::kSuccess; ++i) {
+    sent = false;
+    auto start_point(std::chrono::steady_clock::now());
+    nodes[0]->managed_connections()->Send(nodes[1]->node_id(), message, message_sent_functor);
+    std::unique_lock<std::mutex> lock(mutex);
+    cond_var.wait(lock, [&sent] { return sent; });
+    latencies.push_back(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start_point).count());
+  }
+  maidsafe::rudp::SetDebugPacketLossRate(0, 0);
+  std::sort(latencies.begin(), latencies.end());
+  return result_of_send == maidsafe::rudp::kSuccess;
+}
+
+int RunLossRecoveryBenchmark(int message_count, double packet_loss_percentage) {
+  if (message_count < 1 || packet_loss_percentage < 0.0 || packet_loss_percentage >= 100.0) {
+    std::cerr << "Message count must be >= 1 and packet loss percentage must be >= 0 and < 100.\n";
+    return -1;
+  }
+  const int kMessageSize(64 * 1024);
+  TLOG(kDefaultColour) << "Sending " << message_count << " messages of " << kMessageSize
+                       << " bytes one at a time with " << packet_loss_percentage
+                       << "% packet loss.\n";
+  auto default_mode(maidsafe::rudp::Parameters::loss_recovery_mode);
+  for (auto mode : {maidsafe::rudp::Parameters::kSenderTimeout,
+                    maidsafe::rudp::Parameters::kReceiverNegativeAck}) {
+    const char* name(mode == maidsafe::rudp::Parameters::kSenderTimeout ?
+                         "sender timeouts:       " : "receiver negative acks:");
+    std::vector<double> latencies;
+    if (!MeasureLossRecovery(mode, message_count, kMessageSize, packet_loss_percentage / 100.0,
+                             latencies)) {
+      TLOG(kDefaultColour) << name << " failed to send messages.\n";
+      maidsafe::rudp::Parameters::loss_recovery_mode = default_mode;
+      return -1;
+    }
+    double mean(std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size());
+    TLOG(kDefaultColour) << name << " latency mean " << mean << " ms, median "
+                         << latencies[latencies.size() / 2] << " ms, 99th percentile "
+                         << latencies[latencies.size() * 99 / 100] << " ms, max "
+                         << latencies.back() << " ms.\n";
+  }
+  maidsafe::rudp::Parameters::loss_recovery_mode = default_mode;
+  return 0;
+}
+
 bool ParseArgs(int argc, char** argv, int& message_count, int& message_size,
                double& packet_loss_constant, double& packet_loss_bursty, std::string& path) {
   auto fail([]()->bool {
     std::cout << "Pass no. of messages and size of messages (in bytes) as first 2 arguments.\n";
     std::cout << "Optionally pass in packet loss percentage as third argument and CSV append\n";
     std::cout << "file path as fourth argument.\n";
+    std::cout << "Alternatively pass --gro and optionally a datagram count to compare receive\n";
+    std::cout << "rates with and without UDP generic receive offload, or --send-contention and\n";
+    std::cout << "optionally a packet count to measure send scaling across threads, or\n";
+    std::cout << "--zero-copy and optionally a sink address and port to compare send rates with\n";
+    std::cout << "and without MSG_ZEROCOPY, or --backends and optionally a datagram count to\n";
+    std::cout << "compare packet rates through the multiplexer backends, or --fabric and\n";
+    std::cout << "optionally a node count and datagrams per node to measure packet rates between\n";
+    std::cout << "many nodes simulated in memory, or --socket-lookup and optionally a maximum\n";
+    std::cout << "socket count to compare ways of finding the socket a packet is for, or\n";
+    std::cout << "--sliding-window and optionally a slide count to compare packet window\n";
+    std::cout << "implementations, or --loss-recovery and optionally a message count and packet\n";
+    std::cout << "loss percentage to compare message latencies when lost packets are recovered\n";
+    std::cout << "by sender timeouts and by receiver negative acks.\n";
     return false;
   });
 
@@ -77,9 +833,72 @@ bool ParseArgs(int argc, char** argv, int& message_count, int& message_size,
   return true;
 }
 
+// Parse argv[index] as a count of at least 1, or use default_count if there's no such argument.
+bool ParseCount(int argc, char** argv, int index, int default_count, int& count) {
+  count = default_count;
+  if (argc <= index)
+    return true;
+  try {
+    count = std::stoi(argv[index]);
+  }
+  catch (const std::exception&) {
+    std::cerr << "Couldn't parse \"" << argv[index] << "\" as a count.\n";
+    return false;
+  }
+  if (count < 1) {
+    std::cerr << "Counts must be >= 1.\n";
+    return false;
+  }
+  return true;
+}
+
 }  // unnamed namespace
 
 int main(int argc, char** argv) {
+  int count(0), second_count(0);
+  if (argc > 1 && std::string(argv[1]) == "--gro")
+    return ParseCount(argc, argv, 2, 1000000, count) ? RunReceiveOffloadBenchmark(count) : -1;
+  if (argc > 1 && std::string(argv[1]) == "--send-contention")
+    return ParseCount(argc, argv, 2, 100000, count) ? RunSendContentionBenchmark(count) : -1;
+  if (argc > 1 && std::string(argv[1]) == "--backends")
+    return ParseCount(argc, argv, 2, 1000000, count) ? RunBackendBenchmark(count) : -1;
+  if (argc > 1 && std::string(argv[1]) == "--socket-lookup")
+    return ParseCount(argc, argv, 2, 10000, count) ? RunSocketLookupBenchmark(count) : -1;
+  if (argc > 1 && std::string(argv[1]) == "--sliding-window")
+    return ParseCount(argc, argv, 2, 10000000, count) ? RunSlidingWindowBenchmark(count) : -1;
+  if (argc > 1 && std::string(argv[1]) == "--loss-recovery") {
+    if (!ParseCount(argc, argv, 2, 200, count))
+      return -1;
+    double packet_loss_percentage(5.0);
+    try {
+      if (argc > 3)
+        packet_loss_percentage = std::stod(argv[3]);
+    }
+    catch (const std::exception&) {
+      std::cerr << "Couldn't parse \"" << argv[3] << "\" as a packet loss percentage.\n";
+      return -1;
+    }
+    return RunLossRecoveryBenchmark(count, packet_loss_percentage);
+  }
+  if (argc > 1 && std::string(argv[1]) == "--fabric") {
+    if (!ParseCount(argc, argv, 2, 1000, count) || !ParseCount(argc, argv, 3, 1000, second_count))
+      return -1;
+    return RunFabricBenchmark(count, second_count);
+  }
+  if (argc > 1 && std::string(argv[1]) == "--zero-copy") {
+    ip::udp::endpoint sink;
+    if (argc > 3) {
+      boost::system::error_code ec;
+      ip::address address(ip::address::from_string(argv[2], ec));
+      if (ec || !ParseCount(argc, argv, 3, 0, count) || count > 65535) {
+        std::cerr << "Pass the sink's address and a port from 1 to 65535.\n";
+        return -1;
+      }
+      sink = ip::udp::endpoint(address, static_cast<uint16_t>(count));
+    }
+    return RunZeroCopyBenchmark(sink);
+  }
+
   auto message_count(0), message_size(0);
   double packet_loss_constant(0), packet_loss_bursty(0);
   std::string csv_file_path;
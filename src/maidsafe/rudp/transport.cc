@@ -22,6 +22,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <utility>
 
 #include "boost/thread/condition_variable.hpp"
 #include "boost/thread/mutex.hpp"
@@ -39,11 +40,17 @@ namespace bptime = boost::posix_time;
 
 namespace maidsafe { namespace rudp { namespace detail {
 
+Transport::Shard::Shard()
+    : asio_service(1),
+      strand(asio_service.service()),
+      multiplexer(new Multiplexer(asio_service.service())) {}
+
 Transport::Transport(BoostAsioService& asio_service, NatType& nat_type)
     : asio_service_(asio_service),
       nat_type_(nat_type),
       strand_(asio_service.service()),
       multiplexer_(new Multiplexer(asio_service.service())),
+      shards_(),
       connection_manager_(),
       callback_mutex_(),
       on_message_(),
@@ -75,6 +82,8 @@ void Transport::Bootstrap(const IdEndpointPairs&            bootstrap_peers,
     return strand_.dispatch([on_bootstrap, result]() { on_bootstrap(result, NodeId()); });
   }
 
+  OpenShards();
+
   // We want these 3 slots to be invoked before any others connected, so that if we wait elsewhere
   // for the other connected slot(s) to be executed, we can be assured that these main slots have
   // already been executed at that point in time.
@@ -89,6 +98,8 @@ void Transport::Bootstrap(const IdEndpointPairs&            bootstrap_peers,
 
   connection_manager_.reset(new ConnectionManager(shared_from_this(), strand_, multiplexer_,
                                                   this_node_id, this_public_key));
+  for (auto& shard : shards_)
+    connection_manager_->AddShard(shard->strand, shard->multiplexer);
 
   StartDispatch();
 
@@ -230,6 +241,13 @@ void Transport::Close() {
       if (connection_manager) { connection_manager->Close(); }
       if (multiplexer)        { multiplexer->Close(); }
       });
+
+  // Each shard receives on its own thread, so its multiplexer must be closed on its own strand
+  // rather than while a receive may be in progress on the socket.
+  for (auto& shard : shards_) {
+    auto shard_multiplexer = shard->multiplexer;
+    shard->strand.dispatch([shard_multiplexer]() { shard_multiplexer->Close(); });
+  }
 }
 
 void Transport::Connect(const NodeId& peer_id, const EndpointPair& peer_endpoint_pair,
@@ -282,9 +300,9 @@ bool Transport::CloseConnection(const NodeId& peer_id) {
   return connection_manager_->CloseConnection(peer_id);
 }
 
-bool Transport::Send(const NodeId& peer_id, const std::string& message,
+bool Transport::Send(const NodeId& peer_id, std::string message,
                      const MessageSentFunctor& message_sent_functor) {
-  return connection_manager_->Send(peer_id, message, message_sent_functor);
+  return connection_manager_->Send(peer_id, std::move(message), message_sent_functor);
 }
 
 void Transport::Ping(const NodeId& peer_id, const Endpoint& peer_endpoint,
@@ -297,7 +315,11 @@ std::shared_ptr<Connection> Transport::GetConnection(const NodeId& peer_id) {
 }
 
 Transport::Endpoint Transport::external_endpoint() const {
-  return multiplexer_->external_endpoint();
+  // Only the shard handling the connection which discovered it knows the external endpoint.
+  Endpoint endpoint(multiplexer_->external_endpoint());
+  for (auto itr(shards_.begin()); !IsValid(endpoint) && itr != shards_.end(); ++itr)
+    endpoint = (*itr)->multiplexer->external_endpoint();
+  return endpoint;
 }
 
 Transport::Endpoint Transport::local_endpoint() const { return multiplexer_->local_endpoint(); }
@@ -322,27 +344,67 @@ size_t Transport::NormalConnectionsCount() const {
 bool Transport::IsIdle() const { return connection_manager_->NormalConnectionsCount() == 0U; }
 
 bool Transport::IsAvailable() const {
-  return detail::IsValid(multiplexer_->external_endpoint()) ||
+  return detail::IsValid(external_endpoint()) ||
          detail::IsValid(multiplexer_->local_endpoint());
 }
 
+void Transport::OpenShards() {
+  const size_t shard_count(Multiplexer::ShardCount());
+  if (shard_count == 1U)
+    return;
+
+  // The additional multiplexers join the primary one's port, so must be opened on its endpoint.
+  // If any can't be, carry on with just the primary.
+  for (size_t i(1); i != shard_count; ++i) {
+    std::unique_ptr<Shard> shard(new Shard);
+    ReturnCode result(shard->multiplexer->Open(multiplexer_->local_endpoint()));
+    if (result != kSuccess) {
+      LOG(kWarning) << "Failed to open multiplexer shard on " << multiplexer_->local_endpoint()
+                    << ".  Result: " << result;
+      for (auto& opened : shards_)
+        opened->multiplexer->Close();
+      shards_.clear();
+      return;
+    }
+    shards_.push_back(std::move(shard));
+  }
+
+  // Without steering the kernel spreads packets by flow hash, so many arrive at the wrong shard
+  // and have to be handed over.  Steering delivers packets for existing sockets straight to their
+  // owner.  Handshakes for new sockets are still spread by flow hash, which the program can't
+  // relate to ConnectionManager::ShardFor, so about (shard_count - 1) / shard_count of them are
+  // copied over to the right shard.  Only the handshakes opening a connection pay this, not its
+  // data packets.
+  if (multiplexer_->SteerToShards(shard_count) != kSuccess)
+    LOG(kWarning) << "Packets to " << multiplexer_->local_endpoint() << " will not be steered.";
+}
+
 void Transport::StartDispatch() {
+  StartDispatch(strand_, multiplexer_);
+  for (auto& shard : shards_)
+    StartDispatch(shard->strand, shard->multiplexer);
+}
+
+void Transport::StartDispatch(boost::asio::io_service::strand& strand,
+                              MultiplexerPtr multiplexer) {
   std::weak_ptr<Transport> weak_self = shared_from_this();
 
-  auto handler = strand_.wrap([weak_self](const Error& error) {
+  auto handler = strand.wrap([weak_self, &strand, multiplexer](const Error& error) {
       if (auto self = weak_self.lock()) {
-        self->HandleDispatch(error);
+        self->HandleDispatch(strand, multiplexer, error);
       }
       });
 
-  multiplexer_->AsyncDispatch(handler);
+  multiplexer->AsyncDispatch(handler);
 }
 
-void Transport::HandleDispatch(const boost::system::error_code& /*ec*/) {
-  if (!multiplexer_->IsOpen())
+void Transport::HandleDispatch(boost::asio::io_service::strand& strand,
+                               MultiplexerPtr multiplexer,
+                               const boost::system::error_code& /*ec*/) {
+  if (!multiplexer->IsOpen())
     return;
 
-  StartDispatch();
+  StartDispatch(strand, multiplexer);
 }
 
 NodeId Transport::node_id() const { return connection_manager_->node_id(); }
@@ -351,13 +413,13 @@ std::shared_ptr<asymm::PublicKey> Transport::public_key() const {
   return connection_manager_->public_key();
 }
 
-void Transport::SignalMessageReceived(const std::string& message) {
+void Transport::SignalMessageReceived(std::shared_ptr<const std::string> message) {
   // Dispatch the message outside the strand.
   strand_.get_io_service().post(
       std::bind(&Transport::DoSignalMessageReceived, shared_from_this(), message));
 }
 
-void Transport::DoSignalMessageReceived(const std::string& message) {
+void Transport::DoSignalMessageReceived(std::shared_ptr<const std::string> message) {
   OnMessage local_callback;
   {
     std::lock_guard<std::mutex> guard(callback_mutex_);
@@ -55,7 +55,8 @@ class Socket;
 
 class Transport : public std::enable_shared_from_this<Transport> {
  public:
-  typedef std::function<void(const std::string&)> OnMessage;
+  // Received messages are shared rather than copied as they're passed up to the application.
+  typedef std::function<void(std::shared_ptr<const std::string>)> OnMessage;
 
   typedef std::function<void(const NodeId&, std::shared_ptr<Transport>, bool, std::atomic<bool> &)>
       OnConnectionAdded;
@@ -97,7 +98,7 @@ class Transport : public std::enable_shared_from_this<Transport> {
   // itself from ManagedConnections which will cause it to be destroyed.
   bool CloseConnection(const NodeId& peer_id);
 
-  bool Send(const NodeId& peer_id, const std::string& message,
+  bool Send(const NodeId& peer_id, std::string message,
             const std::function<void(int)>& message_sent_functor);  // NOLINT (Fraser)
 
   void Ping(const NodeId& peer_id, const Endpoint& peer_endpoint,
@@ -152,14 +153,17 @@ class Transport : public std::enable_shared_from_this<Transport> {
   void DoConnect(const NodeId& peer_id, const EndpointPair& peer_endpoint_pair,
                  const std::string& validation_data);
 
+  void OpenShards();
   void StartDispatch();
-  void HandleDispatch(const boost::system::error_code& ec);
+  void StartDispatch(boost::asio::io_service::strand& strand, MultiplexerPtr multiplexer);
+  void HandleDispatch(boost::asio::io_service::strand& strand, MultiplexerPtr multiplexer,
+                      const boost::system::error_code& ec);
 
   NodeId node_id() const;
   std::shared_ptr<asymm::PublicKey> public_key() const;
 
-  void SignalMessageReceived(const std::string& message);
-  void DoSignalMessageReceived(const std::string& message);
+  void SignalMessageReceived(std::shared_ptr<const std::string> message);
+  void DoSignalMessageReceived(std::shared_ptr<const std::string> message);
   void AddConnection(ConnectionPtr connection);
   void DoAddConnection(ConnectionPtr connection);
   void RemoveConnection(ConnectionPtr connection, bool timed_out);
@@ -168,10 +172,21 @@ class Transport : public std::enable_shared_from_this<Transport> {
   OnConnect MakeDefaultOnConnectHandler();
 
  private:
+  // A further multiplexer sharing multiplexer_'s port, with its own thread.
+  struct Shard {
+    Shard();
+    BoostAsioService                 asio_service;
+    boost::asio::io_service::strand  strand;
+    MultiplexerPtr                   multiplexer;
+  };
+
   BoostAsioService&                       asio_service_;
   NatType&                           nat_type_;
   boost::asio::io_service::strand    strand_;
   MultiplexerPtr                     multiplexer_;
+  // Declared before connection_manager_, which shares the shards' multiplexers, so that they
+  // outlive it.  Empty unless Multiplexer::ShardCount() > 1.
+  std::vector<std::unique_ptr<Shard>> shards_;
   ConnectionManagerPtr               connection_manager_;
   std::mutex                         callback_mutex_;
 
@@ -18,6 +18,10 @@
 
 #include "maidsafe/rudp/utils.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <string>
 #include <utility>
 
@@ -70,6 +74,10 @@ bool IsPrivateNetworkAddress(const ip::address_v4& address) {
   return address <= kMaxClassC;
 }
 
+void HashCombine(size_t value, size_t& hash) {
+  hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+}
+
 }  // unnamed namespace
 
 bool IsValid(const ip::udp::endpoint& endpoint) {
@@ -119,6 +127,28 @@ bool OnPrivateNetwork(const ip::udp::endpoint& endpoint) {
     return endpoint.address().to_v6().is_link_local();
 }
 
+size_t AddressHash::operator()(const ip::address& address) const {
+  if (address.is_v4())
+    return std::hash<uint32_t>()(static_cast<uint32_t>(address.to_v4().to_ulong()));
+  size_t hash(0);
+  for (unsigned char byte : address.to_v6().to_bytes())
+    HashCombine(byte, hash);
+  return hash;
+}
+
+size_t EndpointHash::operator()(const ip::udp::endpoint& endpoint) const {
+  size_t hash(AddressHash()(endpoint.address()));
+  HashCombine(endpoint.port(), hash);
+  return hash;
+}
+
+size_t NodeIdHash::operator()(const NodeId& node_id) const {
+  const std::string& id(node_id.string());
+  size_t hash(0);
+  std::memcpy(&hash, id.data(), std::min(id.size(), sizeof(hash)));
+  return hash;
+}
+
 }  // namespace detail
 
 }  // namespace rudp
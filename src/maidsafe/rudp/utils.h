@@ -19,9 +19,13 @@
 #ifndef MAIDSAFE_RUDP_UTILS_H_
 #define MAIDSAFE_RUDP_UTILS_H_
 
+#include <cstddef>
+
 #include "boost/asio/ip/address.hpp"
 #include "boost/asio/ip/udp.hpp"
 
+#include "maidsafe/common/node_id.h"
+
 namespace maidsafe {
 
 namespace rudp {
@@ -44,6 +48,20 @@ bool IsConnectable(const boost::asio::ip::udp::endpoint& peer_endpoint,
 // Returns true if the endpoint is within one of the ranges designated for private networks.
 bool OnPrivateNetwork(const boost::asio::ip::udp::endpoint& endpoint);
 
+// Hash functions allowing addresses, endpoints and node ids to key unordered containers.
+struct AddressHash {
+  size_t operator()(const boost::asio::ip::address& address) const;
+};
+
+struct EndpointHash {
+  size_t operator()(const boost::asio::ip::udp::endpoint& endpoint) const;
+};
+
+// Node ids are uniformly distributed, so their leading bytes already make a good hash.
+struct NodeIdHash {
+  size_t operator()(const NodeId& node_id) const;
+};
+
 }  // namespace detail
 
 }  // namespace rudp